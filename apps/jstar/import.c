@@ -1,8 +1,10 @@
 #include "import.h"
 
 #include <jstar/jstar.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "dynload.h"
 #include "extlib.h"
@@ -14,6 +16,9 @@
 #define JSTAR_PATH      "JSTARPATH"      // Env variable containing a list of import paths
 #define IMPORT_PATHS    "importPaths"    // Name of the global holding the import paths list
 #define OPEN_NATIVE_EXT "jsrOpenModule"  // Function called when loading native extension modules
+#define CACHE_DIR       "__jscache__"    // Directory holding the bytecode cache of source modules
+#define JSTAR_CACHE     "JSTARCACHE"     // Env variable overriding the bytecode cache directory
+#define CACHE_MAGIC     "JsrCach2"       // Magic number identifying bytecode cache files
 
 // Platform specific separator for the `JSTARPATH` environment variable
 #ifdef JSTAR_WINDOWS
@@ -22,6 +27,27 @@
     #define IMPORT_PATHS_SEP ':'
 #endif
 
+// Used to memory map compiled files and to generate unique temporary file names when writing the
+// bytecode cache
+#if defined(JSTAR_POSIX)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#elif defined(JSTAR_WINDOWS)
+    #include <Windows.h>
+    #include <process.h>
+    #define getpid _getpid
+#endif
+
+// Nanoseconds of the modification time in a `struct stat`, where available
+#if defined(JSTAR_MACOS) || defined(JSTAR_IOS)
+    #define MTIME_NSEC(st) ((st).st_mtimespec.tv_nsec)
+#elif defined(JSTAR_POSIX)
+    #define MTIME_NSEC(st) ((st).st_mtim.tv_nsec)
+#else
+    #define MTIME_NSEC(st) 0
+#endif
+
 // Platform specific shared library suffix
 #if defined(JSTAR_WINDOWS)
     #define DL_SUFFIX ".dll"
@@ -38,8 +64,25 @@
 // having them as globals saves a lot of allocations during imports.
 static Path import;
 static Path nativeExt;
-
-bool initImports(JStarVM* vm, const char* scriptPath, bool ignoreEnv) {
+static Path cache;
+
+// Header prepended to the cached bytecode of a source module.
+// Used to check wether the cache is still up to date with respect to its source file.
+typedef struct CacheHeader {
+    char magic[8];
+    uint64_t version;          // `JSTAR_VERSION` of the J* runtime that compiled the bytecode
+    uint64_t bytecodeVersion;  // `JSTAR_BYTECODE_VERSION` of the compiled bytecode
+    uint64_t sourceSize;       // Size of the source file in bytes
+    int64_t sourceMtime;       // Last modification time of the source file
+    int64_t sourceMtimeNsec;   // Nanoseconds of the modification time (0 where not available)
+    uint64_t sourceHash;       // Hash of the source file contents
+} CacheHeader;
+
+static bool cacheEnabled;
+static Path cacheRoot;           // Custom cache directory. If empty, caches live beside sources
+static CacheHeader cacheHeader;  // Cache header of the source module currently being imported
+
+bool initImports(JStarVM* vm, const char* scriptPath, bool ignoreEnv, bool disableCache) {
     jsrGetGlobal(vm, JSR_CORE_MODULE, IMPORT_PATHS);
 
     Path mainImport;
@@ -87,12 +130,23 @@ bool initImports(JStarVM* vm, const char* scriptPath, bool ignoreEnv) {
     jsrPop(vm);
 
     jsrPop(vm);
+
+    // Setup the bytecode cache, optionally using the directory in the JSTARCACHE env variable
+    cacheEnabled = !disableCache;
+    const char* cacheDir;
+    if(cacheEnabled && !ignoreEnv && (cacheDir = getenv(JSTAR_CACHE)) && *cacheDir) {
+        pathAppendStr(&cacheRoot, cacheDir);
+        if(!pathToAbsolute(&cacheRoot)) return false;
+    }
+
     return true;
 }
 
 void freeImports(void) {
     pathFree(&import);
     pathFree(&nativeExt);
+    pathFree(&cache);
+    pathFree(&cacheRoot);
 }
 
 // Loads a native extension module and returns its `native registry` to J*
@@ -122,15 +176,182 @@ static bool readFileAtPath(const Path* p, StringBuffer* sb) {
     return res;
 }
 
+// A read-only memory mapping of a whole file.
+// On platforms that do not support memory mapping, the file is simply read into memory.
+typedef struct MappedFile {
+    const char* data;
+    size_t size;
+} MappedFile;
+
+// Maps the file at `p` in memory. Returns NULL on failure or if the file is empty
+static MappedFile* mapFileAtPath(const Path* p) {
+#if defined(JSTAR_POSIX)
+    int fd = open(p->items, O_RDONLY);
+    if(fd < 0) return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return NULL;
+
+    MappedFile* mf = malloc(sizeof(*mf));
+    mf->data = data;
+    mf->size = st.st_size;
+    return mf;
+#elif defined(JSTAR_WINDOWS)
+    HANDLE file = CreateFileA(p->items, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // The view keeps the underlying file and mapping objects alive, so we can close them here
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(!mapping) return NULL;
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if(!data) return NULL;
+
+    MappedFile* mf = malloc(sizeof(*mf));
+    mf->data = data;
+    mf->size = size.QuadPart;
+    return mf;
+#else
+    StringBuffer sb = {.allocator = &default_allocator.base};
+    if(!readFileAtPath(p, &sb) || sb.size == 0) {
+        sb_free(&sb);
+        return NULL;
+    }
+
+    MappedFile* mf = malloc(sizeof(*mf));
+    mf->data = sb.items;
+    mf->size = sb.size;
+    return mf;
+#endif
+}
+
+static void unmapFile(MappedFile* mf) {
+#if defined(JSTAR_POSIX)
+    munmap((void*)mf->data, mf->size);
+#elif defined(JSTAR_WINDOWS)
+    UnmapViewOfFile(mf->data);
+#else
+    free((void*)mf->data);
+#endif
+    free(mf);
+}
+
+// FNV-1a hash of the source file contents
+static uint64_t hashSource(const char* src, size_t length) {
+    uint64_t hash = 14695981039346656037u;
+    for(size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)src[i];
+        hash *= 1099511628211u;
+    }
+    return hash;
+}
+
+// Computes the path of the bytecode cache file for the source file at `p`.
+// By default the cache is stored in the `__jscache__` directory beside the source file. If a custom
+// cache directory is set, the cache file name is the mangled absolute path of the source instead.
+static void setCachePath(const Path* p) {
+    pathClear(&cache);
+
+    if(cacheRoot.size) {
+        Path absolute = pathAbsolute(p);
+        pathAppend(&cache, cacheRoot.items, cacheRoot.size);
+        size_t nameStart = cache.size + 1;
+        pathJoinStr(&cache, absolute.items);
+        pathReplace(&cache, nameStart, PATH_SEP ":", '%');
+        pathFree(&absolute);
+    } else {
+        pathAppend(&cache, p->items, p->size);
+        pathDirname(&cache);
+        size_t nameStart = cache.size;
+        pathJoinStr(&cache, CACHE_DIR);
+        pathJoinStr(&cache, p->items + nameStart);
+    }
+
+    pathChangeExtension(&cache, JSC_EXT);
+}
+
+// Writes the bytecode cache file, along with its header, at the current cache path.
+// The file is written to a temporary location first and then moved in place, so that concurrent
+// J* processes never observe a partially written cache.
+static void writeCache(const CacheHeader* header, const void* code, size_t len) {
+    Path tmp = pathNew(cache.items);
+    LOGGING_LEVEL(EXT_NO_LOGGING) {
+        pathDirname(&tmp);
+        create_dir(tmp.items);
+
+        pathClear(&tmp);
+        pathAppend(&tmp, cache.items, cache.size);
+        sb_appendf(&tmp, ".%d.tmp", (int)getpid());
+
+        FILE* f = fopen(tmp.items, "wb");
+        if(f) {
+            bool ok = fwrite(header, sizeof(*header), 1, f) == 1;
+            ok = ok && fwrite(code, 1, len, f) == len;
+            ok = fclose(f) == 0 && ok;
+            if(!ok || !rename_file(tmp.items, cache.items)) {
+                delete_file(tmp.items);
+            }
+        }
+    }
+    pathFree(&tmp);
+}
+
+// Callback called by J* after compiling a source module. Stores the bytecode in the cache.
+static void cacheModuleCode(const void* code, size_t len, void* userData) {
+    (void)userData;
+    writeCache(&cacheHeader, code, len);
+}
+
+// Checks that the bytecode cache in `mf` has been produced by this version of J*.
+// On success, copies the cache header in `header`.
+static bool readCacheHeader(const MappedFile* mf, CacheHeader* header) {
+    if(mf->size <= sizeof(*header)) return false;
+    memcpy(header, mf->data, sizeof(*header));
+    return memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == JSTAR_VERSION && header->bytecodeVersion == JSTAR_BYTECODE_VERSION;
+}
+
+static void resetImportState(void) {
+    pathClear(&import);
+    pathClear(&nativeExt);
+    pathClear(&cache);
+}
+
 // Callback called by J* when an import statement is finished.
 // Used to reset global state and free the previously read code.
 static void finalizeImport(void* userData) {
-    pathClear(&import);
-    pathClear(&nativeExt);
+    resetImportState();
     char* data = userData;
     free(data);
 }
 
+// Same as above, but for memory mapped imports. The mapping is released in `releaseMappedCode`
+static void finalizeMappedImport(void* userData) {
+    (void)userData;
+    resetImportState();
+}
+
+// Callback called by J* once the code of a memory mapped import is no longer referenced
+static void releaseMappedCode(void* userData) {
+    unmapFile(userData);
+}
+
 // Creates a `JStarImportResult` and sets all relevant fields such as
 // the finalization callback and the native registry structure
 static JStarImportResult makeImportResult(const Path* path, StringBuffer sb) {
@@ -141,9 +362,140 @@ static JStarImportResult makeImportResult(const Path* path, StringBuffer sb) {
     res.path = path->items;
     res.reg = loadNativeExtension(path);
     res.userData = sb.items;
+    res.cacheCode = NULL;
+    res.releaseCode = NULL;
+    res.fallback = NULL;
+    return res;
+}
+
+// Same as above, but the code is the memory mapped file `mf` starting from `offset`.
+// J* will execute compiled code directly from the mapping, releasing it when no longer needed.
+static JStarImportResult makeMappedImportResult(const Path* path, MappedFile* mf, size_t offset) {
+    JStarImportResult res;
+    res.finalize = &finalizeMappedImport;
+    res.code = mf->data + offset;
+    res.codeLength = mf->size - offset;
+    res.path = path->items;
+    res.reg = loadNativeExtension(path);
+    res.userData = mf;
+    res.cacheCode = NULL;
+    res.releaseCode = &releaseMappedCode;
+    res.fallback = NULL;
+    return res;
+}
+
+// Import fallback of a bytecode cache that cannot be loaded, even though its header is valid.
+// Recompiles the module from the source being imported, rewriting the cache. The native extension
+// has already been loaded by the cached import result, so it's not loaded again
+static JStarImportResult importSourceFallback(void* userData) {
+    (void)userData;
+
+    StringBuffer sb = {.allocator = &default_allocator.base};
+    if(!readFileAtPath(&import, &sb)) {
+        return (JStarImportResult){0};
+    }
+
+    cacheHeader.sourceHash = hashSource(sb.items, sb.size);
+
+    JStarImportResult res = {0};
+    res.finalize = &finalizeImport;
+    res.code = sb.items ? sb.items : "";
+    res.codeLength = sb.size;
+    res.path = import.items;
+    res.userData = sb.items;
+    res.cacheCode = &cacheModuleCode;
     return res;
 }
 
+// Same as `makeMappedImportResult`, but for a bytecode cache of the source module at `path`
+static JStarImportResult makeCachedImportResult(const Path* path, MappedFile* mf) {
+    JStarImportResult res = makeMappedImportResult(path, mf, sizeof(CacheHeader));
+    res.fallback = &importSourceFallback;
+    return res;
+}
+
+// Imports the compiled module at `p`
+static bool importBinaryAtPath(const Path* p, JStarImportResult* res) {
+    MappedFile* mf = mapFileAtPath(p);
+    if(mf) {
+        *res = makeMappedImportResult(p, mf, 0);
+        return true;
+    }
+
+    StringBuffer sb = {.allocator = &default_allocator.base};
+    if(readFileAtPath(p, &sb)) {
+        *res = makeImportResult(p, sb);
+        return true;
+    }
+
+    return false;
+}
+
+// Imports the source module at `p`, using its bytecode cache if it is still up to date.
+// A stale cache is detected by the source's size and modification time; if they changed, the
+// source contents are hashed and compared before discarding the cache. The modification time is
+// compared up to the resolution of the filesystem on POSIX systems, but only up to the second
+// elsewhere, where an edit that keeps the size of the source within the same second is not
+// detected. A cache that fails to load is replaced by recompiling the source.
+static bool importSourceAtPath(const Path* p, JStarImportResult* res) {
+    StringBuffer sb = {.allocator = &default_allocator.base};
+
+    if(!cacheEnabled) {
+        if(!readFileAtPath(p, &sb)) return false;
+        *res = makeImportResult(p, sb);
+        return true;
+    }
+
+    struct stat st;
+    if(stat(p->items, &st) != 0) {
+        return false;
+    }
+
+    memcpy(cacheHeader.magic, CACHE_MAGIC, sizeof(cacheHeader.magic));
+    cacheHeader.version = JSTAR_VERSION;
+    cacheHeader.bytecodeVersion = JSTAR_BYTECODE_VERSION;
+    cacheHeader.sourceSize = st.st_size;
+    cacheHeader.sourceMtime = st.st_mtime;
+    cacheHeader.sourceMtimeNsec = MTIME_NSEC(st);
+    cacheHeader.sourceHash = 0;
+
+    setCachePath(p);
+
+    CacheHeader header;
+    MappedFile* cached = mapFileAtPath(&cache);
+    bool validCache = cached && readCacheHeader(cached, &header);
+
+    if(validCache && header.sourceSize == cacheHeader.sourceSize &&
+       header.sourceMtime == cacheHeader.sourceMtime &&
+       header.sourceMtimeNsec == cacheHeader.sourceMtimeNsec) {
+        *res = makeCachedImportResult(p, cached);
+        return true;
+    }
+
+    if(!readFileAtPath(p, &sb)) {
+        if(cached) unmapFile(cached);
+        return false;
+    }
+
+    cacheHeader.sourceHash = hashSource(sb.items, sb.size);
+
+    // The source has been touched, but its contents didn't change. Refresh the cache header so
+    // that subsequent imports can skip hashing
+    if(validCache && header.sourceHash == cacheHeader.sourceHash) {
+        writeCache(&cacheHeader, cached->data + sizeof(CacheHeader),
+                   cached->size - sizeof(CacheHeader));
+        sb_free(&sb);
+        *res = makeCachedImportResult(p, cached);
+        return true;
+    }
+
+    if(cached) unmapFile(cached);
+
+    *res = makeImportResult(p, sb);
+    res->cacheCode = &cacheModuleCode;
+    return true;
+}
+
 JStarImportResult importCallback(JStarVM* vm, const char* moduleName) {
     // Retrieve the import paths list from the core module
     if(!jsrGetGlobal(vm, JSR_CORE_MODULE, IMPORT_PATHS)) {
@@ -173,21 +525,21 @@ JStarImportResult importCallback(JStarVM* vm, const char* moduleName) {
 
         pathReplace(&import, moduleStart, ".", PATH_SEP_CHAR);
 
-        StringBuffer sb = {.allocator = &default_allocator.base};
+        JStarImportResult res;
 
         // Try loading a package (__package__ file inside a directory)
         pathJoinStr(&import, PACKAGE_FILE);
 
         // Try binary package
         pathChangeExtension(&import, JSC_EXT);
-        if(readFileAtPath(&import, &sb)) {
-            return (jsrPopN(vm, 2), makeImportResult(&import, sb));
+        if(importBinaryAtPath(&import, &res)) {
+            return (jsrPopN(vm, 2), res);
         }
 
         // Try source package
         pathChangeExtension(&import, JSR_EXT);
-        if(readFileAtPath(&import, &sb)) {
-            return (jsrPopN(vm, 2), makeImportResult(&import, sb));
+        if(importSourceAtPath(&import, &res)) {
+            return (jsrPopN(vm, 2), res);
         }
 
         // If no package is found, try to load a module
@@ -195,14 +547,14 @@ JStarImportResult importCallback(JStarVM* vm, const char* moduleName) {
 
         // Try binary module
         pathChangeExtension(&import, JSC_EXT);
-        if(readFileAtPath(&import, &sb)) {
-            return (jsrPopN(vm, 2), makeImportResult(&import, sb));
+        if(importBinaryAtPath(&import, &res)) {
+            return (jsrPopN(vm, 2), res);
         }
 
         // Try source module
         pathChangeExtension(&import, JSR_EXT);
-        if(readFileAtPath(&import, &sb)) {
-            return (jsrPopN(vm, 2), makeImportResult(&import, sb));
+        if(importSourceAtPath(&import, &res)) {
+            return (jsrPopN(vm, 2), res);
         }
 
         pathClear(&import);
@@ -6,7 +6,9 @@
 // Init the `importPaths` list by appending the script directory (or the current working
 // directory if `scriptPath` is NULL) and all the paths present in the JSTARPATH env variable.
 // All paths are converted to absolute ones.
-bool initImports(JStarVM* vm, const char* scriptPath, bool ignoreEnv);
+// Also sets up the bytecode cache of source modules, unless `disableCache` is true. The cache
+// directory can be overridden by the JSTARCACHE env variable.
+bool initImports(JStarVM* vm, const char* scriptPath, bool ignoreEnv, bool disableCache);
 // Frees all resources associated with the import system
 void freeImports(void);
 
@@ -28,6 +28,7 @@ typedef struct Options {
     bool skipVersion;
     bool interactive;
     bool ignoreEnv;
+    bool disableCache;
     bool disableColors;
     bool disableHints;
     char* execStmt;
@@ -257,6 +258,8 @@ static void parseArguments(int argc, char** argv) {
                     "Enter the REPL after executing 'script' and/or '-e' statement"),
         OPT_BOOLEAN('E', "ignore-env", &opts.ignoreEnv,
                     "Ignore environment variables such as JSTARPATH"),
+        OPT_BOOLEAN('B', "no-cache", &opts.disableCache,
+                    "Don't read or write the bytecode cache of imported modules"),
         OPT_BOOLEAN('C', "no-colors", &opts.disableColors,
                     "Disable output coloring. Hints are disabled as well"),
         OPT_BOOLEAN('H', "no-hints", &opts.disableHints, "Disable hinting support"),
@@ -298,7 +301,7 @@ static bool initApp(int argc, char** argv) {
     if(!vm) return false;
 
     jsrInitRuntime(vm);
-    if(!initImports(vm, opts.script, opts.ignoreEnv)) return false;
+    if(!initImports(vm, opts.script, opts.ignoreEnv, opts.disableCache)) return false;
 
     replxx = replxx_init();
     if(!replxx) return false;
@@ -0,0 +1,86 @@
+// Async benchmark.
+// Measures the throughput of an `async.Loop` multiplexing many pipes and socketpairs, each one
+// written with a single `sendAll` of a String larger than the pipe buffer by a task, and read until
+// EOF by another task. Fails if any of the readers doesn't receive all the data.
+// Run as `bench_async [channels] [kilobytes]`.
+
+#include <jstar/jstar.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_CHANNELS  64
+#define DEFAULT_KILOBYTES 1024
+
+static const char* code =
+    "fun writer(fd, data)\n"
+    "    yield async.sendAll(fd, data)\n"
+    "    async.close(fd)\n"
+    "end\n"
+    "fun reader(fd)\n"
+    "    var received = 0\n"
+    "    var data = yield async.recv(fd)\n"
+    "    while #data > 0\n"
+    "        received += #data\n"
+    "        data = yield async.recv(fd)\n"
+    "    end\n"
+    "    async.close(fd)\n"
+    "    return received\n"
+    "end\n"
+    "var loop = async.Loop()\n"
+    "var readers = []\n"
+    "for var i = 0; i < channels; i += 1\n"
+    "    var r, w = async.pipe() if i % 2 == 0 else async.socketpair()\n"
+    "    loop.spawn(writer(w, data))\n"
+    "    readers.add(loop.spawn(reader(r)))\n"
+    "end\n"
+    "loop.run()\n"
+    "loop.close()\n"
+    "var total = 0\n"
+    "for var t in readers\n"
+    "    assert(t.result() == #data, 'Short read: {0}' % t.result())\n"
+    "    total += t.result()\n"
+    "end\n";
+
+static double elapsedMs(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv) {
+    int channels = argc > 1 ? atoi(argv[1]) : DEFAULT_CHANNELS;
+    int kilobytes = argc > 2 ? atoi(argv[2]) : DEFAULT_KILOBYTES;
+    if(channels <= 0 || kilobytes <= 0) {
+        fprintf(stderr, "Usage: %s [channels] [kilobytes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    JStarConf conf = jsrGetConf();
+    JStarVM* vm = jsrNewVM(&conf);
+    jsrInitRuntime(vm);
+
+    char setup[128];
+    snprintf(setup, sizeof(setup),
+             "import async\n"
+             "var channels = %d\n"
+             "var data = 'z' * %d\n",
+             channels, kilobytes * 1024);
+
+    bool ok = jsrEvalString(vm, "setup", setup) == JSR_SUCCESS;
+    if(ok) {
+        clock_t start = clock();
+        ok = jsrEvalString(vm, "async", code) == JSR_SUCCESS;
+        double time = elapsedMs(start);
+
+        if(ok && jsrGetGlobal(vm, JSR_MAIN_MODULE, "total")) {
+            double mb = jsrGetNumber(vm, -1) / (1024 * 1024);
+            printf("%d channels of %d KB:\n", channels, kilobytes);
+            printf("  time:       %.1f ms\n", time);
+            printf("  throughput: %.1f MB/s\n", mb * 1000.0 / time);
+            jsrPop(vm);
+        }
+    }
+
+    jsrFreeVM(vm);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
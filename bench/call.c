@@ -0,0 +1,71 @@
+// Call benchmark.
+// Measures the time needed to call a J* function from C with `jsrCall` and with a prepared
+// call handle through `jsrInvokeHandle`. Run as `bench_call [calls]`.
+
+#include <jstar/jstar.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_CALLS 5000000
+
+static const char* handlers =
+    "var events = 0\n"
+    "fun onEvent(id, payload, weight=1)\n"
+    "    events += weight\n"
+    "end\n";
+
+static double elapsedNs(clock_t start, int calls) {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / calls;
+}
+
+static bool benchCall(JStarVM* vm, int calls) {
+    clock_t start = clock();
+    for(int i = 0; i < calls; i++) {
+        jsrPushValue(vm, -1);
+        jsrPushNumber(vm, i);
+        jsrPushNull(vm);
+        if(!jsrCall(vm, 2)) return false;
+        jsrPop(vm);
+    }
+    printf("jsrCall:         %.1f ns/call\n", elapsedNs(start, calls));
+    return true;
+}
+
+static bool benchInvokeHandle(JStarVM* vm, int calls) {
+    JStarCallHandle* h = jsrNewCallHandle(vm, -1, 2);
+    if(!h) return false;
+
+    clock_t start = clock();
+    for(int i = 0; i < calls; i++) {
+        jsrPushNumber(vm, i);
+        jsrPushNull(vm);
+        if(!jsrInvokeHandle(vm, h)) return false;
+        jsrPop(vm);
+    }
+    printf("jsrInvokeHandle: %.1f ns/call\n", elapsedNs(start, calls));
+
+    jsrFreeCallHandle(vm, h);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? atoi(argv[1]) : DEFAULT_CALLS;
+    if(calls <= 0) {
+        fprintf(stderr, "Usage: %s [calls]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    JStarVM* vm = jsrNewVM(NULL);
+    jsrInitRuntime(vm);
+
+    bool ok = jsrEvalString(vm, "<handlers>", handlers) == JSR_SUCCESS &&
+              jsrGetGlobal(vm, JSR_MAIN_MODULE, "onEvent");
+
+    printf("calls: %d\n", calls);
+    ok = ok && benchCall(vm, calls) && benchInvokeHandle(vm, calls);
+
+    jsrFreeVM(vm);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,105 @@
+// CSV benchmark.
+// Writes a large CSV file to a temporary file and measures the time needed to read it and sum one
+// of its columns, splitting lines with `String.split`, and with `csv.Reader` returning new rows,
+// reusing the same row and reading the whole file by column.
+// Run as `bench_csv [megabytes]`.
+
+#include <jstar/jstar.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_MEGABYTES 50
+#define CSV_PATH          "bench_csv.csv"
+
+// Fields contain no separators, so that splitting the lines yields the same columns
+static const char* split =
+    "var sum = 0\n"
+    "for var line in file\n"
+    "    var fields = line.split(',')\n"
+    "    sum += Number(fields[3])\n"
+    "end\n";
+
+static const char* rows =
+    "var sum = 0\n"
+    "for var row in csv.Reader(file, ',', '\"', false, types)\n"
+    "    sum += row[3]\n"
+    "end\n";
+
+static const char* reuse =
+    "var sum = 0\n"
+    "for var row in csv.Reader(file, ',', '\"', false, types, true)\n"
+    "    sum += row[3]\n"
+    "end\n";
+
+static const char* columns =
+    "var sum = 0\n"
+    "for var n in csv.Reader(file, ',', '\"', false, types).readColumns()[3]\n"
+    "    sum += n\n"
+    "end\n";
+
+static double elapsedMs(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static bool generateCSV(const char* path, size_t size) {
+    FILE* csv = fopen(path, "w");
+    if(!csv) return false;
+
+    size_t len = 0;
+    for(unsigned i = 0; len < size; i++) {
+        int written = fprintf(csv, "%u,\"user %u\",city-%u,%u.%02u,2024-03-%02u,%s\r\n", i, i,
+                              i % 500, i % 10000, i % 100, i % 28 + 1, i % 3 ? "ok" : "failed");
+        if(written < 0) break;
+        len += written;
+    }
+
+    return fclose(csv) == 0 && len >= size;
+}
+
+static bool benchmark(JStarVM* vm, const char* name, const char* code) {
+    if(jsrEvalString(vm, name, "file.rewind()") != JSR_SUCCESS) return false;
+
+    clock_t start = clock();
+    if(jsrEvalString(vm, name, code) != JSR_SUCCESS) return false;
+    double time = elapsedMs(start);
+
+    if(!jsrGetGlobal(vm, JSR_MAIN_MODULE, "sum")) return false;
+    printf("%s:\n", name);
+    printf("  sum:  %.2f\n", jsrGetNumber(vm, -1));
+    printf("  time: %.1f ms\n", time);
+    jsrPop(vm);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int megabytes = argc > 1 ? atoi(argv[1]) : DEFAULT_MEGABYTES;
+    if(megabytes <= 0) {
+        fprintf(stderr, "Usage: %s [megabytes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if(!generateCSV(CSV_PATH, (size_t)megabytes * 1024 * 1024)) {
+        fprintf(stderr, "Cannot write %s\n", CSV_PATH);
+        remove(CSV_PATH);
+        return EXIT_FAILURE;
+    }
+
+    JStarConf conf = jsrGetConf();
+    JStarVM* vm = jsrNewVM(&conf);
+    jsrInitRuntime(vm);
+
+    const char* setup =
+        "import io\n"
+        "import csv\n"
+        "var file = io.File('" CSV_PATH "', 'r')\n"
+        "var types = [Number, String, String, Number]\n";
+    bool ok = jsrEvalString(vm, "setup", setup) == JSR_SUCCESS &&
+              benchmark(vm, "split", split) && benchmark(vm, "Reader", rows) &&
+              benchmark(vm, "Reader (reuse)", reuse) && benchmark(vm, "readColumns", columns);
+
+    jsrFreeVM(vm);
+    remove(CSV_PATH);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
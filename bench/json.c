@@ -0,0 +1,233 @@
+// JSON benchmark.
+// Measures the throughput of parsing and serializing a large JSON document with the `json` module,
+// and with a parser and a serializer written in J* on top of String subscripts and Table inserts.
+// Run as `bench_json [records]`.
+
+#include <jstar/jstar.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_RECORDS 20000
+
+// A minimal JSON parser and serializer in J*, handling only what the generated document contains
+static const char* baseline =
+    "class Parser\n"
+    "    construct(s)\n"
+    "        this.s = s\n"
+    "        this.i = 0\n"
+    "    end\n"
+    "    fun skipSpace()\n"
+    "        var c = this.s[this.i]\n"
+    "        while c == ' ' or c == '\\n' or c == '\\t' or c == '\\r'\n"
+    "            this.i += 1\n"
+    "            c = this.s[this.i]\n"
+    "        end\n"
+    "        return c\n"
+    "    end\n"
+    "    fun value()\n"
+    "        var c = this.skipSpace()\n"
+    "        if c == '{'\n"
+    "            return this.object()\n"
+    "        elif c == '['\n"
+    "            return this.array()\n"
+    "        elif c == '\"'\n"
+    "            return this.string()\n"
+    "        elif c == 't'\n"
+    "            this.i += 4\n"
+    "            return true\n"
+    "        elif c == 'f'\n"
+    "            this.i += 5\n"
+    "            return false\n"
+    "        elif c == 'n'\n"
+    "            this.i += 4\n"
+    "            return null\n"
+    "        end\n"
+    "        return this.number()\n"
+    "    end\n"
+    "    fun object()\n"
+    "        var t = {}\n"
+    "        this.i += 1\n"
+    "        if this.skipSpace() == '}'\n"
+    "            this.i += 1\n"
+    "            return t\n"
+    "        end\n"
+    "        while true\n"
+    "            this.skipSpace()\n"
+    "            var k = this.string()\n"
+    "            this.skipSpace()\n"
+    "            this.i += 1\n"
+    "            t[k] = this.value()\n"
+    "            var c = this.skipSpace()\n"
+    "            this.i += 1\n"
+    "            if c == '}'\n"
+    "                return t\n"
+    "            end\n"
+    "        end\n"
+    "    end\n"
+    "    fun array()\n"
+    "        var l = []\n"
+    "        this.i += 1\n"
+    "        if this.skipSpace() == ']'\n"
+    "            this.i += 1\n"
+    "            return l\n"
+    "        end\n"
+    "        while true\n"
+    "            l.add(this.value())\n"
+    "            var c = this.skipSpace()\n"
+    "            this.i += 1\n"
+    "            if c == ']'\n"
+    "                return l\n"
+    "            end\n"
+    "        end\n"
+    "    end\n"
+    "    fun string()\n"
+    "        this.i += 1\n"
+    "        var start = this.i\n"
+    "        var c = this.s[this.i]\n"
+    "        while c != '\"'\n"
+    "            if c == '\\\\'\n"
+    "                this.i += 1\n"
+    "            end\n"
+    "            this.i += 1\n"
+    "            c = this.s[this.i]\n"
+    "        end\n"
+    "        this.i += 1\n"
+    "        return this.s[start, this.i - 1]\n"
+    "    end\n"
+    "    fun number()\n"
+    "        var start = this.i\n"
+    "        var c = this.s[this.i]\n"
+    "        while c != ',' and c != ']' and c != '}' and c != ' ' and c != '\\n'\n"
+    "            this.i += 1\n"
+    "            c = this.s[this.i]\n"
+    "        end\n"
+    "        return Number(this.s[start, this.i])\n"
+    "    end\n"
+    "end\n"
+    "fun dumpValue(v, sb)\n"
+    "    if v == null\n"
+    "        sb.append('null')\n"
+    "    elif v is String\n"
+    "        sb.append('\"')\n"
+    "        sb.append(v)\n"
+    "        sb.append('\"')\n"
+    "    elif v is List\n"
+    "        sb.append('[')\n"
+    "        for var i = 0; i < #v; i += 1\n"
+    "            if i > 0\n"
+    "                sb.append(',')\n"
+    "            end\n"
+    "            dumpValue(v[i], sb)\n"
+    "        end\n"
+    "        sb.append(']')\n"
+    "    elif v is Table\n"
+    "        sb.append('{')\n"
+    "        var first = true\n"
+    "        for var k in v\n"
+    "            if !first\n"
+    "                sb.append(',')\n"
+    "            end\n"
+    "            first = false\n"
+    "            dumpValue(k, sb)\n"
+    "            sb.append(':')\n"
+    "            dumpValue(v[k], sb)\n"
+    "        end\n"
+    "        sb.append('}')\n"
+    "    else\n"
+    "        sb.append(v)\n"
+    "    end\n"
+    "end\n"
+    "fun dump(v)\n"
+    "    var sb = StringBuilder()\n"
+    "    dumpValue(v, sb)\n"
+    "    return sb.__string__()\n"
+    "end\n";
+
+// Regression check run before the benchmarks: the object keys cached by `json.parse` must stay
+// alive after the objects they were first created for are discarded, here by the duplicate key
+// "a", and the strings of "c" are collected
+static const char* keyCacheCheck =
+    "var key = 'b' * 31\n"
+    "var check = json.parse('{\"a\": {\"' + key + '\": 1}, \"a\": 2, \"c\": [' +\n"
+    "                       '\"x\", ' * 100000 + '\"x\"], \"d\": {\"' + key + '\": 3}}')\n"
+    "assert(check['a'] == 2 and #check['c'] == 100001 and check['d'][key] == 3, 'Bad key cache')\n";
+
+static const char* nativeParse = "var value = json.parse(doc)\n";
+static const char* nativeDump = "var out = json.dump(value)\n";
+static const char* baselineParse = "var value = Parser(doc).value()\n";
+static const char* baselineDump = "var out = dump(value)\n";
+
+static double elapsedMs(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static char* generateDocument(int records, size_t* length) {
+    size_t cap = (size_t)records * 256 + 16;
+    char* doc = malloc(cap);
+    if(!doc) return NULL;
+
+    size_t len = 0;
+    doc[len++] = '[';
+    for(int i = 0; i < records; i++) {
+        len += sprintf(doc + len,
+                       "%s\n  {\"id\": %d, \"name\": \"user-%d\", \"email\": \"user%d@example.com\", "
+                       "\"active\": %s, \"score\": %d.%02d, \"tags\": [\"alpha\", \"beta\", "
+                       "\"gamma\"], \"address\": {\"city\": \"City %d\", \"zip\": \"%05d\", "
+                       "\"geo\": [%d.5, -%d.25]}, \"manager\": null}",
+                       i ? "," : "", i, i, i, i % 3 ? "true" : "false", i % 1000, i % 100, i % 50,
+                       i % 100000, i % 90, i % 180);
+    }
+    len += sprintf(doc + len, "\n]\n");
+
+    *length = len;
+    return doc;
+}
+
+static bool benchmark(JStarVM* vm, const char* name, const char* code, size_t bytes) {
+    clock_t start = clock();
+    if(jsrEvalString(vm, name, code) != JSR_SUCCESS) return false;
+    double time = elapsedMs(start);
+
+    printf("%s:\n", name);
+    printf("  time:       %.1f ms\n", time);
+    printf("  throughput: %.1f MB/s\n", bytes / (time / 1000.0) / (1024 * 1024));
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int records = argc > 1 ? atoi(argv[1]) : DEFAULT_RECORDS;
+    if(records <= 0) {
+        fprintf(stderr, "Usage: %s [records]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t length;
+    char* doc = generateDocument(records, &length);
+    if(!doc) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    JStarConf conf = jsrGetConf();
+    JStarVM* vm = jsrNewVM(&conf);
+    jsrInitRuntime(vm);
+
+    jsrPushStringSz(vm, doc, length);
+    jsrSetGlobal(vm, JSR_MAIN_MODULE, "doc");
+    jsrPop(vm);
+    free(doc);
+
+    printf("document: %zu bytes\n", length);
+    bool ok = jsrEvalString(vm, "setup", "import json") == JSR_SUCCESS &&
+              jsrEvalString(vm, "setup", baseline) == JSR_SUCCESS &&
+              jsrEvalString(vm, "check", keyCacheCheck) == JSR_SUCCESS &&
+              benchmark(vm, "J* parse", baselineParse, length) &&
+              benchmark(vm, "J* dump", baselineDump, length) &&
+              benchmark(vm, "json.parse", nativeParse, length) &&
+              benchmark(vm, "json.dump", nativeDump, length);
+
+    jsrFreeVM(vm);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+// Line reading benchmark.
+// Writes a large log to a temporary file and measures the time needed to read it line by line
+// with `File.readLine`, with a `for` loop over the file and in batches with `File.readLines`.
+// Run as `bench_lines [megabytes]`.
+
+#include <jstar/jstar.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_MEGABYTES 100
+#define LOG_PATH          "bench_lines.log"
+
+static const char* readLine =
+    "var lines = 0\n"
+    "var line = file.readLine()\n"
+    "while line\n"
+    "    lines += 1\n"
+    "    line = file.readLine()\n"
+    "end\n";
+
+static const char* forLoop =
+    "var lines = 0\n"
+    "for var line in file\n"
+    "    lines += 1\n"
+    "end\n";
+
+static const char* readLines =
+    "var lines = 0\n"
+    "var batch = file.readLines(1024)\n"
+    "while #batch > 0\n"
+    "    lines += #batch\n"
+    "    batch = file.readLines(1024)\n"
+    "end\n";
+
+static double elapsedMs(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static bool generateLog(const char* path, size_t size) {
+    FILE* log = fopen(path, "w");
+    if(!log) return false;
+
+    size_t len = 0;
+    for(unsigned i = 0; len < size; i++) {
+        int written = fprintf(log,
+                              "2024-03-%02u 12:%02u:%02u.%03u INFO [worker-%u] GET /api/v1/items/%u "
+                              "status=200 bytes=%u latency=%ums\n",
+                              i % 28 + 1, i % 60, i / 60 % 60, i % 1000, i % 16, i, i * 7 % 65536,
+                              i % 250);
+        if(written < 0) break;
+        len += written;
+    }
+
+    return fclose(log) == 0 && len >= size;
+}
+
+static bool benchmark(JStarVM* vm, const char* name, const char* code) {
+    if(jsrEvalString(vm, name, "file.rewind()") != JSR_SUCCESS) return false;
+
+    clock_t start = clock();
+    if(jsrEvalString(vm, name, code) != JSR_SUCCESS) return false;
+    double time = elapsedMs(start);
+
+    if(!jsrGetGlobal(vm, JSR_MAIN_MODULE, "lines")) return false;
+    printf("%s:\n", name);
+    printf("  lines: %.0f\n", jsrGetNumber(vm, -1));
+    printf("  time:  %.1f ms\n", time);
+    jsrPop(vm);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int megabytes = argc > 1 ? atoi(argv[1]) : DEFAULT_MEGABYTES;
+    if(megabytes <= 0) {
+        fprintf(stderr, "Usage: %s [megabytes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if(!generateLog(LOG_PATH, (size_t)megabytes * 1024 * 1024)) {
+        fprintf(stderr, "Cannot write %s\n", LOG_PATH);
+        remove(LOG_PATH);
+        return EXIT_FAILURE;
+    }
+
+    JStarConf conf = jsrGetConf();
+    JStarVM* vm = jsrNewVM(&conf);
+    jsrInitRuntime(vm);
+
+    const char* open = "import io\nvar file = io.File('" LOG_PATH "', 'r')\n";
+    bool ok = jsrEvalString(vm, "open", open) == JSR_SUCCESS && benchmark(vm, "readLine", readLine) && benchmark(vm, "for", forLoop) &&
+         benchmark(vm, "readLines", readLines);
+
+    jsrFreeVM(vm);
+    remove(LOG_PATH);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,101 @@
+// Split benchmark.
+// Measures the time and peak memory needed to split a large log in lines with `String.split`,
+// and then each line in its fields. Run as `bench_split [megabytes]`.
+
+#include <jstar/jstar.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_MEGABYTES 100
+
+static const char* splitLines = "var lines = log.split('\\n')\n";
+
+static const char* splitFields =
+    "var fields = 0\n"
+    "for var line in lines\n"
+    "    fields += #line.split(' ')\n"
+    "end\n";
+
+static size_t allocated, peak;
+
+// Allocator that keeps track of the peak memory used by the VM
+static void* countingRealloc(void* ptr, size_t oldSz, size_t newSz) {
+    allocated += newSz;
+    allocated -= oldSz;
+    if(allocated > peak) peak = allocated;
+
+    if(newSz == 0) {
+        free(ptr);
+        return NULL;
+    }
+    return realloc(ptr, newSz);
+}
+
+static double elapsedMs(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static char* generateLog(size_t size, size_t* length) {
+    char* log = malloc(size + 256);
+    if(!log) return NULL;
+
+    size_t len = 0;
+    for(unsigned i = 0; len < size; i++) {
+        len += sprintf(log + len,
+                       "2024-03-%02u 12:%02u:%02u.%03u INFO [worker-%u] GET /api/v1/items/%u "
+                       "status=200 bytes=%u latency=%ums\n",
+                       i % 28 + 1, i % 60, i / 60 % 60, i % 1000, i % 16, i, i * 7 % 65536,
+                       i % 250);
+    }
+
+    *length = len;
+    return log;
+}
+
+static bool benchmark(JStarVM* vm, const char* name, const char* code) {
+    size_t startMem = allocated;
+    peak = allocated;
+
+    clock_t start = clock();
+    if(jsrEvalString(vm, name, code) != JSR_SUCCESS) return false;
+    double time = elapsedMs(start);
+
+    printf("%s:\n", name);
+    printf("  time:        %.1f ms\n", time);
+    printf("  peak memory: %zu bytes\n", peak - startMem);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int megabytes = argc > 1 ? atoi(argv[1]) : DEFAULT_MEGABYTES;
+    if(megabytes <= 0) {
+        fprintf(stderr, "Usage: %s [megabytes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t length;
+    char* log = generateLog((size_t)megabytes * 1024 * 1024, &length);
+    if(!log) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    JStarConf conf = jsrGetConf();
+    conf.realloc = &countingRealloc;
+
+    JStarVM* vm = jsrNewVM(&conf);
+    jsrInitRuntime(vm);
+
+    jsrPushStringSz(vm, log, length);
+    jsrSetGlobal(vm, JSR_MAIN_MODULE, "log");
+    jsrPop(vm);
+    free(log);
+
+    printf("log: %zu bytes\n", length);
+    bool ok = benchmark(vm, "lines", splitLines) && benchmark(vm, "fields", splitFields);
+
+    jsrFreeVM(vm);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
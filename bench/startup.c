@@ -0,0 +1,145 @@
+// Startup benchmark.
+// Measures the time and memory needed to create a VM, initialize the runtime and import all the
+// modules of the standard library, both from scratch and by restoring a snapshot of a runtime with
+// the standard library already loaded. Run as `bench_startup [runs]`.
+
+#include <jstar/jstar.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_RUNS 1000
+
+static const char* stdlibImports =
+#ifdef JSTAR_SYS
+    "import sys\n"
+#endif
+#ifdef JSTAR_IO
+    "import io\n"
+#endif
+#ifdef JSTAR_MATH
+    "import math\n"
+#endif
+#ifdef JSTAR_DEBUG
+    "import debug\n"
+#endif
+#ifdef JSTAR_RE
+    "import re\n"
+#endif
+#ifdef JSTAR_STRUCT
+    "import struct\n"
+#endif
+#ifdef JSTAR_JSON
+    "import json\n"
+#endif
+#ifdef JSTAR_CSV
+    "import csv\n"
+#endif
+#ifdef JSTAR_ASYNC
+    "import async\n"
+#endif
+    "";
+
+static size_t allocated;
+
+// Allocator that keeps track of the memory used by the VM
+static void* countingRealloc(void* ptr, size_t oldSz, size_t newSz) {
+    allocated += newSz;
+    allocated -= oldSz;
+
+    if(newSz == 0) {
+        free(ptr);
+        return NULL;
+    }
+    return realloc(ptr, newSz);
+}
+
+static double elapsedMs(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static bool benchmark(const char* name, const JStarConf* conf, int runs) {
+    double initMs = 0, importMs = 0;
+    size_t startupMem = 0;
+
+    for(int i = 0; i < runs; i++) {
+        size_t allocatedBefore = allocated;
+
+        clock_t start = clock();
+        JStarVM* vm = jsrNewVM(conf);
+        jsrInitRuntime(vm);
+        initMs += elapsedMs(start);
+
+        start = clock();
+        JStarResult res = jsrEvalString(vm, "<startup>", stdlibImports);
+        importMs += elapsedMs(start);
+
+        if(res != JSR_SUCCESS) {
+            jsrFreeVM(vm);
+            return false;
+        }
+
+        startupMem = allocated - allocatedBefore;
+        jsrFreeVM(vm);
+    }
+
+    printf("%s (%d runs)\n", name, runs);
+    printf("  runtime init:  %.3f ms\n", initMs / runs);
+    printf("  stdlib import: %.3f ms\n", importMs / runs);
+    printf("  total:         %.3f ms\n", (initMs + importMs) / runs);
+    printf("  memory:        %zu bytes\n", startupMem);
+
+    return true;
+}
+
+// Snapshot a runtime with the whole standard library imported. The snapshot buffer is owned by
+// the VM, so it is copied out before freeing it
+static void* takeSnapshot(const JStarConf* conf, size_t* len) {
+    JStarVM* vm = jsrNewVM(conf);
+    jsrInitRuntime(vm);
+
+    void* snapshot = NULL;
+    JStarBuffer buf;
+    if(jsrEvalString(vm, "<startup>", stdlibImports) == JSR_SUCCESS &&
+       jsrSnapshotRuntime(vm, &buf)) {
+        snapshot = malloc(buf.size);
+        memcpy(snapshot, buf.data, buf.size);
+        *len = buf.size;
+        jsrBufferFree(&buf);
+    }
+
+    jsrFreeVM(vm);
+    return snapshot;
+}
+
+int main(int argc, char** argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : DEFAULT_RUNS;
+    if(runs <= 0) {
+        fprintf(stderr, "Usage: %s [runs]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    JStarConf conf = jsrGetConf();
+    conf.realloc = &countingRealloc;
+
+    if(!benchmark("from scratch", &conf, runs)) {
+        return EXIT_FAILURE;
+    }
+
+    size_t snapshotLen;
+    void* snapshot = takeSnapshot(&conf, &snapshotLen);
+    if(snapshot == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    conf.snapshot = snapshot;
+    conf.snapshotLength = snapshotLen;
+
+    printf("\nsnapshot size: %zu bytes\n", snapshotLen);
+    bool ok = benchmark("from snapshot", &conf, runs);
+
+    free(snapshot);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
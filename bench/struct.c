@@ -0,0 +1,118 @@
+// Struct benchmark.
+// Measures the time needed to decode a large buffer of fixed-layout binary records, assembling
+// the fields byte by byte in J*, with `struct.unpackFrom` and with `struct.iterUnpack`.
+// Run as `bench_struct [records]`.
+
+#include <jstar/jstar.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_RECORDS 1000000
+#define RECORD_SIZE     12
+
+// Records are "<IIHH": two little endian uint32 followed by two little endian uint16.
+// `String.charAt` returns signed bytes, so the manual decoder has to mask them
+static const char* manual =
+    "fun byte(s, i)\n"
+    "    return s.charAt(i) & 255\n"
+    "end\n"
+    "var sum = 0\n"
+    "var i = 0\n"
+    "while i < #data\n"
+    "    var id = byte(data, i) | (byte(data, i + 1) << 8) | (byte(data, i + 2) << 16) |\n"
+    "        (byte(data, i + 3) << 24)\n"
+    "    var val = byte(data, i + 4) | (byte(data, i + 5) << 8) | (byte(data, i + 6) << 16) |\n"
+    "        (byte(data, i + 7) << 24)\n"
+    "    var kind = byte(data, i + 8) | (byte(data, i + 9) << 8)\n"
+    "    var flags = byte(data, i + 10) | (byte(data, i + 11) << 8)\n"
+    "    sum += id + val + kind + flags\n"
+    "    i += 12\n"
+    "end\n";
+
+static const char* unpackFrom =
+    "var sum = 0\n"
+    "var i = 0\n"
+    "while i < #data\n"
+    "    var id, val, kind, flags = struct.unpackFrom('<IIHH', data, i)\n"
+    "    sum += id + val + kind + flags\n"
+    "    i += 12\n"
+    "end\n";
+
+static const char* iterUnpack =
+    "var sum = 0\n"
+    "for var record in struct.iterUnpack('<IIHH', data)\n"
+    "    var id, val, kind, flags = record\n"
+    "    sum += id + val + kind + flags\n"
+    "end\n";
+
+static double elapsedMs(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static void putLE(unsigned char* p, uint32_t v, int size) {
+    for(int i = 0; i < size; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static unsigned char* generateRecords(size_t count) {
+    unsigned char* data = malloc(count * RECORD_SIZE);
+    if(!data) return NULL;
+
+    for(size_t i = 0; i < count; i++) {
+        unsigned char* record = data + i * RECORD_SIZE;
+        putLE(record, (uint32_t)i, 4);
+        putLE(record + 4, (uint32_t)(i * 2654435761u % 2147483648u), 4);
+        putLE(record + 8, (uint32_t)(i % 7), 2);
+        putLE(record + 10, (uint32_t)(i * 31 % 65536), 2);
+    }
+
+    return data;
+}
+
+static bool benchmark(JStarVM* vm, const char* name, const char* code) {
+    clock_t start = clock();
+    if(jsrEvalString(vm, name, code) != JSR_SUCCESS) return false;
+    double time = elapsedMs(start);
+
+    if(!jsrGetGlobal(vm, JSR_MAIN_MODULE, "sum")) return false;
+    printf("%s:\n", name);
+    printf("  sum:  %.0f\n", jsrGetNumber(vm, -1));
+    printf("  time: %.1f ms\n", time);
+    jsrPop(vm);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int records = argc > 1 ? atoi(argv[1]) : DEFAULT_RECORDS;
+    if(records <= 0) {
+        fprintf(stderr, "Usage: %s [records]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    unsigned char* data = generateRecords(records);
+    if(!data) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    JStarConf conf = jsrGetConf();
+    JStarVM* vm = jsrNewVM(&conf);
+    jsrInitRuntime(vm);
+
+    jsrPushStringSz(vm, (const char*)data, (size_t)records * RECORD_SIZE);
+    jsrSetGlobal(vm, JSR_MAIN_MODULE, "data");
+    jsrPop(vm);
+    free(data);
+
+    printf("records: %d\n", records);
+    bool ok = jsrEvalString(vm, "import", "import struct") == JSR_SUCCESS &&
+              benchmark(vm, "manual", manual) && benchmark(vm, "unpackFrom", unpackFrom) &&
+              benchmark(vm, "iterUnpack", iterUnpack);
+
+    jsrFreeVM(vm);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -11,6 +11,9 @@
 #define JSTAR_VERSION \
     (JSTAR_VERSION_MAJOR * 100000 + JSTAR_VERSION_MINOR * 1000 + JSTAR_VERSION_PATCH)
 
+// Version of the compiled bytecode format. Increased on every incompatible change to the format
+#define JSTAR_BYTECODE_VERSION 2
+
 // compiler and platform on which this J* binary was compiled
 #define JSTAR_COMPILER "GNU 16.1.1"
 #define JSTAR_PLATFORM "Linux"
@@ -29,6 +32,10 @@
 #define JSTAR_MATH
 #define JSTAR_DEBUG
 #define JSTAR_RE
+#define JSTAR_STRUCT
+#define JSTAR_JSON
+#define JSTAR_CSV
+#define JSTAR_ASYNC
 
 // Platform detection
 #if defined(_WIN32) && (defined(__WIN32__) || defined(WIN32) || defined(__MINGW32__))
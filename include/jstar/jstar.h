@@ -52,6 +52,9 @@ typedef void* (*JStarRealloc)(void* ptr, size_t oldSz, size_t newSz);
 // JStarSymbol is an handle to a resolved method, field or global variable
 typedef struct JStarSymbol JStarSymbol;
 
+// JStarCallHandle is an handle to a callable prepared for repeated calls
+typedef struct JStarCallHandle JStarCallHandle;
+
 // Generic error code used by several J* API functions
 typedef enum JStarResult {
     JSR_SUCCESS,          // The VM successfully executed the code
@@ -70,6 +73,21 @@ typedef struct JStarImportResult {
     JStarNativeReg* reg;      // Resolved native registry for the module (can be NULL)
     void (*finalize)(void*);  // Finalization callback. Called after a resolved import (can be NULL)
     void* userData;           // Custom user data passed to the finalization function (can be NULL)
+    // Bytecode cache callback. Called with the serialized module bytecode after successfully
+    // compiling source code, so that it can be stored and returned on subsequent imports in place
+    // of the source (can be NULL). Called before `finalize` with the same `userData`.
+    void (*cacheCode)(const void* code, size_t len, void* userData);
+    // Compiled code release callback (can be NULL). If set, the VM takes over the lifetime of a
+    // compiled `code`: its bytecode is executed in place, without copying it, and `releaseCode` is
+    // called with `userData` once all the functions referencing it have been collected. This makes
+    // it possible to directly load memory mapped files. If `code` is source code, it's called
+    // right after `finalize`.
+    void (*releaseCode)(void* userData);
+    // Fallback callback (can be NULL). Called with `userData` if `code` is compiled code that fails
+    // to load, before `finalize`. The module is then imported from the result it returns, for
+    // example from the module source in place of a damaged bytecode cache. Errors in `code` are not
+    // reported in this case, and the returned result can't have a fallback itself.
+    struct JStarImportResult (*fallback)(void* userData);
 } JStarImportResult;
 
 // -----------------------------------------------------------------------------
@@ -101,6 +119,12 @@ typedef struct JstarConf {
     JStarImportCB importCallback;   // Import callback (can be NULL)
     JStarRealloc realloc;           // Allocation callback (can be NULL)
     void* userData;                 // User data associated with the VM (can be NULL)
+    const void* snapshot;           // Runtime snapshot to initialize the VM from (can be NULL, must
+                                    // outlive the VM)
+    size_t snapshotLength;          // Length of the snapshot field
+    uint64_t hashSeed;              // Seed of the string hash function (0 picks a random one per
+                                    // VM). Ignored when restoring a snapshot: all the VMs restored
+                                    // from the same snapshot share the seed it was created with
 } JStarConf;
 
 // Retuns a JStarConf struct initialized with default values
@@ -113,8 +137,25 @@ JSTAR_API JStarConf jsrGetConf(void);
 JSTAR_API JStarVM* jsrNewVM(const JStarConf* conf);
 
 // Inits the J* runtime, including the core and main module. Must be called prior to executing code.
+// If the VM has been configured with a `snapshot`, the runtime is restored from it instead, which
+// is considerably faster. The bytecode stored in the snapshot is referenced in place, so that VMs
+// restored from the same snapshot share it: the snapshot memory must outlive the VM.
+// If the snapshot is malformed or has been created by an incompatible build (or by another process,
+// if it contains process-specific pointers) the error is reported through the error callback, and
+// the runtime is initialized as usual.
 JSTAR_API void jsrInitRuntime(JStarVM* vm);
 
+// Takes a snapshot of the initialized runtime: the core module, the interned strings and all the
+// loaded modules, along with everything reachable from them. The snapshot can then be used to
+// quickly initialize new VMs (see `JStarConf.snapshot`).
+// Must be called outside of code execution. Generators, Userdata, and Tables with keys other than
+// Numbers, Booleans or Strings can't be snapshotted. Natives from embedder registries and handles
+// other than the standard streams are stored as raw pointers, making the snapshot only valid in
+// the current process.
+// On success, returns true and sets `out` to a buffer owned by `vm` containing the snapshot.
+// On error, returns false and reports the error through the error callback.
+JSTAR_API bool jsrSnapshotRuntime(JStarVM* vm, JStarBuffer* out);
+
 // Free a previously obtained VM along with all of its state
 JSTAR_API void jsrFreeVM(JStarVM* vm);
 
@@ -137,7 +178,12 @@ JSTAR_API void jsrEvalBreak(JStarVM* vm);
 // different cached operations, otherwise a previous cached lookup may be reused incorrectly.
 JSTAR_API JStarSymbol* jsrNewSymbol(JStarVM* vm);
 
-// Frees a symbol created with `jsrNewSymbol`
+// Similar to the above, but binds the symbol to the name it looks up, interning it once on
+// creation. Cached functions called with a named symbol ignore their `name` argument (that can be
+// NULL), skipping the hashing and interning of the name on every call.
+JSTAR_API JStarSymbol* jsrNewSymbolNamed(JStarVM* vm, const char* name);
+
+// Frees a symbol created with `jsrNewSymbol` or `jsrNewSymbolNamed`
 JSTAR_API void jsrFreeSymbol(JStarVM* vm, JStarSymbol* sym);
 
 // -----------------------------------------------------------------------------
@@ -188,6 +234,25 @@ JSTAR_API bool jsrCallMethod(JStarVM* vm, const char* name, uint8_t argc);
 // Can be more efficient if the same method is called multiple times on the same object type.
 JSTAR_API bool jsrCallMethodCached(JStarVM* vm, const char* name, uint8_t argc, JStarSymbol* sym);
 
+// Create a call handle for calling the callable at `slot` with `argc` arguments.
+// The handle keeps the callable alive, and performs the checks needed to call it (such as arity
+// checks) only once, so that it can be called repeatedly with `jsrInvokeHandle` faster than with
+// `jsrCall`.
+// Returns NULL if the value is not callable, or if it cannot be called with `argc` arguments,
+// leaving an exception on top of the stack.
+JSTAR_API JStarCallHandle* jsrNewCallHandle(JStarVM* vm, int slot, uint8_t argc);
+
+// Frees a call handle created with `jsrNewCallHandle`
+JSTAR_API void jsrFreeCallHandle(JStarVM* vm, JStarCallHandle* h);
+
+// Call the callable of a handle with the `argc` arguments sitting on top of the stack.
+// Differently from `jsrCall`, the callable should not be pushed on the stack:
+//
+//  ... [arg1][arg2]...[argn] $top
+//
+// The result (or the raised exception) is placed in place of the arguments as in `jsrCall`.
+JSTAR_API bool jsrInvokeHandle(JStarVM* vm, const JStarCallHandle* h);
+
 // -----------------------------------------------------------------------------
 // C TO J* VALUE CONVERSION API
 // -----------------------------------------------------------------------------
@@ -205,6 +270,22 @@ JSTAR_API void jsrPushTable(JStarVM* vm);
 JSTAR_API void jsrPushValue(JStarVM* vm, int slot);
 JSTAR_API void* jsrPushUserdata(JStarVM* vm, size_t size, void (*finalize)(void*));
 
+// Bulk conversion functions. They push a List or a Tuple containing all the `count` elements of
+// a C array, allocating it in one go.
+JSTAR_API void jsrPushNumberList(JStarVM* vm, const double* numbers, size_t count);
+JSTAR_API void jsrPushNumberTuple(JStarVM* vm, const double* numbers, size_t count);
+JSTAR_API void jsrPushStringList(JStarVM* vm, const char* const* strings, size_t count);
+JSTAR_API void jsrPushStringTuple(JStarVM* vm, const char* const* strings, size_t count);
+
+// Push a String that references `length` bytes of embedder memory instead of copying them.
+// The memory must remain valid and unchanged until `release` (if not NULL) gets called with
+// `userData`, which happens when the String is collected. Use this to pass large buffers to
+// scripts cheaply.
+// `data` doesn't need to be NUL terminated, and neither are the slices taken from the String:
+// the VM only reads them within their length, and `jsrGetString` returns a terminated copy.
+JSTAR_API void jsrPushExternalString(JStarVM* vm, const char* data, size_t length,
+                                     void (*release)(void* userData), void* userData);
+
 // Push a native function to the top of the stack.
 //
 // If the passed in `moduleName` is NULL, the native will be registered in the current module if
@@ -240,7 +321,13 @@ JSTAR_API size_t jsrGetStringSz(const JStarVM* vm, int slot);
 // outside the native where it was retrieved. Also, be careful when popping the original ObjString
 // from the stack  while retaining this buffer, because if a GC occurs and the string is not found
 // to be reachable it'll be collected.
-JSTAR_API const char* jsrGetString(const JStarVM* vm, int slot);
+// The returned string is always NUL terminated: the contents of external Strings (see
+// `jsrPushExternalString`) are copied in J* memory the first time they are retrieved.
+JSTAR_API const char* jsrGetString(JStarVM* vm, int slot);
+
+// Same as above, but returns the characters of the String in place, without copying them, and
+// stores their number in `length` (if not NULL). The characters are not NUL terminated.
+JSTAR_API const char* jsrGetStringBytes(const JStarVM* vm, int slot, size_t* length);
 
 // -----------------------------------------------------------------------------
 // OPERATOR API
@@ -296,6 +383,14 @@ JSTAR_API void jsrListGet(JStarVM* vm, size_t i, int slot);
 // Returns the length of the list at slot `slot`. Doesn't push length onto the J* stack.
 JSTAR_API size_t jsrListGetLength(const JStarVM* vm, int slot);
 
+// Appends all the `count` numbers of a C array to the list at `slot`, growing it only once.
+JSTAR_API void jsrListExtendNumbers(JStarVM* vm, int slot, const double* numbers, size_t count);
+
+// Copies `count` elements of the list at `slot`, starting at index `start`, into the `out` array.
+// Returns false if any of the elements is not a Number, leaving an exception on top of the stack.
+// The elements preceding the offending one are copied nonetheless.
+JSTAR_API bool jsrListGetNumbers(JStarVM* vm, int slot, size_t start, size_t count, double* out);
+
 // -----------------------------------------------------------------------------
 // TUPLE API
 // -----------------------------------------------------------------------------
@@ -306,6 +401,45 @@ JSTAR_API void jsrTupleGet(JStarVM* vm, size_t i, int slot);
 // Returns the length of the tuple at slot `slot`. Doesn't push length onto the J* stack.
 JSTAR_API size_t jsrTupleGetLength(const JStarVM* vm, int slot);
 
+// Same as `jsrListGetNumbers`, but for tuples.
+JSTAR_API bool jsrTupleGetNumbers(JStarVM* vm, int slot, size_t start, size_t count, double* out);
+
+// -----------------------------------------------------------------------------
+// TYPED ARRAY API
+// -----------------------------------------------------------------------------
+
+// Element types of typed arrays
+typedef enum JStarArrayType {
+    JSR_ARRAY_FLOAT64,  // `double` elements (Float64Array)
+    JSR_ARRAY_INT32,    // `int32_t` elements (Int32Array)
+    JSR_ARRAY_UINT8,    // `uint8_t` elements (Uint8Array)
+} JStarArrayType;
+
+// Push a new typed array of `count` elements initialized to zero.
+// Returns a pointer to its elements, so that they can be filled in directly. If the size of the
+// array in bytes doesn't fit in a `size_t`, raises an InvalidArgException and returns NULL.
+JSTAR_API void* jsrPushTypedArray(JStarVM* vm, JStarArrayType type, size_t count);
+
+// Get the elements of the typed array at `slot` without copying them, storing its type and length
+// in `type` and `count` (both can be NULL). The elements never move, so the pointer stays valid as
+// long as the array is reachable. Writes through it are visible to J* code.
+// Does not perform type checking, the user must ensure `slot` is a typed array.
+JSTAR_API void* jsrGetTypedArray(JStarVM* vm, int slot, JStarArrayType* type, size_t* count);
+
+// -----------------------------------------------------------------------------
+// BYTE ARRAY API
+// -----------------------------------------------------------------------------
+
+// Push a new ByteArray of `size` bytes initialized to zero.
+// Returns a pointer to its bytes, so that they can be filled in directly.
+JSTAR_API void* jsrPushByteArray(JStarVM* vm, size_t size);
+
+// Get the bytes of the ByteArray at `slot` without copying them, storing their number in `size`.
+// Unlike the elements of typed arrays, the bytes move when the array grows, so the pointer must
+// not be retained across calls that may modify the array.
+// Does not perform type checking, the user must ensure `slot` is a ByteArray.
+JSTAR_API void* jsrGetByteArray(JStarVM* vm, int slot, size_t* size);
+
 // -----------------------------------------------------------------------------
 // ITERATOR API
 // -----------------------------------------------------------------------------
@@ -496,6 +630,8 @@ JSTAR_API bool jsrIsInstance(const JStarVM* vm, int slot);
 JSTAR_API bool jsrIsTable(const JStarVM* vm, int slot);
 JSTAR_API bool jsrIsFunction(const JStarVM* vm, int slot);
 JSTAR_API bool jsrIsUserdata(const JStarVM* vm, int slot);
+JSTAR_API bool jsrIsTypedArray(const JStarVM* vm, int slot);
+JSTAR_API bool jsrIsByteArray(const JStarVM* vm, int slot);
 
 // These functions return true if the slot is of the given type, false otherwise
 // leaving a TypeException on top of the stack with a message customized with `name`
@@ -511,6 +647,8 @@ JSTAR_API bool jsrCheckHandle(JStarVM* vm, int slot, const char* name);
 JSTAR_API bool jsrCheckTable(JStarVM* vm, int slot, const char* name);
 JSTAR_API bool jsrCheckFunction(JStarVM* vm, int slot, const char* name);
 JSTAR_API bool jsrCheckUserdata(JStarVM* vm, int slot, const char* name);
+JSTAR_API bool jsrCheckTypedArray(JStarVM* vm, int slot, const char* name);
+JSTAR_API bool jsrCheckByteArray(JStarVM* vm, int slot, const char* name);
 
 // Utility macro for checking a value type in the stack.
 // In case of error it exits signaling the error.
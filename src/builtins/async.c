@@ -0,0 +1,587 @@
+#include "async.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "jstar.h"
+
+#if defined(JSTAR_POSIX)
+    #define USE_POSIX_IO
+    #include <fcntl.h>
+    #include <spawn.h>
+    #include <sys/socket.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <time.h>
+    #include <unistd.h>
+
+    #if defined(JSTAR_LINUX)
+        #define USE_EPOLL
+        #include <sys/epoll.h>
+    #else
+        #include <poll.h>
+    #endif
+
+    // Not available on all systems, where writing to a closed socket raises SIGPIPE
+    #ifndef MSG_NOSIGNAL
+        #define MSG_NOSIGNAL 0
+    #endif
+
+extern char** environ;
+#endif
+
+// Synchronized to the event constants in async.jsr
+#define EVENT_READ  1
+#define EVENT_WRITE 2
+
+#define MAX_EVENTS 256
+
+#define M_POLLER_STATE "_state"
+
+#ifdef USE_POSIX_IO
+
+static bool isWouldBlock(int err) {
+    return err == EAGAIN || err == EWOULDBLOCK;
+}
+
+// Makes `fd` non-blocking and closed on exec, as all the fds created by the module are
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return false;
+    int fdFlags = fcntl(fd, F_GETFD);
+    return fdFlags >= 0 && fcntl(fd, F_SETFD, fdFlags | FD_CLOEXEC) >= 0;
+}
+
+static bool setCloseOnExec(int fd) {
+    int fdFlags = fcntl(fd, F_GETFD);
+    return fdFlags >= 0 && fcntl(fd, F_SETFD, fdFlags | FD_CLOEXEC) >= 0;
+}
+
+static bool getFd(JStarVM* vm, int slot, int* fd) {
+    JSR_CHECK(Int, slot, "fd");
+    double num = jsrGetNumber(vm, slot);
+    if(num < 0 || num > INT_MAX) JSR_RAISE(vm, "InvalidArgException", "Invalid fd %g", num);
+    *fd = (int)num;
+    return true;
+}
+
+static bool getEvents(JStarVM* vm, int slot, int* events) {
+    JSR_CHECK(Int, slot, "events");
+    double num = jsrGetNumber(vm, slot);
+    if(num < 1 || num > (EVENT_READ | EVENT_WRITE)) {
+        JSR_RAISE(vm, "InvalidArgException", "events must be READ, WRITE or READ | WRITE");
+    }
+    *events = (int)num;
+    return true;
+}
+
+// Pushes a Tuple with the two fds of a pipe or a socket pair
+static void pushFdPair(JStarVM* vm, const int fds[2]) {
+    jsrPushNumber(vm, fds[0]);
+    jsrPushNumber(vm, fds[1]);
+    jsrPushTuple(vm, 2);
+}
+
+// -----------------------------------------------------------------------------
+// POLLER
+// -----------------------------------------------------------------------------
+
+// Readiness notification for a set of fds, using epoll where available and poll otherwise
+typedef struct Poller {
+    bool closed;
+    #ifdef USE_EPOLL
+    int epfd;
+    #else
+    struct pollfd* fds;
+    size_t count, capacity;
+    #endif
+} Poller;
+
+static void closePoller(Poller* p) {
+    if(p->closed) return;
+    p->closed = true;
+    #ifdef USE_EPOLL
+    close(p->epfd);
+    #else
+    free(p->fds);
+    #endif
+}
+
+static void freePoller(void* udata) {
+    closePoller(udata);
+}
+
+static Poller* getPoller(JStarVM* vm) {
+    if(!jsrGetField(vm, 0, M_POLLER_STATE)) return NULL;
+    if(!jsrCheckUserdata(vm, -1, M_POLLER_STATE)) return NULL;
+    Poller* p = jsrGetUserdata(vm, -1);
+    jsrPop(vm);
+
+    if(p->closed) {
+        jsrRaise(vm, "AsyncException", "Poller is closed");
+        return NULL;
+    }
+    return p;
+}
+
+    #ifdef USE_EPOLL
+static uint32_t toEpoll(int events) {
+    return (events & EVENT_READ ? EPOLLIN : 0) | (events & EVENT_WRITE ? EPOLLOUT : 0);
+}
+
+// Errors and hang ups are reported as both readable and writable, so that the next read or
+// write on the fd reports them
+static int fromEpoll(uint32_t events) {
+    int res = 0;
+    if(events & (EPOLLIN | EPOLLERR | EPOLLHUP)) res |= EVENT_READ;
+    if(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) res |= EVENT_WRITE;
+    return res;
+}
+
+static bool pollerControl(JStarVM* vm, Poller* p, int op, int fd, int events) {
+    struct epoll_event ev = {.events = toEpoll(events), .data.fd = fd};
+    if(epoll_ctl(p->epfd, op, fd, &ev) < 0) JSR_RAISE(vm, "AsyncException", strerror(errno));
+    return true;
+}
+    #else
+static short toPoll(int events) {
+    return (events & EVENT_READ ? POLLIN : 0) | (events & EVENT_WRITE ? POLLOUT : 0);
+}
+
+static int fromPoll(short events) {
+    int res = 0;
+    if(events & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) res |= EVENT_READ;
+    if(events & (POLLOUT | POLLERR | POLLHUP | POLLNVAL)) res |= EVENT_WRITE;
+    return res;
+}
+
+static struct pollfd* findFd(Poller* p, int fd) {
+    for(size_t i = 0; i < p->count; i++) {
+        if(p->fds[i].fd == fd) return &p->fds[i];
+    }
+    return NULL;
+}
+    #endif
+
+// class Poller
+JSR_NATIVE(jsr_Poller_construct) {
+    Poller* p = jsrPushUserdata(vm, sizeof(*p), &freePoller);
+    *p = (Poller){0};
+
+    #ifdef USE_EPOLL
+    p->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(p->epfd < 0) {
+        p->closed = true;
+        JSR_RAISE(vm, "AsyncException", strerror(errno));
+    }
+    #endif
+
+    jsrSetField(vm, 0, M_POLLER_STATE);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 0);
+    return true;
+}
+
+JSR_NATIVE(jsr_Poller_register) {
+    Poller* p = getPoller(vm);
+    if(!p) return false;
+
+    int fd, events;
+    if(!getFd(vm, 1, &fd) || !getEvents(vm, 2, &events)) return false;
+
+    #ifdef USE_EPOLL
+    if(!pollerControl(vm, p, EPOLL_CTL_ADD, fd, events)) return false;
+    #else
+    if(findFd(p, fd)) JSR_RAISE(vm, "AsyncException", strerror(EEXIST));
+
+    if(p->count == p->capacity) {
+        size_t newCap = p->capacity ? p->capacity * 2 : 16;
+        struct pollfd* newFds = realloc(p->fds, newCap * sizeof(*newFds));
+        if(!newFds) JSR_RAISE(vm, "AsyncException", "Out of memory");
+        p->fds = newFds;
+        p->capacity = newCap;
+    }
+
+    p->fds[p->count++] = (struct pollfd){.fd = fd, .events = toPoll(events)};
+    #endif
+
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_Poller_modify) {
+    Poller* p = getPoller(vm);
+    if(!p) return false;
+
+    int fd, events;
+    if(!getFd(vm, 1, &fd) || !getEvents(vm, 2, &events)) return false;
+
+    #ifdef USE_EPOLL
+    if(!pollerControl(vm, p, EPOLL_CTL_MOD, fd, events)) return false;
+    #else
+    struct pollfd* pfd = findFd(p, fd);
+    if(!pfd) JSR_RAISE(vm, "AsyncException", strerror(ENOENT));
+    pfd->events = toPoll(events);
+    #endif
+
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_Poller_unregister) {
+    Poller* p = getPoller(vm);
+    if(!p) return false;
+
+    int fd;
+    if(!getFd(vm, 1, &fd)) return false;
+
+    #ifdef USE_EPOLL
+    if(!pollerControl(vm, p, EPOLL_CTL_DEL, fd, 0)) return false;
+    #else
+    struct pollfd* pfd = findFd(p, fd);
+    if(!pfd) JSR_RAISE(vm, "AsyncException", strerror(ENOENT));
+    *pfd = p->fds[--p->count];
+    #endif
+
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_Poller_wait) {
+    Poller* p = getPoller(vm);
+    if(!p) return false;
+
+    int timeout = -1;
+    if(!jsrIsNull(vm, 1)) {
+        JSR_CHECK(Number, 1, "timeout");
+        double seconds = jsrGetNumber(vm, 1);
+        if(seconds < 0) JSR_RAISE(vm, "InvalidArgException", "timeout must be >= 0");
+
+        // Round up, so that we never wake up before a timer expires
+        double ms = ceil(seconds * 1000);
+        timeout = ms < INT_MAX ? (int)ms : INT_MAX;
+    }
+
+    jsrPushList(vm);
+
+    #ifdef USE_EPOLL
+    struct epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(p->epfd, events, MAX_EVENTS, timeout);
+    if(count < 0) {
+        if(errno == EINTR) return true;
+        JSR_RAISE(vm, "AsyncException", strerror(errno));
+    }
+
+    for(int i = 0; i < count; i++) {
+        jsrPushNumber(vm, events[i].data.fd);
+        jsrPushNumber(vm, fromEpoll(events[i].events));
+        jsrPushTuple(vm, 2);
+        jsrListAppend(vm, -2);
+        jsrPop(vm);
+    }
+    #else
+    int count = poll(p->fds, p->count, timeout);
+    if(count < 0) {
+        if(errno == EINTR) return true;
+        JSR_RAISE(vm, "AsyncException", strerror(errno));
+    }
+
+    for(size_t i = 0; i < p->count && count > 0; i++) {
+        if(!p->fds[i].revents) continue;
+        jsrPushNumber(vm, p->fds[i].fd);
+        jsrPushNumber(vm, fromPoll(p->fds[i].revents));
+        jsrPushTuple(vm, 2);
+        jsrListAppend(vm, -2);
+        jsrPop(vm);
+        count--;
+    }
+    #endif
+
+    return true;
+}
+
+JSR_NATIVE(jsr_Poller_close) {
+    if(!jsrGetField(vm, 0, M_POLLER_STATE)) return false;
+    if(!jsrCheckUserdata(vm, -1, M_POLLER_STATE)) return false;
+    closePoller(jsrGetUserdata(vm, -1));
+    jsrPushNull(vm);
+    return true;
+}
+// end
+
+// -----------------------------------------------------------------------------
+// FUNCTIONS
+// -----------------------------------------------------------------------------
+
+JSR_NATIVE(jsr_async_read) {
+    int fd;
+    if(!getFd(vm, 1, &fd)) return false;
+    JSR_CHECK(Int, 2, "bytes");
+
+    double bytes = jsrGetNumber(vm, 2);
+    if(bytes < 0) JSR_RAISE(vm, "InvalidArgException", "bytes must be >= 0");
+
+    JStarBuffer data;
+    jsrBufferInitCapacity(vm, &data, bytes);
+
+    ssize_t count;
+    do {
+        count = read(fd, data.data, bytes);
+    } while(count < 0 && errno == EINTR);
+
+    if(count < 0) {
+        int err = errno;
+        jsrBufferFree(&data);
+        if(isWouldBlock(err)) {
+            jsrPushNull(vm);
+            return true;
+        }
+        JSR_RAISE(vm, "AsyncException", strerror(err));
+    }
+
+    data.size = count;
+    jsrBufferPush(&data);
+    return true;
+}
+
+JSR_NATIVE(jsr_async_write) {
+    int fd;
+    if(!getFd(vm, 1, &fd)) return false;
+
+    size_t length;
+    const char* data;
+    if(!getBytes(vm, 2, "data", &data, &length)) return false;
+
+    ssize_t count;
+    do {
+        // Try `send` first, so that writing to a closed socket raises an exception instead of
+        // SIGPIPE
+        count = send(fd, data, length, MSG_NOSIGNAL);
+        if(count < 0 && errno == ENOTSOCK) count = write(fd, data, length);
+    } while(count < 0 && errno == EINTR);
+
+    if(count < 0) {
+        if(isWouldBlock(errno)) {
+            jsrPushNull(vm);
+            return true;
+        }
+        JSR_RAISE(vm, "AsyncException", strerror(errno));
+    }
+
+    jsrPushNumber(vm, count);
+    return true;
+}
+
+JSR_NATIVE(jsr_async_close) {
+    int fd;
+    if(!getFd(vm, 1, &fd)) return false;
+    if(close(fd) < 0 && errno != EINTR) JSR_RAISE(vm, "AsyncException", strerror(errno));
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_async_pipe) {
+    int fds[2];
+    if(pipe(fds) < 0) JSR_RAISE(vm, "AsyncException", strerror(errno));
+
+    if(!setNonBlocking(fds[0]) || !setNonBlocking(fds[1])) {
+        int err = errno;
+        close(fds[0]);
+        close(fds[1]);
+        JSR_RAISE(vm, "AsyncException", strerror(err));
+    }
+
+    pushFdPair(vm, fds);
+    return true;
+}
+
+JSR_NATIVE(jsr_async_socketpair) {
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        JSR_RAISE(vm, "AsyncException", strerror(errno));
+    }
+
+    if(!setNonBlocking(fds[0]) || !setNonBlocking(fds[1])) {
+        int err = errno;
+        close(fds[0]);
+        close(fds[1]);
+        JSR_RAISE(vm, "AsyncException", strerror(err));
+    }
+
+    pushFdPair(vm, fds);
+    return true;
+}
+
+JSR_NATIVE(jsr_async_setBlocking) {
+    int fd;
+    if(!getFd(vm, 1, &fd)) return false;
+    JSR_CHECK(Boolean, 2, "blocking");
+
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0) JSR_RAISE(vm, "AsyncException", strerror(errno));
+
+    flags = jsrGetBoolean(vm, 2) ? flags & ~O_NONBLOCK : flags | O_NONBLOCK;
+    if(fcntl(fd, F_SETFL, flags) < 0) JSR_RAISE(vm, "AsyncException", strerror(errno));
+
+    jsrPushNull(vm);
+    return true;
+}
+
+static void freeArgv(char** argv) {
+    if(!argv) return;
+    for(char** arg = argv; *arg; arg++) {
+        free(*arg);
+    }
+    free(argv);
+}
+
+// Copies a List of Strings in a NULL terminated array of C strings
+static char** copyArgv(JStarVM* vm, int slot) {
+    size_t argc = jsrListGetLength(vm, slot);
+    if(argc == 0) {
+        jsrRaise(vm, "InvalidArgException", "args cannot be empty");
+        return NULL;
+    }
+
+    char** argv = calloc(argc + 1, sizeof(char*));
+    if(!argv) {
+        jsrRaise(vm, "AsyncException", "Out of memory");
+        return NULL;
+    }
+
+    for(size_t i = 0; i < argc; i++) {
+        jsrListGet(vm, i, slot);
+        if(!jsrIsString(vm, -1)) {
+            jsrRaise(vm, "TypeException", "args must be a List of Strings");
+            goto error;
+        }
+
+        size_t length = jsrGetStringSz(vm, -1);
+        argv[i] = malloc(length + 1);
+        if(!argv[i]) {
+            jsrRaise(vm, "AsyncException", "Out of memory");
+            goto error;
+        }
+        memcpy(argv[i], jsrGetString(vm, -1), length);
+        argv[i][length] = '\0';
+        jsrPop(vm);
+    }
+
+    return argv;
+
+error:
+    freeArgv(argv);
+    return NULL;
+}
+
+JSR_NATIVE(jsr_async_spawn) {
+    JSR_CHECK(List, 1, "args");
+
+    char** argv = copyArgv(vm, 1);
+    if(!argv) return false;
+
+    // All the fds are created closed on exec, the child gets its ends through `dup2`, that clears
+    // the flag on the copies
+    int in[2] = {-1, -1}, out[2] = {-1, -1};
+    if(pipe(in) < 0 || pipe(out) < 0 || !setCloseOnExec(in[0]) || !setCloseOnExec(in[1]) ||
+       !setCloseOnExec(out[0]) || !setCloseOnExec(out[1])) {
+        int err = errno;
+        freeArgv(argv);
+        for(int i = 0; i < 2; i++) {
+            if(in[i] >= 0) close(in[i]);
+            if(out[i] >= 0) close(out[i]);
+        }
+        JSR_RAISE(vm, "AsyncException", strerror(err));
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    close(in[0]);
+    close(out[1]);
+
+    if(err || !setNonBlocking(in[1]) || !setNonBlocking(out[0])) {
+        if(!err) err = errno;
+        close(in[1]);
+        close(out[0]);
+        jsrRaise(vm, "AsyncException", "Cannot spawn `%s`: %s", argv[0], strerror(err));
+        freeArgv(argv);
+        return false;
+    }
+
+    freeArgv(argv);
+
+    jsrPushNumber(vm, pid);
+    jsrPushNumber(vm, in[1]);
+    jsrPushNumber(vm, out[0]);
+    jsrPushTuple(vm, 3);
+    return true;
+}
+
+JSR_NATIVE(jsr_async_waitpid) {
+    JSR_CHECK(Int, 1, "pid");
+    pid_t pid = jsrGetNumber(vm, 1);
+
+    int status;
+    pid_t res;
+    do {
+        res = waitpid(pid, &status, WNOHANG);
+    } while(res < 0 && errno == EINTR);
+
+    if(res < 0) JSR_RAISE(vm, "AsyncException", strerror(errno));
+
+    if(res == 0) {
+        jsrPushNull(vm);
+    } else if(WIFSIGNALED(status)) {
+        jsrPushNumber(vm, -WTERMSIG(status));
+    } else {
+        jsrPushNumber(vm, WEXITSTATUS(status));
+    }
+
+    return true;
+}
+
+JSR_NATIVE(jsr_async_monotonic) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    jsrPushNumber(vm, ts.tv_sec + ts.tv_nsec / 1e9);
+    return true;
+}
+
+#else
+
+    #define UNSUPPORTED(name)                                                                 \
+        JSR_NATIVE(name) {                                                                    \
+            JSR_RAISE(vm, "NotImplementedException", "async not supported on current system."); \
+        }
+
+UNSUPPORTED(jsr_Poller_construct)
+UNSUPPORTED(jsr_Poller_register)
+UNSUPPORTED(jsr_Poller_modify)
+UNSUPPORTED(jsr_Poller_unregister)
+UNSUPPORTED(jsr_Poller_wait)
+UNSUPPORTED(jsr_Poller_close)
+UNSUPPORTED(jsr_async_read)
+UNSUPPORTED(jsr_async_write)
+UNSUPPORTED(jsr_async_close)
+UNSUPPORTED(jsr_async_pipe)
+UNSUPPORTED(jsr_async_socketpair)
+UNSUPPORTED(jsr_async_setBlocking)
+UNSUPPORTED(jsr_async_spawn)
+UNSUPPORTED(jsr_async_waitpid)
+UNSUPPORTED(jsr_async_monotonic)
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include "jstar.h"
+
+// class Poller
+JSR_NATIVE(jsr_Poller_construct);
+JSR_NATIVE(jsr_Poller_register);
+JSR_NATIVE(jsr_Poller_modify);
+JSR_NATIVE(jsr_Poller_unregister);
+JSR_NATIVE(jsr_Poller_wait);
+JSR_NATIVE(jsr_Poller_close);
+// end
+
+// Functions
+JSR_NATIVE(jsr_async_read);
+JSR_NATIVE(jsr_async_write);
+JSR_NATIVE(jsr_async_close);
+JSR_NATIVE(jsr_async_pipe);
+JSR_NATIVE(jsr_async_socketpair);
+JSR_NATIVE(jsr_async_setBlocking);
+JSR_NATIVE(jsr_async_spawn);
+JSR_NATIVE(jsr_async_waitpid);
+JSR_NATIVE(jsr_async_monotonic);
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <string.h>
 
+#include "util.h"
+
 #include "core/core.h"
 #include "core/core.jsc.inc"
 
@@ -39,6 +41,26 @@
     #include "re.jsc.inc"
 #endif
 
+#ifdef JSTAR_STRUCT
+    #include "struct.h"
+    #include "struct.jsc.inc"
+#endif
+
+#ifdef JSTAR_JSON
+    #include "json.h"
+    #include "json.jsc.inc"
+#endif
+
+#ifdef JSTAR_CSV
+    #include "csv.h"
+    #include "csv.jsc.inc"
+#endif
+
+#ifdef JSTAR_ASYNC
+    #include "async.h"
+    #include "async.jsc.inc"
+#endif
+
 typedef enum { TYPE_FUNC, TYPE_CLASS } Type;
 
 typedef struct {
@@ -88,6 +110,18 @@ typedef struct {
 
 static Module builtInModules[] = {
     CORE
+        // Object and Class are bootstrapped in C by `initCoreModule`. They are listed here so that
+        // their natives can be referenced by runtime snapshots
+        CLASS(Object)
+            METHOD(__string__, jsr_Object_string)
+            METHOD(__hash__,   jsr_Object_hash)
+            METHOD(__eq__,     jsr_Object_eq)
+        ENDCLASS
+        CLASS(Class)
+            METHOD(getName,    jsr_Class_getName)
+            METHOD(implements, jsr_Class_implements)
+            METHOD(__string__, jsr_Class_string)
+        ENDCLASS
         CLASS(Number)
             METHOD(@construct, jsr_Number_construct)
             METHOD(isInt,      jsr_Number_isInt)
@@ -162,6 +196,10 @@ static Module builtInModules[] = {
             METHOD(__next__,    jsr_String_next)
             METHOD(__string__,  jsr_String_string)
         ENDCLASS
+        CLASS(StringLines)
+            METHOD(__iter__, jsr_StringLines_iter)
+            METHOD(__next__, jsr_StringLines_next)
+        ENDCLASS
         CLASS(Table)
             METHOD(@construct, jsr_Table_construct)
             METHOD(__get__,    jsr_Table_get)
@@ -176,6 +214,49 @@ static Module builtInModules[] = {
             METHOD(__next__,   jsr_Table_next)
             METHOD(__string__, jsr_Table_string)
         ENDCLASS
+        CLASS(StringBuilder)
+            METHOD(@construct, jsr_StringBuilder_construct)
+            METHOD(append,     jsr_StringBuilder_append)
+            METHOD(clear,      jsr_StringBuilder_clear)
+            METHOD(__len__,    jsr_StringBuilder_len)
+            METHOD(__string__, jsr_StringBuilder_string)
+        ENDCLASS
+        CLASS(TypedArray)
+            METHOD(__len__,  jsr_TypedArray_len)
+            METHOD(__get__,  jsr_TypedArray_get)
+            METHOD(__set__,  jsr_TypedArray_set)
+            METHOD(__iter__, jsr_TypedArray_iter)
+            METHOD(__next__, jsr_TypedArray_next)
+            METHOD(fill,     jsr_TypedArray_fill)
+            METHOD(sum,      jsr_TypedArray_sum)
+            METHOD(dot,      jsr_TypedArray_dot)
+            METHOD(map,      jsr_TypedArray_map)
+            METHOD(slice,    jsr_TypedArray_slice)
+        ENDCLASS
+        CLASS(Float64Array)
+            METHOD(@construct, jsr_Float64Array_construct)
+        ENDCLASS
+        CLASS(Int32Array)
+            METHOD(@construct, jsr_Int32Array_construct)
+        ENDCLASS
+        CLASS(Uint8Array)
+            METHOD(@construct, jsr_Uint8Array_construct)
+        ENDCLASS
+        CLASS(ByteArray)
+            METHOD(@construct, jsr_ByteArray_construct)
+            METHOD(__len__,    jsr_ByteArray_len)
+            METHOD(__get__,    jsr_ByteArray_get)
+            METHOD(__set__,    jsr_ByteArray_set)
+            METHOD(__iter__,   jsr_ByteArray_iter)
+            METHOD(__next__,   jsr_ByteArray_next)
+            METHOD(__eq__,     jsr_ByteArray_eq)
+            METHOD(__string__, jsr_ByteArray_string)
+            METHOD(add,        jsr_ByteArray_add)
+            METHOD(addAll,     jsr_ByteArray_addAll)
+            METHOD(resize,     jsr_ByteArray_resize)
+            METHOD(clear,      jsr_ByteArray_clear)
+            METHOD(slice,      jsr_ByteArray_slice)
+        ENDCLASS
         CLASS(Enum)
             METHOD(@construct, jsr_Enum_construct)
             METHOD(value,      jsr_Enum_value)
@@ -217,8 +298,11 @@ static Module builtInModules[] = {
         CLASS(File)
             METHOD(@construct,      jsr_File_construct)
             METHOD(read,     jsr_File_read)
+            METHOD(readInto, jsr_File_readInto)
             METHOD(readAll,  jsr_File_readAll)
             METHOD(readLine, jsr_File_readLine)
+            METHOD(readLines, jsr_File_readLines)
+            METHOD(__iter__, jsr_File_readLine)
             METHOD(write,    jsr_File_write)
             METHOD(close,    jsr_File_close)
             METHOD(seek,     jsr_File_seek)
@@ -227,6 +311,7 @@ static Module builtInModules[] = {
             METHOD(flush,    jsr_File_flush)
             METHOD(reopen,   jsr_File_reopen)
             METHOD(fileno,   jsr_File_fileno)
+            METHOD(mmap,     jsr_File_mmap)
         ENDCLASS
         CLASS(Popen)
             METHOD(@construct,   jsr_Popen_construct)
@@ -234,6 +319,7 @@ static Module builtInModules[] = {
         ENDCLASS
         FUNCTION(remove, jsr_remove)
         FUNCTION(rename, jsr_rename)
+        FUNCTION(mmap,   jsr_mmap)
         FUNCTION(init,   jsr_io_init)
     ENDMODULE
 #endif
@@ -275,6 +361,72 @@ static Module builtInModules[] = {
         FUNCTION(find,          jsr_re_find)
         FUNCTION(matchAll,      jsr_re_matchAll)
         FUNCTION(substituteAll, jsr_re_substituteAll)
+        CLASS(Regex)
+            METHOD(@construct,    jsr_Regex_construct)
+            METHOD(match,         jsr_Regex_match)
+            METHOD(find,          jsr_Regex_find)
+            METHOD(matchAll,      jsr_Regex_matchAll)
+            METHOD(substituteAll, jsr_Regex_substituteAll)
+        ENDCLASS
+    ENDMODULE
+#endif
+#ifdef JSTAR_STRUCT
+    MODULE(struct)
+        FUNCTION(size,       jsr_struct_size)
+        FUNCTION(pack,       jsr_struct_pack)
+        FUNCTION(unpack,     jsr_struct_unpack)
+        FUNCTION(unpackFrom, jsr_struct_unpackFrom)
+        CLASS(UnpackIter)
+            METHOD(__iter__, jsr_UnpackIter_iter)
+            METHOD(__next__, jsr_UnpackIter_next)
+        ENDCLASS
+    ENDMODULE
+#endif
+#ifdef JSTAR_JSON
+    MODULE(json)
+        FUNCTION(parse, jsr_json_parse)
+        FUNCTION(dump,  jsr_json_dump)
+        CLASS(Decoder)
+            METHOD(@construct, jsr_Decoder_construct)
+            METHOD(feed,       jsr_Decoder_feed)
+            METHOD(close,      jsr_Decoder_close)
+        ENDCLASS
+    ENDMODULE
+#endif
+#ifdef JSTAR_CSV
+    MODULE(csv)
+        CLASS(Reader)
+            METHOD(@construct,  jsr_Reader_construct)
+            METHOD(readRow,     jsr_Reader_readRow)
+            METHOD(readColumns, jsr_Reader_readColumns)
+            METHOD(__iter__,    jsr_Reader_iter)
+        ENDCLASS
+        CLASS(Writer)
+            METHOD(@construct, jsr_Writer_construct)
+            METHOD(writeRow,   jsr_Writer_writeRow)
+            METHOD(writeRows,  jsr_Writer_writeRows)
+        ENDCLASS
+    ENDMODULE
+#endif
+#ifdef JSTAR_ASYNC
+    MODULE(async)
+        CLASS(Poller)
+            METHOD(@construct, jsr_Poller_construct)
+            METHOD(register,   jsr_Poller_register)
+            METHOD(modify,     jsr_Poller_modify)
+            METHOD(unregister, jsr_Poller_unregister)
+            METHOD(wait,       jsr_Poller_wait)
+            METHOD(close,      jsr_Poller_close)
+        ENDCLASS
+        FUNCTION(read,        jsr_async_read)
+        FUNCTION(write,       jsr_async_write)
+        FUNCTION(close,       jsr_async_close)
+        FUNCTION(pipe,        jsr_async_pipe)
+        FUNCTION(socketpair,  jsr_async_socketpair)
+        FUNCTION(setBlocking, jsr_async_setBlocking)
+        FUNCTION(spawn,       jsr_async_spawn)
+        FUNCTION(waitpid,     jsr_async_waitpid)
+        FUNCTION(monotonic,   jsr_async_monotonic)
     ENDMODULE
 #endif
 #ifdef JSTAR_DEBUG
@@ -331,6 +483,17 @@ static JStarNative getNativeFunc(Module* module, const char* name) {
     }
 }
 
+bool getBytes(JStarVM* vm, int slot, const char* name, const char** data, size_t* length) {
+    if(jsrIsByteArray(vm, slot)) {
+        *data = jsrGetByteArray(vm, slot, length);
+    } else if(jsrIsString(vm, slot)) {
+        *data = jsrGetStringBytes(vm, slot, length);
+    } else {
+        JSR_RAISE(vm, "TypeException", "%s must be a String or a ByteArray.", name);
+    }
+    return true;
+}
+
 JStarNative resolveBuiltIn(const char* module, const char* cls, const char* name) {
     Module* m = getModule(module);
     if(m == NULL) return NULL;
@@ -354,3 +517,76 @@ const void* readBuiltInModule(const char* name, size_t* len) {
     *len = 0;
     return NULL;
 }
+
+// Native identifiers are composed of the module index, the element index and the method index
+// (plus one, 0 identifies a module function)
+#define NATIVE_ID(module, elem, method) ((uint32_t)(module) << 16 | (elem) << 8 | (method))
+
+bool getBuiltInNativeId(JStarNative fn, uint32_t* id) {
+    for(int m = 0; builtInModules[m].name != NULL; m++) {
+        ModuleElem* elems = builtInModules[m].elems;
+        for(int e = 0; !(elems[e].type == TYPE_FUNC && elems[e].as.function.name == NULL); e++) {
+            if(elems[e].type == TYPE_FUNC) {
+                if(elems[e].as.function.func == fn) {
+                    *id = NATIVE_ID(m, e, 0);
+                    return true;
+                }
+                continue;
+            }
+
+            Func* methods = elems[e].as.class.methods;
+            for(int i = 0; methods[i].name != NULL; i++) {
+                if(methods[i].func == fn) {
+                    *id = NATIVE_ID(m, e, i + 1);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+JStarNative getBuiltInNative(uint32_t id) {
+    int m = id >> 16, e = (id >> 8) & 0xff, i = id & 0xff;
+
+    for(int j = 0; j <= m; j++) {
+        if(builtInModules[j].name == NULL) return NULL;
+    }
+
+    ModuleElem* elems = builtInModules[m].elems;
+    for(int j = 0; j <= e; j++) {
+        if(j == (int)ARRAY_COUNT(builtInModules[m].elems)) return NULL;
+        if(elems[j].type == TYPE_FUNC && elems[j].as.function.name == NULL) return NULL;
+    }
+
+    if(elems[e].type == TYPE_FUNC) {
+        return i == 0 ? elems[e].as.function.func : NULL;
+    }
+
+    Func* methods = elems[e].as.class.methods;
+    for(int j = 0; j < i; j++) {
+        if(j == (int)ARRAY_COUNT(elems[e].as.class.methods)) return NULL;
+        if(methods[j].name == NULL) return NULL;
+    }
+    return i == 0 ? NULL : methods[i - 1].func;
+}
+
+int getBuiltInChunkId(const void* ptr) {
+    const unsigned char* p = ptr;
+    for(int m = 0; builtInModules[m].name != NULL; m++) {
+        const unsigned char* bytecode = builtInModules[m].bytecode;
+        if(p >= bytecode && p < bytecode + builtInModules[m].len) {
+            return m;
+        }
+    }
+    return -1;
+}
+
+const void* getBuiltInChunk(int id, size_t* len) {
+    if(id < 0) return NULL;
+    for(int m = 0; m <= id; m++) {
+        if(builtInModules[m].name == NULL) return NULL;
+    }
+    *len = builtInModules[id].len;
+    return builtInModules[id].bytecode;
+}
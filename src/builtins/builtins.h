@@ -1,11 +1,36 @@
 #ifndef BUILTINS_H
 #define BUILTINS_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "jstar.h"
 
+// Fields read by built-in natives on every call, looked up through cached symbols
+typedef enum BuiltInSymbol {
+    SYM_LINES_STRING,
+    SYM_LINES_START,
+    SYM_LINES_END,
+    SYM_BUILDER_BUF,
+    SYM_FILE_HANDLE,
+    SYM_FILE_CLOSED,
+    SYM_FILE_LINES,
+    BUILTIN_SYMBOL_COUNT,
+} BuiltInSymbol;
+
 JStarNative resolveBuiltIn(const char* module, const char* cls, const char* name);
 const void* readBuiltInModule(const char* name, size_t* len);
 
+// Gets the bytes of the String or ByteArray at `slot` in place, without copying them, so they are
+// not NUL terminated. Raises a TypeException naming the argument `name` if the value is neither
+bool getBytes(JStarVM* vm, int slot, const char* name, const char** data, size_t* length);
+
+// Stable identifiers of built-in natives and compiled modules, used to reference them in runtime
+// snapshots (see snapshot.h)
+bool getBuiltInNativeId(JStarNative fn, uint32_t* id);
+JStarNative getBuiltInNative(uint32_t id);
+int getBuiltInChunkId(const void* ptr);
+const void* getBuiltInChunk(int id, size_t* len);
+
 #endif
@@ -22,6 +22,7 @@
 #include "jstar.h"
 #include "object.h"
 #include "profile.h"
+#include "string_util.h"
 #include "util.h"
 #include "value.h"
 #include "value_hashtable.h"
@@ -77,6 +78,12 @@ static const char* coreSymbols[] = {
     "List",
     "Tuple",
     "Table",
+    "TypedArray",
+    "Float64Array",
+    "Int32Array",
+    "Uint8Array",
+    "ByteArray",
+    "StringBuilder",
     "Enum",
     "StackTrace",
     "Userdata",
@@ -140,14 +147,7 @@ static bool compareValues(JStarVM* vm, const Value* v1, const Value* v2, size_t
 // API
 // -----------------------------------------------------------------------------
 
-static JSR_NATIVE(jsr_Object_string);
-static JSR_NATIVE(jsr_Object_hash);
-static JSR_NATIVE(jsr_Object_eq);
-static JSR_NATIVE(jsr_Class_getName);
-static JSR_NATIVE(jsr_Class_implements);
-static JSR_NATIVE(jsr_Class_string);
-
-JSR_STATIC_ASSERT(CORE_CLASS_COUNT == 14, "Core classes changed; review initCoreModule bootstrap");
+JSR_STATIC_ASSERT(CORE_CLASS_COUNT == 19, "Core classes changed; review initCoreModule bootstrap");
 
 void initCoreModule(JStarVM* vm) {
     PROFILE_FUNC();
@@ -189,8 +189,17 @@ void initCoreModule(JStarVM* vm) {
         size_t len;
         const char* code = readBuiltInModule(JSR_CORE_MODULE, &len);
 
-        JStarResult res = jsrEvalModule(vm, "core", JSR_CORE_MODULE, code, len);
+        // The core bytecode lives in static memory, so it can be borrowed and loaded lazily
+        ObjFunction* fn;
+        JStarResult res = deserializeModule(vm, "core", core->name, code, len, true, NULL, &fn);
         JSR_ASSERT(res == JSR_SUCCESS, "Core module bootsrap failed");
+
+        push(vm, OBJ_VAL(fn));
+        vm->sp[-1] = OBJ_VAL(newClosure(vm, fn));
+        moduleSetPath(vm, core, "core");
+        bool ok = jsrCall(vm, 0);
+        JSR_ASSERT(ok, "Core module bootsrap failed");
+        pop(vm);
     }
 
     {
@@ -209,6 +218,12 @@ void initCoreModule(JStarVM* vm) {
         vm->coreClasses[CORE_CLASS_TUPLE] = AS_CLASS(getDefinedName(vm, core, "Tuple"));
         vm->coreClasses[CORE_CLASS_TABLE] = AS_CLASS(getDefinedName(vm, core, "Table"));
         vm->coreClasses[CORE_CLASS_USERDATA] = AS_CLASS(getDefinedName(vm, core, "Userdata"));
+        vm->coreClasses[CORE_CLASS_TYPED_ARRAY] = AS_CLASS(getDefinedName(vm, core, "TypedArray"));
+        vm->coreClasses[CORE_CLASS_FLOAT64_ARRAY] =
+            AS_CLASS(getDefinedName(vm, core, "Float64Array"));
+        vm->coreClasses[CORE_CLASS_INT32_ARRAY] = AS_CLASS(getDefinedName(vm, core, "Int32Array"));
+        vm->coreClasses[CORE_CLASS_UINT8_ARRAY] = AS_CLASS(getDefinedName(vm, core, "Uint8Array"));
+        vm->coreClasses[CORE_CLASS_BYTE_ARRAY] = AS_CLASS(getDefinedName(vm, core, "ByteArray"));
         core->base.cls = vm->coreClasses[CORE_CLASS_MODULE];
 
         // Exception is not a core class, but the VM keeps a direct reference to it
@@ -258,7 +273,7 @@ bool resolveCoreSymbol(JStarIdentifier id) {
 // -----------------------------------------------------------------------------
 
 // class Object
-static JSR_NATIVE(jsr_Object_string) {
+JSR_NATIVE(jsr_Object_string) {
     Obj* o = AS_OBJ(vm->apiStack[0]);
     JStarBuffer str;
     jsrBufferInit(vm, &str);
@@ -267,25 +282,25 @@ static JSR_NATIVE(jsr_Object_string) {
     return true;
 }
 
-static JSR_NATIVE(jsr_Object_hash) {
+JSR_NATIVE(jsr_Object_hash) {
     uint64_t x = hash64((uint64_t)AS_OBJ(vm->apiStack[0]));
     jsrPushNumber(vm, (uint32_t)x);
     return true;
 }
 
-static JSR_NATIVE(jsr_Object_eq) {
+JSR_NATIVE(jsr_Object_eq) {
     jsrPushBoolean(vm, valueEquals(vm->apiStack[0], vm->apiStack[1]));
     return true;
 }
 // end
 
 // class Class
-static JSR_NATIVE(jsr_Class_getName) {
+JSR_NATIVE(jsr_Class_getName) {
     push(vm, OBJ_VAL(AS_CLASS(vm->apiStack[0])->name));
     return true;
 }
 
-static JSR_NATIVE(jsr_Class_implements) {
+JSR_NATIVE(jsr_Class_implements) {
     JSR_CHECK(String, 1, "method");
     ObjClass* cls = AS_CLASS(vm->apiStack[0]);
     ObjString* method = AS_STRING(vm->apiStack[1]);
@@ -293,7 +308,7 @@ static JSR_NATIVE(jsr_Class_implements) {
     return true;
 }
 
-static JSR_NATIVE(jsr_Class_string) {
+JSR_NATIVE(jsr_Class_string) {
     Obj* o = AS_OBJ(vm->apiStack[0]);
     JStarBuffer str;
     jsrBufferInit(vm, &str);
@@ -933,7 +948,7 @@ JSR_NATIVE(jsr_String_construct) {
             jsrRaise(vm, "TypeException", "__string__() didn't return a String");
             goto error;
         }
-        jsrBufferAppendStr(&stringBuf, jsrGetString(vm, -1));
+        jsrBufferAppend(&stringBuf, AS_STRING(peek(vm))->data, AS_STRING(peek(vm))->length);
         jsrPop(vm);
     }
 
@@ -954,9 +969,9 @@ JSR_NATIVE(jsr_String_findSubstr) {
         JSR_CHECK(Int, 3, "stop");
     }
 
-    const char* thisStr = jsrGetString(vm, 0);
+    const char* thisStr = AS_STRING(vm->apiStack[0])->data;
     size_t thisLen = jsrGetStringSz(vm, 0);
-    const char* substring = jsrGetString(vm, 1);
+    const char* substring = AS_STRING(vm->apiStack[1])->data;
     size_t substringLen = jsrGetStringSz(vm, 1);
     double start = jsrIsNull(vm, 2) ? 0 : jsrGetNumber(vm, 2);
     double stop = jsrIsNull(vm, 3) ? thisLen : jsrGetNumber(vm, 3);
@@ -971,14 +986,8 @@ JSR_NATIVE(jsr_String_findSubstr) {
         JSR_RAISE(vm, "InvalidArgException", "start must be <= stop");
     }
 
-    for(size_t i = start; i <= stop - substringLen; i++) {
-        if(memcmp(thisStr + i, substring, substringLen) == 0) {
-            jsrPushNumber(vm, i);
-            return true;
-        }
-    }
-
-    jsrPushNumber(vm, -1);
+    const char* found = strFind(thisStr + (size_t)start, stop - start, substring, substringLen);
+    jsrPushNumber(vm, found ? found - thisStr : -1);
     return true;
 }
 
@@ -991,9 +1000,9 @@ JSR_NATIVE(jsr_String_rfindSubstr) {
         JSR_CHECK(Int, 3, "stop");
     }
 
-    const char* thisStr = jsrGetString(vm, 0);
+    const char* thisStr = AS_STRING(vm->apiStack[0])->data;
     size_t thisLen = jsrGetStringSz(vm, 0);
-    const char* substring = jsrGetString(vm, 1);
+    const char* substring = AS_STRING(vm->apiStack[1])->data;
     size_t substringLen = jsrGetStringSz(vm, 1);
     double start = jsrIsNull(vm, 2) ? 0 : jsrGetNumber(vm, 2);
     double stop = jsrIsNull(vm, 3) ? thisLen : jsrGetNumber(vm, 3);
@@ -1008,14 +1017,9 @@ JSR_NATIVE(jsr_String_rfindSubstr) {
         JSR_RAISE(vm, "InvalidArgException", "start must be <= stop");
     }
 
-    for(size_t i = stop - substringLen; i != (size_t)(start - 1); i--) {
-        if(memcmp(thisStr + i, substring, substringLen) == 0) {
-            jsrPushNumber(vm, i);
-            return true;
-        }
-    }
-
-    jsrPushNumber(vm, -1);
+    const char* found = strFindLast(thisStr + (size_t)start, stop - start, substring,
+                                    substringLen);
+    jsrPushNumber(vm, found ? found - thisStr : -1);
     return true;
 }
 
@@ -1035,7 +1039,7 @@ JSR_NATIVE(jsr_String_startsWith) {
     JSR_CHECK(String, 1, "prefix");
     JSR_CHECK(Int, 2, "offset");
 
-    const char* prefix = jsrGetString(vm, 1);
+    const char* prefix = AS_STRING(vm->apiStack[1])->data;
     size_t prefixLen = jsrGetStringSz(vm, 1);
     int offset = jsrGetNumber(vm, 2);
     size_t thisLen = jsrGetStringSz(vm, 0);
@@ -1045,7 +1049,7 @@ JSR_NATIVE(jsr_String_startsWith) {
         return true;
     }
 
-    const char* thisStr = jsrGetString(vm, 0) + offset;
+    const char* thisStr = AS_STRING(vm->apiStack[0])->data + offset;
     if(memcmp(thisStr, prefix, prefixLen) == 0) {
         jsrPushBoolean(vm, true);
         return true;
@@ -1058,7 +1062,7 @@ JSR_NATIVE(jsr_String_startsWith) {
 JSR_NATIVE(jsr_String_endsWith) {
     JSR_CHECK(String, 1, "suffix");
 
-    const char* suffix = jsrGetString(vm, 1);
+    const char* suffix = AS_STRING(vm->apiStack[1])->data;
     size_t suffixLen = jsrGetStringSz(vm, 1);
     size_t thisLen = jsrGetStringSz(vm, 0);
 
@@ -1067,7 +1071,7 @@ JSR_NATIVE(jsr_String_endsWith) {
         return true;
     }
 
-    const char* thisStr = jsrGetString(vm, 0) + (thisLen - suffixLen);
+    const char* thisStr = AS_STRING(vm->apiStack[0])->data + (thisLen - suffixLen);
 
     if(memcmp(thisStr, suffix, suffixLen) == 0) {
         jsrPushBoolean(vm, true);
@@ -1081,35 +1085,29 @@ JSR_NATIVE(jsr_String_endsWith) {
 JSR_NATIVE(jsr_String_split) {
     JSR_CHECK(String, 1, "delimiter");
 
-    const char* str = jsrGetString(vm, 0);
-    size_t size = jsrGetStringSz(vm, 0);
+    ObjString* thisStr = AS_STRING(vm->apiStack[0]);
+    const char* str = thisStr->data;
+    size_t size = thisStr->length;
 
-    const char* delimiter = jsrGetString(vm, 1);
+    const char* delimiter = AS_STRING(vm->apiStack[1])->data;
     size_t delimSize = jsrGetStringSz(vm, 1);
     if(delimSize == 0) JSR_RAISE(vm, "InvalidArgException", "Empty delimiter");
 
     ObjList* tokens = newList(vm, 0);
     push(vm, OBJ_VAL(tokens));
 
-    const char* last = str;
+    size_t last = 0;
 
-    if(delimSize < size) {
-        size_t i = 0;
-        while(i <= size - delimSize) {
-            if(memcmp(str + i, delimiter, delimSize) == 0) {
-                jsrPushStringSz(vm, last, str + i - last);
-                jsrListAppend(vm, -2);
-                jsrPop(vm);
-
-                last = str + i + delimSize;
-                i += delimSize;
-            } else {
-                i++;
-            }
-        }
+    const char* ptr;
+    while((ptr = strFind(str + last, size - last, delimiter, delimSize))) {
+        size_t i = ptr - str;
+        push(vm, OBJ_VAL(newStringSlice(vm, thisStr, last, i - last)));
+        jsrListAppend(vm, -2);
+        jsrPop(vm);
+        last = i + delimSize;
     }
 
-    jsrPushStringSz(vm, last, str + size - last);
+    push(vm, OBJ_VAL(newStringSlice(vm, thisStr, last, size - last)));
     jsrListAppend(vm, -2);
     jsrPop(vm);
 
@@ -1117,21 +1115,15 @@ JSR_NATIVE(jsr_String_split) {
 }
 
 JSR_NATIVE(jsr_String_strip) {
-    const char* str = jsrGetString(vm, 0);
-    size_t start = 0, end = jsrGetStringSz(vm, 0);
-
-    while(start < end && isspace(str[start])) {
-        start++;
-    }
-
-    while(start < end && isspace(str[end - 1])) {
-        end--;
-    }
+    ObjString* thisStr = AS_STRING(vm->apiStack[0]);
+    const char* str = thisStr->data;
+    size_t start = strSkipSpace(str, thisStr->length);
+    size_t end = start + strSkipSpaceBack(str + start, thisStr->length - start);
 
     if(start == end) {
         jsrPushString(vm, "");
-    } else if(start != 0 || end != jsrGetStringSz(vm, 0)) {
-        jsrPushStringSz(vm, &str[start], (size_t)(end - start));
+    } else if(start != 0 || end != thisStr->length) {
+        push(vm, OBJ_VAL(newStringSlice(vm, thisStr, start, end - start)));
     } else {
         jsrPushValue(vm, 0);
     }
@@ -1140,15 +1132,12 @@ JSR_NATIVE(jsr_String_strip) {
 }
 
 JSR_NATIVE(jsr_String_chomp) {
-    const char* str = jsrGetString(vm, 0);
-    size_t end = jsrGetStringSz(vm, 0);
-
-    while(end > 0 && isspace(str[end - 1])) {
-        end--;
-    }
+    ObjString* thisStr = AS_STRING(vm->apiStack[0]);
+    const char* str = thisStr->data;
+    size_t end = strSkipSpaceBack(str, thisStr->length);
 
-    if(end != jsrGetStringSz(vm, 0)) {
-        jsrPushStringSz(vm, str, end);
+    if(end != thisStr->length) {
+        push(vm, OBJ_VAL(newStringSlice(vm, thisStr, 0, end)));
     } else {
         jsrPushValue(vm, 0);
     }
@@ -1157,7 +1146,7 @@ JSR_NATIVE(jsr_String_chomp) {
 }
 
 JSR_NATIVE(jsr_String_escaped) {
-    const char* str = jsrGetString(vm, 0);
+    const char* str = AS_STRING(vm->apiStack[0])->data;
     size_t size = jsrGetStringSz(vm, 0);
 
     const int numEscapes = 10;
@@ -1166,19 +1155,16 @@ JSR_NATIVE(jsr_String_escaped) {
 
     JStarBuffer buf;
     jsrBufferInitCapacity(vm, &buf, size * 1.5);
-    for(size_t i = 0; i < size; i++) {
-        int j;
-        for(j = 0; j < numEscapes; j++) {
-            if(str[i] == escaped[j]) {
-                jsrBufferAppendChar(&buf, '\\');
-                jsrBufferAppendChar(&buf, unescaped[j]);
-                break;
-            }
-        }
+    for(size_t i = 0;;) {
+        // Copy the characters that do not need escaping in bulk
+        size_t run = strSpanNotIn(str + i, size - i, escaped, numEscapes);
+        jsrBufferAppend(&buf, str + i, run);
+        i += run;
+        if(i == size) break;
 
-        if(j == numEscapes) {
-            jsrBufferAppendChar(&buf, str[i]);
-        }
+        const char* esc = memchr(escaped, str[i++], numEscapes);
+        jsrBufferAppendChar(&buf, '\\');
+        jsrBufferAppendChar(&buf, unescaped[esc - escaped]);
     }
 
     jsrBufferPush(&buf);
@@ -1201,7 +1187,7 @@ JSR_NATIVE(jsr_String_mul) {
     JStarBuffer repeated;
     jsrBufferInitCapacity(vm, &repeated, reps * size);
     for(size_t i = 0; i < (size_t)reps; i++) {
-        jsrBufferAppend(&repeated, jsrGetString(vm, 0), jsrGetStringSz(vm, 0));
+        jsrBufferAppend(&repeated, AS_STRING(vm->apiStack[0])->data, jsrGetStringSz(vm, 0));
     }
     jsrBufferPush(&repeated);
     return true;
@@ -1253,7 +1239,7 @@ JSR_NATIVE(jsr_String_mod) {
                               getClass(vm, fmtArg)->name->data);
                 }
 
-                jsrBufferAppendStr(&buf, jsrGetString(vm, -1));
+                jsrBufferAppend(&buf, AS_STRING(peek(vm))->data, AS_STRING(peek(vm))->length);
                 jsrPop(vm);
 
                 ptr = end;  // skip the format specifier
@@ -1278,7 +1264,7 @@ JSR_NATIVE(jsr_String_string) {
 }
 
 JSR_NATIVE(jsr_String_hash) {
-    jsrPushNumber(vm, stringGetHash(AS_STRING(vm->apiStack[0])));
+    jsrPushNumber(vm, stringGetHash(vm, AS_STRING(vm->apiStack[0])));
     return true;
 }
 
@@ -1331,6 +1317,74 @@ JSR_NATIVE(jsr_String_next) {
 }
 // end
 
+// class StringLines
+#define M_LINES_STRING "_string"
+#define M_LINES_START  "_start"
+#define M_LINES_END    "_end"
+
+// The iteration state is the offset of the end of the current line (its '\n', or the length of
+// the String). `__iter__` also stores the bounds of the line it has found, so that `__next__`
+// doesn't have to scan it again
+
+static ObjString* getLinesString(JStarVM* vm) {
+    if(!jsrGetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, SYM_LINES_STRING, M_LINES_STRING))) {
+        return NULL;
+    }
+    if(!jsrCheckString(vm, -1, M_LINES_STRING)) return NULL;
+    return AS_STRING(peek(vm));
+}
+
+JSR_NATIVE(jsr_StringLines_iter) {
+    ObjString* str = getLinesString(vm);
+    if(!str) return false;
+
+    size_t start = 0;
+    if(IS_NUM(vm->apiStack[1])) {
+        start = (size_t)AS_NUM(vm->apiStack[1]) + 1;
+    }
+
+    if(start >= str->length) {
+        push(vm, BOOL_VAL(false));
+        return true;
+    }
+
+    const char* newline = memchr(str->data + start, '\n', str->length - start);
+    size_t end = newline ? (size_t)(newline - str->data) : str->length;
+
+    push(vm, NUM_VAL(start));
+    if(!jsrSetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, SYM_LINES_START, M_LINES_START))) {
+        return false;
+    }
+    push(vm, NUM_VAL(end));
+    return jsrSetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, SYM_LINES_END, M_LINES_END));
+}
+
+JSR_NATIVE(jsr_StringLines_next) {
+    ObjString* str = getLinesString(vm);
+    if(!str) return false;
+
+    size_t end = (size_t)AS_NUM(vm->apiStack[1]);
+    if(!jsrGetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, SYM_LINES_END, M_LINES_END))) {
+        return false;
+    }
+
+    size_t start;
+    if(valueEquals(peek(vm), vm->apiStack[1])) {
+        if(!jsrGetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, SYM_LINES_START, M_LINES_START))) {
+            return false;
+        }
+        start = (size_t)AS_NUM(peek(vm));
+    } else {
+        // The stored line belongs to another iteration over this object, search the line start
+        start = end;
+        while(start > 0 && str->data[start - 1] != '\n') start--;
+    }
+
+    push(vm, OBJ_VAL(newStringSlice(vm, str, start, end - start)));
+    return true;
+}
+// end
+
 // class Table
 #define TOMB_MARKER      TRUE_VAL
 #define INITIAL_CAPACITY 8
@@ -1338,7 +1392,7 @@ JSR_NATIVE(jsr_String_next) {
 
 static bool tableKeyHash(JStarVM* vm, Value key, uint32_t* hash) {
     if(IS_STRING(key)) {
-        *hash = stringGetHash(AS_STRING(key));
+        *hash = stringGetHash(vm, AS_STRING(key));
         return true;
     }
     if(IS_NUM(key)) {
@@ -1510,30 +1564,45 @@ static size_t tableMaxEntryLoad(size_t capacity) {
     return (capacity >> 1) + (capacity >> 2);  // Read as: 3/4 * capacity i.e. a load factor of 75%
 }
 
-JSR_NATIVE(jsr_Table_set) {
-    if(jsrIsNull(vm, 1)) JSR_RAISE(vm, "TypeException", "Key of Table cannot be null.");
-
-    ObjTable* t = AS_TABLE(vm->apiStack[0]);
+bool tableSet(JStarVM* vm, ObjTable* t, Value key, Value val, bool* newEntry) {
     if(t->count + t->tombstones + 1 > tableMaxEntryLoad(t->sizeMask + 1)) {
         resizeEntries(vm, t);
     }
 
     TableEntry* e;
-    if(!findEntry(vm, t->entries, t->sizeMask, vm->apiStack[1], &e)) {
+    if(!findEntry(vm, t->entries, t->sizeMask, key, &e)) {
         return false;
     }
 
-    bool newEntry = IS_NULL(e->key);
-    if(newEntry) {
+    *newEntry = IS_NULL(e->key);
+    if(*newEntry) {
         t->count++;
         if(!IS_NULL(e->val)) t->tombstones--;
+
+        // Intern String keys lazily, on their first use as a key. This also ensures the table
+        // doesn't end up retaining the embedder's memory or the parent of a slice
+        if(IS_STRING(key)) {
+            key = OBJ_VAL(stringIntern(vm, AS_STRING(key)));
+        }
     }
-    *e = (TableEntry){vm->apiStack[1], vm->apiStack[2]};
-    push(vm, BOOL_VAL(newEntry));
+    *e = (TableEntry){key, val};
 
     return true;
 }
 
+JSR_NATIVE(jsr_Table_set) {
+    if(jsrIsNull(vm, 1)) JSR_RAISE(vm, "TypeException", "Key of Table cannot be null.");
+
+    bool newEntry;
+    ObjTable* t = AS_TABLE(vm->apiStack[0]);
+    if(!tableSet(vm, t, vm->apiStack[1], vm->apiStack[2], &newEntry)) {
+        return false;
+    }
+
+    push(vm, BOOL_VAL(newEntry));
+    return true;
+}
+
 JSR_NATIVE(jsr_Table_delete) {
     if(jsrIsNull(vm, 1)) JSR_RAISE(vm, "TypeException", "Key of Table cannot be null.");
     ObjTable* t = AS_TABLE(vm->apiStack[0]);
@@ -1716,6 +1785,575 @@ JSR_NATIVE(jsr_Table_string) {
 }
 // end
 
+// class StringBuilder
+#define M_BUILDER_BUF "_buf"
+
+static void finalizeBuilderBuf(void* data) {
+    jsrBufferFree((JStarBuffer*)data);
+}
+
+static JStarBuffer* getBuilderBuf(JStarVM* vm) {
+    if(!jsrGetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, SYM_BUILDER_BUF, M_BUILDER_BUF))) {
+        return NULL;
+    }
+    if(!jsrCheckUserdata(vm, -1, M_BUILDER_BUF)) return NULL;
+    JStarBuffer* buf = jsrGetUserdata(vm, -1);
+    jsrPop(vm);
+    return buf;
+}
+
+JSR_NATIVE(jsr_StringBuilder_construct) {
+    JStarBuffer* buf = jsrPushUserdata(vm, sizeof(JStarBuffer), &finalizeBuilderBuf);
+    jsrBufferInit(vm, buf);
+    jsrSetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, SYM_BUILDER_BUF, M_BUILDER_BUF));
+    jsrPop(vm);
+
+    // return `this`. required in native constructors
+    jsrPushValue(vm, 0);
+    return true;
+}
+
+JSR_NATIVE(jsr_StringBuilder_append) {
+    JStarBuffer* buf = getBuilderBuf(vm);
+    if(!buf) return false;
+
+    if(!jsrIsString(vm, 1)) {
+        jsrPushValue(vm, 1);
+        if(!jsrCallMethod(vm, "__string__", 0)) return false;
+        if(!jsrIsString(vm, -1)) {
+            JSR_RAISE(vm, "TypeException", "%s.__string__() didn't return a String.",
+                      getClass(vm, vm->apiStack[1])->name->data);
+        }
+    } else {
+        jsrPushValue(vm, 1);
+    }
+
+    ObjString* str = AS_STRING(peek(vm));
+    jsrBufferAppend(buf, str->data, str->length);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 0);
+    return true;
+}
+
+JSR_NATIVE(jsr_StringBuilder_clear) {
+    JStarBuffer* buf = getBuilderBuf(vm);
+    if(!buf) return false;
+    jsrBufferClear(buf);
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_StringBuilder_len) {
+    JStarBuffer* buf = getBuilderBuf(vm);
+    if(!buf) return false;
+    jsrPushNumber(vm, buf->size);
+    return true;
+}
+
+JSR_NATIVE(jsr_StringBuilder_string) {
+    JStarBuffer* buf = getBuilderBuf(vm);
+    if(!buf) return false;
+    jsrPushStringSz(vm, buf->data, buf->size);
+    return true;
+}
+// end
+
+// class TypedArray
+static ObjTypedArray* copyTypedArray(JStarVM* vm, JStarArrayType type, ObjTypedArray* src) {
+    ObjTypedArray* arr = newTypedArray(vm, type, src->count);
+    if(src->type == type) {
+        memcpy(arr->data, src->data, typedArrayElemSize(type) * src->count);
+    } else {
+        for(size_t i = 0; i < src->count; i++) {
+            typedArraySet(arr, i, typedArrayGet(src, i));
+        }
+    }
+    return arr;
+}
+
+// Converts the Number at `slot` to a count of elements, checking that it's a non-negative integer
+// less than `max`
+static bool checkArrayCount(JStarVM* vm, int slot, size_t max, size_t* count) {
+    JSR_CHECK(Int, slot, "size");
+    double num = jsrGetNumber(vm, slot);
+    if(num < 0) JSR_RAISE(vm, "InvalidArgException", "size must be >= 0");
+    // `max` may not be representable as a double, but the doubles below its rounded value are all
+    // less than it
+    if(num >= (double)max) JSR_RAISE(vm, "InvalidArgException", "size too large: %g", num);
+    *count = (size_t)num;
+    return true;
+}
+
+static bool constructTypedArray(JStarVM* vm, JStarArrayType type) {
+    if(jsrIsNumber(vm, 1)) {
+        size_t count;
+        if(!checkArrayCount(vm, 1, typedArrayMaxCount(type), &count)) return false;
+        push(vm, OBJ_VAL(newTypedArray(vm, type, count)));
+        return true;
+    }
+
+    if(IS_TYPED_ARRAY(vm->apiStack[1])) {
+        push(vm, OBJ_VAL(copyTypedArray(vm, type, AS_TYPED_ARRAY(vm->apiStack[1]))));
+        return true;
+    }
+
+    // The length of a generic Iterable is unknown, so collect its elements in a List first
+    if(!IS_LIST(vm->apiStack[1]) && !IS_TUPLE(vm->apiStack[1])) {
+        jsrPushList(vm);
+        JSR_FOREACH(1) {
+            if(err) return false;
+            jsrListAppend(vm, 2);
+            jsrPop(vm);
+        }
+    }
+
+    Obj* src = AS_OBJ(peek(vm));
+    size_t count;
+    getValues(src, &count);
+
+    ObjTypedArray* arr = newTypedArray(vm, type, count);
+    push(vm, OBJ_VAL(arr));
+
+    Value* items = getValues(src, &count);
+    for(size_t i = 0; i < count; i++) {
+        if(!IS_NUM(items[i])) {
+            JSR_RAISE(vm, "TypeException", "Element %zu of %s init is not a Number, got %s.", i,
+                      arr->base.cls->name->data, getClass(vm, items[i])->name->data);
+        }
+        typedArraySet(arr, i, AS_NUM(items[i]));
+    }
+
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_len) {
+    push(vm, NUM_VAL(AS_TYPED_ARRAY(vm->apiStack[0])->count));
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_get) {
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+    size_t i = jsrCheckIndex(vm, 1, arr->count, "idx");
+    if(i == SIZE_MAX) return false;
+
+    push(vm, NUM_VAL(typedArrayGet(arr, i)));
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_set) {
+    JSR_CHECK(Number, 2, "val");
+
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+    size_t i = jsrCheckIndex(vm, 1, arr->count, "idx");
+    if(i == SIZE_MAX) return false;
+
+    typedArraySet(arr, i, AS_NUM(vm->apiStack[2]));
+    jsrPushValue(vm, 2);
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_iter) {
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+
+    if(IS_NULL(vm->apiStack[1]) && arr->count != 0) {
+        push(vm, NUM_VAL(0));
+        return true;
+    }
+
+    if(IS_NUM(vm->apiStack[1])) {
+        size_t idx = (size_t)AS_NUM(vm->apiStack[1]);
+        if(idx < arr->count - 1) {
+            push(vm, NUM_VAL(idx + 1));
+            return true;
+        }
+    }
+
+    push(vm, BOOL_VAL(false));
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_next) {
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+
+    if(IS_NUM(vm->apiStack[1])) {
+        size_t idx = (size_t)AS_NUM(vm->apiStack[1]);
+        if(idx < arr->count) {
+            push(vm, NUM_VAL(typedArrayGet(arr, idx)));
+            return true;
+        }
+    }
+
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_fill) {
+    JSR_CHECK(Number, 1, "value");
+
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+    double value = jsrGetNumber(vm, 1);
+
+    switch((JStarArrayType)arr->type) {
+    case JSR_ARRAY_FLOAT64: {
+        double* data = arr->data;
+        for(size_t i = 0; i < arr->count; i++) {
+            data[i] = value;
+        }
+        break;
+    }
+    case JSR_ARRAY_INT32: {
+        int32_t* data = arr->data;
+        int32_t elem = (int32_t)typedArrayToInt(value);
+        for(size_t i = 0; i < arr->count; i++) {
+            data[i] = elem;
+        }
+        break;
+    }
+    case JSR_ARRAY_UINT8:
+        if(arr->count) memset(arr->data, (uint8_t)typedArrayToInt(value), arr->count);
+        break;
+    }
+
+    jsrPushValue(vm, 0);
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_sum) {
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+
+    double sum = 0;
+    switch((JStarArrayType)arr->type) {
+    case JSR_ARRAY_FLOAT64: {
+        const double* data = arr->data;
+        for(size_t i = 0; i < arr->count; i++) {
+            sum += data[i];
+        }
+        break;
+    }
+    case JSR_ARRAY_INT32: {
+        const int32_t* data = arr->data;
+        int64_t isum = 0;
+        for(size_t i = 0; i < arr->count; i++) {
+            isum += data[i];
+        }
+        sum = isum;
+        break;
+    }
+    case JSR_ARRAY_UINT8: {
+        const uint8_t* data = arr->data;
+        uint64_t usum = 0;
+        for(size_t i = 0; i < arr->count; i++) {
+            usum += data[i];
+        }
+        sum = usum;
+        break;
+    }
+    }
+
+    jsrPushNumber(vm, sum);
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_dot) {
+    JSR_CHECK(TypedArray, 1, "other");
+
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+    ObjTypedArray* other = AS_TYPED_ARRAY(vm->apiStack[1]);
+    if(arr->count != other->count) {
+        JSR_RAISE(vm, "InvalidArgException", "Arrays have different lengths: %zu and %zu",
+                  arr->count, other->count);
+    }
+
+    double dot = 0;
+    if(arr->type == JSR_ARRAY_FLOAT64 && other->type == JSR_ARRAY_FLOAT64) {
+        const double *a = arr->data, *b = other->data;
+        for(size_t i = 0; i < arr->count; i++) {
+            dot += a[i] * b[i];
+        }
+    } else {
+        for(size_t i = 0; i < arr->count; i++) {
+            dot += typedArrayGet(arr, i) * typedArrayGet(other, i);
+        }
+    }
+
+    jsrPushNumber(vm, dot);
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_map) {
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+    ObjTypedArray* mapped = newTypedArray(vm, arr->type, arr->count);
+    push(vm, OBJ_VAL(mapped));
+
+    for(size_t i = 0; i < arr->count; i++) {
+        jsrPushValue(vm, 1);
+        jsrPushNumber(vm, typedArrayGet(arr, i));
+        if(!jsrCall(vm, 1)) return false;
+
+        if(!IS_NUM(peek(vm))) {
+            JSR_RAISE(vm, "TypeException", "`fn` must return a Number, got %s.",
+                      getClass(vm, peek(vm))->name->data);
+        }
+        typedArraySet(mapped, i, AS_NUM(pop(vm)));
+    }
+
+    return true;
+}
+
+JSR_NATIVE(jsr_TypedArray_slice) {
+    ObjTypedArray* arr = AS_TYPED_ARRAY(vm->apiStack[0]);
+
+    size_t start = jsrCheckIndex(vm, 1, arr->count + 1, "start");
+    if(start == SIZE_MAX) return false;
+
+    size_t stop = arr->count;
+    if(!jsrIsNull(vm, 2)) {
+        stop = jsrCheckIndex(vm, 2, arr->count + 1, "stop");
+        if(stop == SIZE_MAX) return false;
+    }
+
+    if(start > stop) JSR_RAISE(vm, "InvalidArgException", "start must be <= stop");
+
+    push(vm, OBJ_VAL(newTypedArrayView(vm, arr, start, stop - start)));
+    return true;
+}
+
+JSR_NATIVE(jsr_Float64Array_construct) {
+    return constructTypedArray(vm, JSR_ARRAY_FLOAT64);
+}
+
+JSR_NATIVE(jsr_Int32Array_construct) {
+    return constructTypedArray(vm, JSR_ARRAY_INT32);
+}
+
+JSR_NATIVE(jsr_Uint8Array_construct) {
+    return constructTypedArray(vm, JSR_ARRAY_UINT8);
+}
+// end
+
+// class ByteArray
+static bool checkNotView(JStarVM* vm, ObjByteArray* arr) {
+    if(arr->parent) JSR_RAISE(vm, "TypeException", "Cannot resize a ByteArray view");
+    return true;
+}
+
+// Appends the bytes of the String or ByteArray `data` to `arr`. Returns false if `data` is neither
+static bool appendBytes(JStarVM* vm, ObjByteArray* arr, Value data) {
+    if(IS_STRING(data)) {
+        ObjString* str = AS_STRING(data);
+        byteArrayAppend(vm, arr, str->data, str->length);
+        return true;
+    }
+
+    if(IS_BYTE_ARRAY(data)) {
+        ObjByteArray* src = AS_BYTE_ARRAY(data);
+        size_t length;
+        byteArrayBytes(src, &length);
+
+        // Reserve first, as `src` may share the bytes of `arr`, that can move when growing
+        byteArrayReserve(vm, arr, arr->size + length);
+        const uint8_t* bytes = byteArrayBytes(src, &length);
+        if(length) memcpy(arr->data + arr->size, bytes, length);
+        arr->size += length;
+        return true;
+    }
+
+    return false;
+}
+
+JSR_NATIVE(jsr_ByteArray_construct) {
+    if(jsrIsNumber(vm, 1)) {
+        size_t size;
+        if(!checkArrayCount(vm, 1, SIZE_MAX, &size)) return false;
+        push(vm, OBJ_VAL(newByteArray(vm, size)));
+        return true;
+    }
+
+    ObjByteArray* arr = newByteArray(vm, 0);
+    push(vm, OBJ_VAL(arr));
+
+    if(appendBytes(vm, arr, vm->apiStack[1])) {
+        return true;
+    }
+
+    JSR_FOREACH(1) {
+        if(err) return false;
+        if(!IS_NUM(peek(vm))) {
+            JSR_RAISE(vm, "TypeException", "Elements of ByteArray init must be Numbers, got %s.",
+                      getClass(vm, peek(vm))->name->data);
+        }
+        uint8_t byte = typedArrayToInt(AS_NUM(pop(vm)));
+        byteArrayAppend(vm, arr, &byte, 1);
+    }
+
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_len) {
+    size_t size;
+    byteArrayBytes(AS_BYTE_ARRAY(vm->apiStack[0]), &size);
+    push(vm, NUM_VAL(size));
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_get) {
+    size_t size;
+    const uint8_t* bytes = byteArrayBytes(AS_BYTE_ARRAY(vm->apiStack[0]), &size);
+
+    size_t i = jsrCheckIndex(vm, 1, size, "idx");
+    if(i == SIZE_MAX) return false;
+
+    push(vm, NUM_VAL(bytes[i]));
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_set) {
+    JSR_CHECK(Number, 2, "val");
+
+    size_t size;
+    uint8_t* bytes = byteArrayBytes(AS_BYTE_ARRAY(vm->apiStack[0]), &size);
+
+    size_t i = jsrCheckIndex(vm, 1, size, "idx");
+    if(i == SIZE_MAX) return false;
+
+    bytes[i] = typedArrayToInt(AS_NUM(vm->apiStack[2]));
+    jsrPushValue(vm, 2);
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_iter) {
+    size_t size;
+    byteArrayBytes(AS_BYTE_ARRAY(vm->apiStack[0]), &size);
+
+    if(IS_NULL(vm->apiStack[1]) && size != 0) {
+        push(vm, NUM_VAL(0));
+        return true;
+    }
+
+    if(IS_NUM(vm->apiStack[1])) {
+        size_t idx = (size_t)AS_NUM(vm->apiStack[1]);
+        if(idx + 1 < size) {
+            push(vm, NUM_VAL(idx + 1));
+            return true;
+        }
+    }
+
+    push(vm, BOOL_VAL(false));
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_next) {
+    size_t size;
+    const uint8_t* bytes = byteArrayBytes(AS_BYTE_ARRAY(vm->apiStack[0]), &size);
+
+    if(IS_NUM(vm->apiStack[1])) {
+        size_t idx = (size_t)AS_NUM(vm->apiStack[1]);
+        if(idx < size) {
+            push(vm, NUM_VAL(bytes[idx]));
+            return true;
+        }
+    }
+
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_add) {
+    JSR_CHECK(Number, 1, "byte");
+    ObjByteArray* arr = AS_BYTE_ARRAY(vm->apiStack[0]);
+    if(!checkNotView(vm, arr)) return false;
+
+    uint8_t byte = typedArrayToInt(AS_NUM(vm->apiStack[1]));
+    byteArrayAppend(vm, arr, &byte, 1);
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_addAll) {
+    ObjByteArray* arr = AS_BYTE_ARRAY(vm->apiStack[0]);
+    if(!checkNotView(vm, arr)) return false;
+
+    if(!appendBytes(vm, arr, vm->apiStack[1])) {
+        JSR_FOREACH(1) {
+            if(err) return false;
+            if(!IS_NUM(peek(vm))) {
+                JSR_RAISE(vm, "TypeException", "Elements of ByteArray must be Numbers, got %s.",
+                          getClass(vm, peek(vm))->name->data);
+            }
+            uint8_t byte = typedArrayToInt(AS_NUM(pop(vm)));
+            byteArrayAppend(vm, arr, &byte, 1);
+        }
+    }
+
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_resize) {
+    ObjByteArray* arr = AS_BYTE_ARRAY(vm->apiStack[0]);
+    if(!checkNotView(vm, arr)) return false;
+
+    size_t size;
+    if(!checkArrayCount(vm, 1, SIZE_MAX, &size)) return false;
+
+    byteArrayResize(vm, arr, size);
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_clear) {
+    ObjByteArray* arr = AS_BYTE_ARRAY(vm->apiStack[0]);
+    if(!checkNotView(vm, arr)) return false;
+
+    arr->size = 0;
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_slice) {
+    ObjByteArray* arr = AS_BYTE_ARRAY(vm->apiStack[0]);
+    size_t size;
+    byteArrayBytes(arr, &size);
+
+    size_t start = jsrCheckIndex(vm, 1, size + 1, "start");
+    if(start == SIZE_MAX) return false;
+
+    size_t stop = size;
+    if(!jsrIsNull(vm, 2)) {
+        stop = jsrCheckIndex(vm, 2, size + 1, "stop");
+        if(stop == SIZE_MAX) return false;
+    }
+
+    if(start > stop) JSR_RAISE(vm, "InvalidArgException", "start must be <= stop");
+
+    push(vm, OBJ_VAL(newByteArrayView(vm, arr, start, stop - start)));
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_eq) {
+    if(!IS_BYTE_ARRAY(vm->apiStack[1])) {
+        jsrPushBoolean(vm, false);
+        return true;
+    }
+
+    size_t size, otherSize;
+    const uint8_t* bytes = byteArrayBytes(AS_BYTE_ARRAY(vm->apiStack[0]), &size);
+    const uint8_t* other = byteArrayBytes(AS_BYTE_ARRAY(vm->apiStack[1]), &otherSize);
+    jsrPushBoolean(vm, size == otherSize && (size == 0 || memcmp(bytes, other, size) == 0));
+    return true;
+}
+
+JSR_NATIVE(jsr_ByteArray_string) {
+    size_t size;
+    const uint8_t* bytes = byteArrayBytes(AS_BYTE_ARRAY(vm->apiStack[0]), &size);
+    ObjString* str = newString(vm, size);
+    if(size) memcpy(str->data, bytes, size);
+    push(vm, OBJ_VAL(str));
+    return true;
+}
+// end
+
 // class Enum
 #define M_VALUE_NAME "_valueName"
 
@@ -1726,25 +2364,29 @@ static bool checkEnumElem(JStarVM* vm, ObjClass* cls, ObjInstance* inst) {
     }
 
     ObjString* enumElem = AS_STRING(peek(vm));
-    if(isalpha(enumElem->data[0])) {
+    stringFlatten(vm, enumElem);
+
+    if(enumElem->length > 0 && isalpha(enumElem->data[0])) {
         for(size_t i = 1; i < enumElem->length; i++) {
             char c = enumElem->data[i];
             if(!isalpha(c) && !isdigit(c) && c != '_') {
-                JSR_RAISE(vm, "InvalidArgException", "Enum element `%s` is not a valid identifier",
+                JSR_RAISE(vm, "InvalidArgException",
+                          "Enum element `%.*s` is not a valid identifier", (int)enumElem->length,
                           enumElem->data);
             }
         }
 
         Value val;
         if(instanceGetField(cls, inst, enumElem, &val)) {
-            JSR_RAISE(vm, "InvalidArgException", "Duplicate Enum element `%s`", enumElem->data);
+            JSR_RAISE(vm, "InvalidArgException", "Duplicate Enum element `%.*s`",
+                      (int)enumElem->length, enumElem->data);
         }
 
         return true;
     }
 
-    JSR_RAISE(vm, "InvalidArgException", "Enum element `%s` is not a valid identifier",
-              enumElem->data);
+    JSR_RAISE(vm, "InvalidArgException", "Enum element `%.*s` is not a valid identifier",
+              (int)enumElem->length, enumElem->data);
 }
 
 JSR_NATIVE(jsr_Enum_construct) {
@@ -4,7 +4,9 @@
 #include <stdbool.h>
 
 #include "jstar.h"
+#include "object.h"
 #include "parse/ast.h"
+#include "value.h"
 
 // J* core module bootstrap
 void initCoreModule(JStarVM* vm);
@@ -12,8 +14,25 @@ void initCoreModule(JStarVM* vm);
 // Resolve a core module name
 bool resolveCoreSymbol(JStarIdentifier id);
 
+// Maps `key` to `val` in `t`, storing in `newEntry` whether the key wasn't already present.
+// Returns false, leaving an exception on top of the stack, if hashing or comparing `key` fails.
+// `key` must not be null, and both `key` and `val` must be reachable
+bool tableSet(JStarVM* vm, ObjTable* t, Value key, Value val, bool* newEntry);
+
 // J* core module native functions and methods
 
+// class Object
+JSR_NATIVE(jsr_Object_string);
+JSR_NATIVE(jsr_Object_hash);
+JSR_NATIVE(jsr_Object_eq);
+// end
+
+// class Class
+JSR_NATIVE(jsr_Class_getName);
+JSR_NATIVE(jsr_Class_implements);
+JSR_NATIVE(jsr_Class_string);
+// end
+
 // class Number
 JSR_NATIVE(jsr_Number_construct);
 JSR_NATIVE(jsr_Number_isInt);
@@ -97,6 +116,11 @@ JSR_NATIVE(jsr_String_iter);
 JSR_NATIVE(jsr_String_next);
 // end
 
+// class StringLines
+JSR_NATIVE(jsr_StringLines_iter);
+JSR_NATIVE(jsr_StringLines_next);
+// end
+
 // class Table
 JSR_NATIVE(jsr_Table_construct);
 JSR_NATIVE(jsr_Table_get);
@@ -112,6 +136,46 @@ JSR_NATIVE(jsr_Table_next);
 JSR_NATIVE(jsr_Table_string);
 // end
 
+// class StringBuilder
+JSR_NATIVE(jsr_StringBuilder_construct);
+JSR_NATIVE(jsr_StringBuilder_append);
+JSR_NATIVE(jsr_StringBuilder_clear);
+JSR_NATIVE(jsr_StringBuilder_len);
+JSR_NATIVE(jsr_StringBuilder_string);
+// end
+
+// class TypedArray
+JSR_NATIVE(jsr_TypedArray_len);
+JSR_NATIVE(jsr_TypedArray_get);
+JSR_NATIVE(jsr_TypedArray_set);
+JSR_NATIVE(jsr_TypedArray_iter);
+JSR_NATIVE(jsr_TypedArray_next);
+JSR_NATIVE(jsr_TypedArray_fill);
+JSR_NATIVE(jsr_TypedArray_sum);
+JSR_NATIVE(jsr_TypedArray_dot);
+JSR_NATIVE(jsr_TypedArray_map);
+JSR_NATIVE(jsr_TypedArray_slice);
+JSR_NATIVE(jsr_Float64Array_construct);
+JSR_NATIVE(jsr_Int32Array_construct);
+JSR_NATIVE(jsr_Uint8Array_construct);
+// end
+
+// class ByteArray
+JSR_NATIVE(jsr_ByteArray_construct);
+JSR_NATIVE(jsr_ByteArray_len);
+JSR_NATIVE(jsr_ByteArray_get);
+JSR_NATIVE(jsr_ByteArray_set);
+JSR_NATIVE(jsr_ByteArray_iter);
+JSR_NATIVE(jsr_ByteArray_next);
+JSR_NATIVE(jsr_ByteArray_add);
+JSR_NATIVE(jsr_ByteArray_addAll);
+JSR_NATIVE(jsr_ByteArray_resize);
+JSR_NATIVE(jsr_ByteArray_clear);
+JSR_NATIVE(jsr_ByteArray_slice);
+JSR_NATIVE(jsr_ByteArray_eq);
+JSR_NATIVE(jsr_ByteArray_string);
+// end
+
 // class Enum
 JSR_NATIVE(jsr_Enum_construct);
 JSR_NATIVE(jsr_Enum_value);
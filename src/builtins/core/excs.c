@@ -76,7 +76,8 @@ JSR_NATIVE(jsr_Exception_printStacktrace) {
     instanceGetField(cls, exc, vm->excErr, &err);
 
     if(IS_STRING(err) && AS_STRING(err)->length > 0) {
-        fprintf(stderr, "%s: %s\n", exc->base.cls->name->data, AS_STRING(err)->data);
+        ObjString* msg = AS_STRING(err);
+        fprintf(stderr, "%s: %.*s\n", exc->base.cls->name->data, (int)msg->length, msg->data);
     } else {
         fprintf(stderr, "%s\n", exc->base.cls->name->data);
     }
@@ -151,7 +152,8 @@ JSR_NATIVE(jsr_Exception_getStacktrace) {
     instanceGetField(exc->base.cls, exc, vm->excErr, &err);
 
     if(IS_STRING(err) && AS_STRING(err)->length > 0) {
-        jsrBufferAppendf(&buf, "%s: %s", exc->base.cls->name->data, AS_STRING(err)->data);
+        ObjString* msg = AS_STRING(err);
+        jsrBufferAppendf(&buf, "%s: %.*s", exc->base.cls->name->data, (int)msg->length, msg->data);
     } else {
         jsrBufferAppendf(&buf, "%s", exc->base.cls->name->data);
     }
@@ -72,7 +72,7 @@ JSR_NATIVE(jsr_print) {
     if(!jsrIsString(vm, -1)) {
         JSR_RAISE(vm, "TypeException", "s.__string__() didn't return a String");
     }
-    fwrite(jsrGetString(vm, -1), 1, jsrGetStringSz(vm, -1), stdout);
+    fwrite(AS_STRING(peek(vm))->data, 1, AS_STRING(peek(vm))->length, stdout);
     jsrPop(vm);
 
     JSR_FOREACH(2) {
@@ -82,7 +82,7 @@ JSR_NATIVE(jsr_print) {
             JSR_RAISE(vm, "TypeException", "__string__() didn't return a String");
         }
         printf(" ");
-        fwrite(jsrGetString(vm, -1), 1, jsrGetStringSz(vm, -1), stdout);
+        fwrite(AS_STRING(peek(vm))->data, 1, AS_STRING(peek(vm))->length, stdout);
         jsrPop(vm);
     }
     printf("\n");
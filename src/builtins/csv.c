@@ -0,0 +1,675 @@
+#include "csv.h"
+
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "object.h"
+#include "string_util.h"
+#include "value.h"
+#include "vm.h"
+
+#define MAX_SAFE_INT      9007199254740992.0  // 2^53
+#define MAX_PRECISION     17                  // Significant digits that round-trip any double
+#define MAX_ERROR_FIELD   32                  // Bytes of an invalid field quoted in errors
+#define WRITE_BUFFER_SIZE 65536
+
+#define NO_RECORD SIZE_MAX
+
+#define M_FILE   "_file"
+#define M_STATE  "_state"
+#define M_ROW    "_row"
+#define M_HEADER "header"
+
+// Gets a single character argument, such as a separator or a quote
+static bool getChar(JStarVM* vm, int slot, const char* name, char* c) {
+    JSR_CHECK(String, slot, name);
+    if(jsrGetStringSz(vm, slot) != 1) {
+        JSR_RAISE(vm, "InvalidArgException", "%s must be a single character", name);
+    }
+
+    *c = jsrGetString(vm, slot)[0];
+    if(*c == '\r' || *c == '\n') {
+        JSR_RAISE(vm, "InvalidArgException", "%s cannot be a newline", name);
+    }
+
+    return true;
+}
+
+static bool getDialect(JStarVM* vm, int sepSlot, int quoteSlot, char* sep, char* quote) {
+    if(!getChar(vm, sepSlot, "sep", sep)) return false;
+    if(!getChar(vm, quoteSlot, "quote", quote)) return false;
+    if(*sep == *quote) JSR_RAISE(vm, "InvalidArgException", "sep and quote must be different");
+    return true;
+}
+
+static void* getState(JStarVM* vm) {
+    if(!jsrGetField(vm, 0, M_STATE)) return NULL;
+    if(!jsrCheckUserdata(vm, -1, M_STATE)) return NULL;
+    void* st = jsrGetUserdata(vm, -1);
+    jsrPop(vm);
+    return st;
+}
+
+// -----------------------------------------------------------------------------
+// READER
+// -----------------------------------------------------------------------------
+
+// Input read from the file of a Reader, along with the state of the scan for the end of the
+// current record. A record is first located as a whole, reading more input until it is complete,
+// and only then split in fields. This way a record spanning multiple reads is scanned only once,
+// and quoted fields can be unescaped in place.
+typedef struct ReaderState {
+    char* data;         // Bytes read but not yet consumed, with a spare byte past `size`
+    size_t size, capacity;
+    size_t start;       // Start of the current record
+    size_t scan;        // How far the current record has been scanned
+    bool inQuotes;      // Whether the scan is inside a quoted field
+    bool quoted;        // Whether the current record contains quoted fields
+    bool eof;
+    size_t line;        // Line where the current record starts
+    size_t fields;      // Number of fields of the last record, used to size the next row
+    size_t chunkSize;
+    char sep, quote;
+    size_t typeCount;
+    bool* numeric;      // Columns to convert to Numbers
+} ReaderState;
+
+static void freeReaderState(void* udata) {
+    ReaderState* st = udata;
+    free(st->data);
+    free(st->numeric);
+}
+
+// Compacts the buffer and appends the next chunk read from the file at `fileSlot`.
+// Sets `eof` if the file has no more data
+static bool readChunk(JStarVM* vm, ReaderState* st, int fileSlot) {
+    if(st->start) {
+        memmove(st->data, st->data + st->start, st->size - st->start);
+        st->size -= st->start;
+        st->scan -= st->start;
+        st->start = 0;
+    }
+
+    jsrPushValue(vm, fileSlot);
+    jsrPushNumber(vm, st->chunkSize);
+    if(!jsrCallMethod(vm, "read", 1)) return false;
+
+    const char* chunk;
+    size_t length;
+    if(jsrIsByteArray(vm, -1)) {
+        chunk = jsrGetByteArray(vm, -1, &length);
+    } else if(jsrIsString(vm, -1)) {
+        chunk = jsrGetStringBytes(vm, -1, &length);
+    } else {
+        JSR_RAISE(vm, "TypeException", "read() must return a String or a ByteArray");
+    }
+
+    if(length == 0) {
+        st->eof = true;
+        jsrPop(vm);
+        return true;
+    }
+
+    if(st->size + length + 1 > st->capacity) {
+        size_t newCap = st->capacity ? st->capacity : st->chunkSize + 1;
+        while(newCap < st->size + length + 1) newCap *= 2;
+
+        char* newData = realloc(st->data, newCap);
+        if(!newData) JSR_RAISE(vm, "CSVException", "Out of memory");
+
+        st->data = newData;
+        st->capacity = newCap;
+    }
+
+    memcpy(st->data + st->size, chunk, length);
+    st->size += length;
+    jsrPop(vm);
+    return true;
+}
+
+typedef enum RecordResult {
+    RECORD_FOUND,
+    RECORD_PARTIAL,  // More input is needed to find the end of the record
+    RECORD_ERROR,
+} RecordResult;
+
+// Scans for the newline terminating the current record, skipping the ones inside quoted fields
+static RecordResult findRecordEnd(JStarVM* vm, ReaderState* st, size_t* end) {
+    const char stops[] = {st->quote, '\n'};
+
+    while(st->scan < st->size) {
+        const char* data = st->data;
+        size_t avail = st->size - st->scan;
+
+        if(st->inQuotes) {
+            st->scan += strSpanNotIn(data + st->scan, avail, &st->quote, 1);
+            if(st->scan == st->size) break;
+
+            // A closing quote can only be told apart from a doubled one by looking at the next byte
+            if(st->scan + 1 == st->size && !st->eof) break;
+
+            if(st->scan + 1 < st->size && data[st->scan + 1] == st->quote) {
+                st->scan += 2;
+            } else {
+                st->inQuotes = false;
+                st->scan++;
+            }
+        } else {
+            st->scan += strSpanNotIn(data + st->scan, avail, stops, 2);
+            if(st->scan == st->size) break;
+
+            if(data[st->scan] == '\n') {
+                *end = st->scan;
+                return RECORD_FOUND;
+            }
+
+            // Quotes are special only at the start of a field, elsewhere they are taken literally
+            if(st->scan == st->start || data[st->scan - 1] == st->sep) {
+                st->inQuotes = true;
+                st->quoted = true;
+            }
+            st->scan++;
+        }
+    }
+
+    if(!st->eof) return RECORD_PARTIAL;
+
+    if(st->inQuotes) {
+        jsrRaise(vm, "CSVException", "Unterminated quoted field at line %zu", st->line);
+        st->start = st->scan = st->size;
+        st->inQuotes = st->quoted = false;
+        return RECORD_ERROR;
+    }
+
+    *end = st->size;
+    return RECORD_FOUND;
+}
+
+static bool isBlank(const ReaderState* st, size_t end) {
+    return end == st->start || (end == st->start + 1 && st->data[st->start] == '\r');
+}
+
+// Consumes the current record, ending at `end`
+static void consumeRecord(ReaderState* st, size_t end) {
+    st->line++;
+    if(st->quoted) {
+        const char* nl = st->data + st->start;
+        while((nl = memchr(nl, '\n', st->data + end - nl))) {
+            st->line++;
+            nl++;
+        }
+    }
+
+    st->start = end < st->size ? end + 1 : end;
+    st->scan = st->start;
+    st->quoted = false;
+}
+
+// Locates the next non blank record, reading more input as needed.
+// Sets `end` to NO_RECORD if there are no more records
+static bool nextRecord(JStarVM* vm, ReaderState* st, int fileSlot, size_t* end) {
+    for(;;) {
+        if(st->start == st->size && st->eof) {
+            *end = NO_RECORD;
+            return true;
+        }
+
+        switch(findRecordEnd(vm, st, end)) {
+        case RECORD_FOUND:
+            if(!isBlank(st, *end)) return true;
+            consumeRecord(st, *end);
+            break;
+        case RECORD_PARTIAL:
+            if(!readChunk(vm, st, fileSlot)) return false;
+            break;
+        case RECORD_ERROR:
+            return false;
+        }
+    }
+}
+
+// Converts a field to the type of its column. The byte after the field is always addressable,
+// and is used to temporarily NUL terminate it
+static bool fieldValue(JStarVM* vm, const ReaderState* st, size_t line, size_t col, char* field,
+                       size_t length, Value* val) {
+    if(col >= st->typeCount || !st->numeric[col]) {
+        ObjString* str = newString(vm, length);
+        memcpy(str->data, field, length);
+        *val = OBJ_VAL(str);
+        return true;
+    }
+
+    if(length == 0) {
+        *val = NULL_VAL;
+        return true;
+    }
+
+    char saved = field[length];
+    field[length] = '\0';
+    char* numEnd;
+    double num = strtod(field, &numEnd);
+    field[length] = saved;
+
+    if(numEnd != field + length) {
+        int shown = length > MAX_ERROR_FIELD ? MAX_ERROR_FIELD : (int)length;
+        JSR_RAISE(vm, "CSVException", "Invalid number `%.*s%s` in column %zu at line %zu", shown,
+                  field, (size_t)shown < length ? "..." : "", col + 1, line);
+    }
+
+    *val = NUM_VAL(num);
+    return true;
+}
+
+// Splits the current record, ending at `end`, in fields. The fields are appended to `row`, or to
+// the lists in `columns` if it is not NULL. The record is consumed even if it is malformed, so that
+// reading can continue past it
+static bool splitRecord(JStarVM* vm, ReaderState* st, size_t end, ObjList* row,
+                        ObjList* columns) {
+    char* p = st->data + st->start;
+    char* last = st->data + end;
+    if(last > p && last[-1] == '\r') last--;
+
+    size_t line = st->line;
+    consumeRecord(st, end);
+
+    size_t col = 0;
+    for(;;) {
+        char* field = p;
+        size_t length;
+
+        if(p < last && *p == st->quote) {
+            // Unescape the doubled quotes in place
+            char* out = field = ++p;
+            for(;;) {
+                size_t span = strSpanNotIn(p, last - p, &st->quote, 1);
+                memmove(out, p, span);
+                out += span;
+                p += span;
+
+                if(p == last) {
+                    JSR_RAISE(vm, "CSVException", "Unterminated quoted field at line %zu", line);
+                }
+                if(p + 1 < last && p[1] == st->quote) {
+                    *out++ = st->quote;
+                    p += 2;
+                } else {
+                    p++;
+                    break;
+                }
+            }
+
+            length = out - field;
+            if(p < last && *p != st->sep) {
+                JSR_RAISE(vm, "CSVException", "Unexpected character after a quoted field at line %zu",
+                          line);
+            }
+        } else {
+            length = strSpanNotIn(p, last - p, &st->sep, 1);
+            p += length;
+        }
+
+        Value val;
+        if(!fieldValue(vm, st, line, col, field, length, &val)) return false;
+
+        if(columns) {
+            if(col >= columns->count) {
+                JSR_RAISE(vm, "CSVException", "Record at line %zu has more than %zu fields", line,
+                          columns->count);
+            }
+            listAppend(vm, AS_LIST(columns->items[col]), val);
+        } else {
+            listAppend(vm, row, val);
+        }
+        col++;
+
+        if(p == last) break;
+        p++;
+    }
+
+    st->fields = col;
+
+    if(columns && col != columns->count) {
+        JSR_RAISE(vm, "CSVException", "Record at line %zu has %zu fields, expected %zu", line, col,
+                  columns->count);
+    }
+
+    return true;
+}
+
+// Reads the next record and pushes it as a List, or null at the end of the input.
+// `fileSlot` is the first slot free for use by the function
+static bool readRow(JStarVM* vm, int fileSlot) {
+    ReaderState* st = getState(vm);
+    if(!st) return false;
+
+    if(!jsrGetField(vm, 0, M_FILE)) return false;
+
+    size_t end;
+    if(!nextRecord(vm, st, fileSlot, &end)) return false;
+
+    if(end == NO_RECORD) {
+        jsrPushNull(vm);
+        return true;
+    }
+
+    if(!jsrGetField(vm, 0, M_ROW)) return false;
+
+    ObjList* row;
+    if(jsrIsList(vm, -1)) {
+        row = AS_LIST(peek(vm));
+        row->count = 0;
+    } else {
+        pop(vm);
+        row = newList(vm, st->fields);
+        push(vm, OBJ_VAL(row));
+    }
+
+    return splitRecord(vm, st, end, row, NULL);
+}
+
+// class Reader
+JSR_NATIVE(jsr_Reader_construct) {
+    char sep, quote;
+    if(!getDialect(vm, 2, 3, &sep, &quote)) return false;
+    JSR_CHECK(Boolean, 4, "header");
+    JSR_CHECK(Boolean, 6, "reuse");
+    JSR_CHECK(Int, 7, "chunkSize");
+
+    double chunkSize = jsrGetNumber(vm, 7);
+    if(chunkSize <= 0) JSR_RAISE(vm, "InvalidArgException", "chunkSize must be > 0");
+
+    size_t typeCount = 0;
+    if(!jsrIsNull(vm, 5)) {
+        JSR_CHECK(List, 5, "types");
+        ObjList* types = AS_LIST(vm->apiStack[5]);
+        for(size_t i = 0; i < types->count; i++) {
+            Value t = types->items[i];
+            if(!IS_NULL(t) && !(IS_CLASS(t) && (AS_CLASS(t) == vm->coreClasses[CORE_CLASS_NUMBER] ||
+                                                AS_CLASS(t) == vm->coreClasses[CORE_CLASS_STR]))) {
+                JSR_RAISE(vm, "TypeException", "types can only contain Number, String or null");
+            }
+        }
+        typeCount = types->count;
+    }
+
+    ReaderState* st = jsrPushUserdata(vm, sizeof(*st), &freeReaderState);
+    *st = (ReaderState){0};
+    st->line = 1;
+    st->chunkSize = chunkSize;
+    st->sep = sep;
+    st->quote = quote;
+
+    jsrSetField(vm, 0, M_STATE);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 1);
+    jsrSetField(vm, 0, M_FILE);
+    jsrPop(vm);
+
+    // The header is read before setting the column types, so that its fields are left as Strings
+    if(jsrGetBoolean(vm, 4)) {
+        size_t end;
+        if(!nextRecord(vm, st, 1, &end)) return false;
+
+        if(end == NO_RECORD) {
+            jsrPushNull(vm);
+        } else {
+            ObjList* header = newList(vm, 0);
+            push(vm, OBJ_VAL(header));
+            if(!splitRecord(vm, st, end, header, NULL)) return false;
+        }
+    } else {
+        jsrPushNull(vm);
+    }
+    jsrSetField(vm, 0, M_HEADER);
+    jsrPop(vm);
+
+    if(typeCount) {
+        st->numeric = malloc(typeCount * sizeof(bool));
+        if(!st->numeric) JSR_RAISE(vm, "CSVException", "Out of memory");
+
+        ObjList* types = AS_LIST(vm->apiStack[5]);
+        for(size_t i = 0; i < typeCount; i++) {
+            Value t = types->items[i];
+            st->numeric[i] = IS_CLASS(t) && AS_CLASS(t) == vm->coreClasses[CORE_CLASS_NUMBER];
+        }
+        st->typeCount = typeCount;
+    }
+
+    if(jsrGetBoolean(vm, 6)) {
+        jsrPushList(vm);
+    } else {
+        jsrPushNull(vm);
+    }
+    jsrSetField(vm, 0, M_ROW);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 0);
+    return true;
+}
+
+JSR_NATIVE(jsr_Reader_readRow) {
+    return readRow(vm, 1);
+}
+
+JSR_NATIVE(jsr_Reader_iter) {
+    return readRow(vm, 2);
+}
+
+JSR_NATIVE(jsr_Reader_readColumns) {
+    ReaderState* st = getState(vm);
+    if(!st) return false;
+
+    if(!jsrGetField(vm, 0, M_FILE)) return false;
+    ObjList* columns = newList(vm, 0);
+    push(vm, OBJ_VAL(columns));
+
+    size_t end;
+    if(!nextRecord(vm, st, 1, &end)) return false;
+    if(end == NO_RECORD) return true;
+
+    // The first record determines the number of columns
+    ObjList* first = newList(vm, 0);
+    push(vm, OBJ_VAL(first));
+    if(!splitRecord(vm, st, end, first, NULL)) return false;
+
+    for(size_t i = 0; i < first->count; i++) {
+        ObjList* column = newList(vm, 0);
+        listAppend(vm, columns, OBJ_VAL(column));
+        listAppend(vm, column, first->items[i]);
+    }
+    pop(vm);
+
+    for(;;) {
+        if(!nextRecord(vm, st, 1, &end)) return false;
+        if(end == NO_RECORD) break;
+        if(!splitRecord(vm, st, end, NULL, columns)) return false;
+    }
+
+    return true;
+}
+// end
+
+// -----------------------------------------------------------------------------
+// WRITER
+// -----------------------------------------------------------------------------
+
+typedef struct WriterState {
+    char sep, quote;
+    bool crlf;  // Terminate records with "\r\n" instead of "\n"
+} WriterState;
+
+static void writeString(const WriterState* ws, JStarBuffer* buf, const char* str, size_t length) {
+    const char special[] = {ws->sep, ws->quote, '\r', '\n'};
+    if(strSpanNotIn(str, length, special, 4) == length) {
+        jsrBufferAppend(buf, str, length);
+        return;
+    }
+
+    jsrBufferAppendChar(buf, ws->quote);
+    for(;;) {
+        size_t span = strSpanNotIn(str, length, &ws->quote, 1);
+        jsrBufferAppend(buf, str, span);
+        if(span == length) break;
+
+        jsrBufferAppendChar(buf, ws->quote);
+        jsrBufferAppendChar(buf, ws->quote);
+        str += span + 1;
+        length -= span + 1;
+    }
+    jsrBufferAppendChar(buf, ws->quote);
+}
+
+static void writeNumber(JStarBuffer* buf, double num) {
+    char str[32];
+    int length;
+    if(trunc(num) == num && num > -MAX_SAFE_INT && num < MAX_SAFE_INT) {
+        length = snprintf(str, sizeof(str), "%" PRId64, (int64_t)num);
+    } else {
+        // Use the shortest representation that converts back to the same Number
+        for(int precision = DBL_DIG; precision <= MAX_PRECISION; precision++) {
+            length = snprintf(str, sizeof(str), "%.*g", precision, num);
+            if(isnan(num) || strtod(str, NULL) == num) break;
+        }
+    }
+    jsrBufferAppend(buf, str, length);
+}
+
+// Appends the record `row` to `buf`, followed by the record terminator. Values other than Strings,
+// Numbers, Booleans and null are converted by calling their `__string__` method
+static bool writeRecord(JStarVM* vm, const WriterState* ws, JStarBuffer* buf, Value row) {
+    if(!IS_LIST(row) && !IS_TUPLE(row)) {
+        JSR_RAISE(vm, "TypeException", "A row must be a List or a Tuple, got %s",
+                  getClass(vm, row)->name->data);
+    }
+
+    push(vm, row);
+
+    size_t count;
+    getValues(AS_OBJ(row), &count);
+
+    for(size_t i = 0; i < count; i++) {
+        // `__string__` may run arbitrary code, so the values are fetched again on every iteration
+        size_t currCount;
+        Value* values = getValues(AS_OBJ(row), &currCount);
+        if(i >= currCount) break;
+
+        if(i > 0) jsrBufferAppendChar(buf, ws->sep);
+
+        Value val = values[i];
+        if(IS_STRING(val)) {
+            writeString(ws, buf, AS_STRING(val)->data, AS_STRING(val)->length);
+        } else if(IS_NUM(val)) {
+            writeNumber(buf, AS_NUM(val));
+        } else if(IS_BOOL(val)) {
+            jsrBufferAppendStr(buf, AS_BOOL(val) ? "true" : "false");
+        } else if(!IS_NULL(val)) {
+            push(vm, val);
+            if(!jsrCallMethod(vm, "__string__", 0)) return false;
+            if(!jsrIsString(vm, -1)) {
+                JSR_RAISE(vm, "TypeException", "%s.__string__() didn't return a String",
+                          getClass(vm, val)->name->data);
+            }
+            writeString(ws, buf, jsrGetString(vm, -1), jsrGetStringSz(vm, -1));
+            pop(vm);
+        }
+    }
+
+    jsrBufferAppendStr(buf, ws->crlf ? "\r\n" : "\n");
+    pop(vm);
+    return true;
+}
+
+// Writes the contents of `buf` to the file of the Writer and clears it
+static bool flushBuffer(JStarVM* vm, JStarBuffer* buf) {
+    if(!jsrGetField(vm, 0, M_FILE)) return false;
+    jsrPushStringSz(vm, buf->data, buf->size);
+    if(!jsrCallMethod(vm, "write", 1)) return false;
+    jsrPop(vm);
+    jsrBufferClear(buf);
+    return true;
+}
+
+// class Writer
+JSR_NATIVE(jsr_Writer_construct) {
+    char sep, quote;
+    if(!getDialect(vm, 2, 3, &sep, &quote)) return false;
+    JSR_CHECK(String, 4, "lineEnd");
+
+    const char* lineEnd = jsrGetString(vm, 4);
+    if(strcmp(lineEnd, "\r\n") != 0 && strcmp(lineEnd, "\n") != 0) {
+        JSR_RAISE(vm, "InvalidArgException", "lineEnd must be either '\\r\\n' or '\\n'");
+    }
+
+    WriterState* ws = jsrPushUserdata(vm, sizeof(*ws), NULL);
+    ws->sep = sep;
+    ws->quote = quote;
+    ws->crlf = lineEnd[0] == '\r';
+    jsrSetField(vm, 0, M_STATE);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 1);
+    jsrSetField(vm, 0, M_FILE);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 0);
+    return true;
+}
+
+JSR_NATIVE(jsr_Writer_writeRow) {
+    WriterState* ws = getState(vm);
+    if(!ws) return false;
+
+    JStarBuffer buf;
+    jsrBufferInit(vm, &buf);
+
+    if(!writeRecord(vm, ws, &buf, vm->apiStack[1]) || !flushBuffer(vm, &buf)) {
+        jsrBufferFree(&buf);
+        return false;
+    }
+
+    jsrBufferFree(&buf);
+    jsrPushNull(vm);
+    return true;
+}
+
+JSR_NATIVE(jsr_Writer_writeRows) {
+    WriterState* ws = getState(vm);
+    if(!ws) return false;
+
+    Value rows = vm->apiStack[1];
+    if(!IS_LIST(rows) && !IS_TUPLE(rows)) {
+        JSR_RAISE(vm, "TypeException", "rows must be a List or a Tuple, got %s",
+                  getClass(vm, rows)->name->data);
+    }
+
+    JStarBuffer buf;
+    jsrBufferInitCapacity(vm, &buf, WRITE_BUFFER_SIZE);
+
+    for(size_t i = 0;; i++) {
+        size_t count;
+        Value* values = getValues(AS_OBJ(rows), &count);
+        if(i >= count) break;
+
+        if(!writeRecord(vm, ws, &buf, values[i])) goto error;
+        if(buf.size >= WRITE_BUFFER_SIZE && !flushBuffer(vm, &buf)) goto error;
+    }
+
+    if(buf.size && !flushBuffer(vm, &buf)) goto error;
+
+    jsrBufferFree(&buf);
+    jsrPushNull(vm);
+    return true;
+
+error:
+    jsrBufferFree(&buf);
+    return false;
+}
+// end
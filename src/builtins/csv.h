@@ -0,0 +1,19 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include "jstar.h"
+
+// class Reader
+JSR_NATIVE(jsr_Reader_construct);
+JSR_NATIVE(jsr_Reader_readRow);
+JSR_NATIVE(jsr_Reader_readColumns);
+JSR_NATIVE(jsr_Reader_iter);
+// end
+
+// class Writer
+JSR_NATIVE(jsr_Writer_construct);
+JSR_NATIVE(jsr_Writer_writeRow);
+JSR_NATIVE(jsr_Writer_writeRows);
+// end
+
+#endif
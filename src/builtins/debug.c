@@ -5,6 +5,7 @@
 
 #include "disassemble.h"
 #include "object.h"
+#include "serialize.h"
 #include "value.h"
 #include "value_hashtable.h"
 #include "vm.h"
@@ -24,6 +25,20 @@ static bool isDisassemblable(Value v) {
     return (IS_OBJ(v) && (IS_CLOSURE(v) || IS_NATIVE(v) || IS_BOUND_METHOD(v) || IS_CLASS(v)));
 }
 
+// Deserialize the code of `fn` and of its nested functions if they were loaded lazily
+static bool loadFunctionCode(JStarVM* vm, ObjFunction* fn) {
+    if(fn->code.lazyChunk && !deserializeLazyCode(vm, fn)) {
+        return false;
+    }
+    for(size_t i = 0; i < fn->code.consts.count; i++) {
+        Value c = fn->code.consts.items[i];
+        if(IS_FUNC(c) && !loadFunctionCode(vm, AS_FUNC(c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 JSR_NATIVE(jsr_disassemble) {
     Value arg = vm->apiStack[1];
     if(!isDisassemblable(arg)) {
@@ -46,7 +61,12 @@ JSR_NATIVE(jsr_disassemble) {
     if(IS_NATIVE(arg)) {
         disassembleNative(AS_NATIVE(arg));
     } else {
-        disassembleFunction(AS_CLOSURE(arg)->fn);
+        ObjFunction* fn = AS_CLOSURE(arg)->fn;
+        if(!loadFunctionCode(vm, fn)) {
+            JSR_RAISE(vm, "ImportException", "Malformed binary file %s",
+                      fn->base.module->path->data);
+        }
+        disassembleFunction(fn);
     }
 
     jsrPushNull(vm);
@@ -1,15 +1,25 @@
 #include "io.h"
 
 #include <errno.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "buffer.h"
+#include "builtins.h"
+#include "gc.h"
 #include "jstar.h"
+#include "vm.h"
 
 #if defined(JSTAR_POSIX)
     #define USE_POPEN
+    #define USE_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
 #elif defined(JSTAR_WINDOWS)
     #define USE_POPEN
     #define popen  _popen
@@ -22,34 +32,143 @@
 #define JSR_SEEK_CUR 1
 #define JSR_SEEK_END 2
 
+#define LINE_BUFFER_SIZE 65536
+
+// Read buffer used by the line reading methods of File.
+// Data is read from the FILE in large chunks and lines are split directly in the buffer, so that
+// each line is copied only once, into its String. The bytes in [start, end) have been read from
+// the FILE but not yet consumed, so the FILE position is ahead of the logical position of the
+// File by `end - start` bytes. Operations other than line reads must `syncLineBuffer` first.
+typedef struct LineBuffer {
+    size_t start, end;
+    bool regular;
+    char data[LINE_BUFFER_SIZE];
+} LineBuffer;
+
 // static helper functions
 
-static bool readline(JStarVM* vm, FILE* file) {
-    JStarBuffer buf;
-    jsrBufferInitCapacity(vm, &buf, 256);
+static bool isRegularFile(FILE* file) {
+#if defined(JSTAR_POSIX)
+    struct stat st;
+    return fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode);
+#elif defined(JSTAR_WINDOWS)
+    struct _stat st;
+    return _fstat(fileno(file), &st) == 0 && (st.st_mode & _S_IFREG);
+#else
+    return false;
+#endif
+}
 
-    while(fgets(buf.data + buf.size, buf.capacity - buf.size, file) != NULL) {
-        buf.size += strlen(buf.data + buf.size);
-        if(buf.data[buf.size - 1] == '\n') break;
-        jsrBufferReserve(&buf, buf.size);
+// Refills an empty line buffer. Regular files are read a chunk at a time, while other streams
+// (terminals, pipes) are read a line at a time, so that we never block waiting for input past the
+// end of the line being read. Returns false on EOF or error
+static bool refillLineBuffer(LineBuffer* lb, FILE* file) {
+    lb->start = 0;
+    if(lb->regular) {
+        lb->end = fread(lb->data, 1, LINE_BUFFER_SIZE, file);
+    } else {
+        lb->end = fgets(lb->data, LINE_BUFFER_SIZE, file) ? strlen(lb->data) : 0;
+    }
+    return lb->end != 0;
+}
+
+// Reads a line, including its terminating newline, and pushes it on the stack.
+// Pushes null if the file is at EOF
+static bool readline(JStarVM* vm, FILE* file, LineBuffer* lb) {
+    JStarBuffer buf = {0};
+
+    for(;;) {
+        char* start = lb->data + lb->start;
+        size_t avail = lb->end - lb->start;
+
+        char* newline = memchr(start, '\n', avail);
+        if(newline) {
+            size_t len = newline - start + 1;
+            lb->start += len;
+
+            if(buf.data) {
+                jsrBufferAppend(&buf, start, len);
+                jsrBufferPush(&buf);
+            } else {
+                jsrPushStringSz(vm, start, len);
+            }
+            return true;
+        }
+
+        // The line continues past the buffered data, save what we have and read more
+        if(avail) {
+            if(!buf.data) jsrBufferInitCapacity(vm, &buf, avail * 2);
+            jsrBufferAppend(&buf, start, avail);
+        }
+
+        if(!refillLineBuffer(lb, file)) break;
     }
 
     if(ferror(file)) {
-        jsrRaise(vm, "IOException", strerror(errno));
         jsrBufferFree(&buf);
-        return false;
+        JSR_RAISE(vm, "IOException", strerror(errno));
     }
 
-    if(buf.size == 0 && feof(file)) {
+    if(buf.data) {
+        jsrBufferPush(&buf);
+    } else {
         jsrPushNull(vm);
-        jsrBufferFree(&buf);
-        return true;
     }
 
-    jsrBufferPush(&buf);
     return true;
 }
 
+#ifdef USE_MMAP
+// A read-only mapping of a file, unmapped when the String referencing it is collected
+typedef struct Mapping {
+    void* addr;
+    size_t size;
+} Mapping;
+
+static void unmapFile(void* userData) {
+    Mapping* mapping = userData;
+    munmap(mapping->addr, mapping->size);
+    free(mapping);
+}
+
+// Maps the file referenced by `fd` in memory and pushes a String referencing the mapped contents.
+// Returns 0 on success or an errno code on failure
+static int mapFile(JStarVM* vm, int fd) {
+    struct stat st;
+    if(fstat(fd, &st)) return errno;
+    if(!S_ISREG(st.st_mode)) return ENODEV;
+
+    // Empty files cannot be mapped
+    if(st.st_size == 0) {
+        jsrPushStringSz(vm, "", 0);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The GC doesn't account for mapped memory, so unreachable mappings may pile up until we run
+    // out of address space or of mappings. Collect them and try again
+    if(addr == MAP_FAILED && errno == ENOMEM) {
+        garbageCollect(vm);
+        addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    if(addr == MAP_FAILED) return errno;
+
+    Mapping* mapping = malloc(sizeof(*mapping));
+    if(!mapping) {
+        munmap(addr, size);
+        return ENOMEM;
+    }
+
+    mapping->addr = addr;
+    mapping->size = size;
+    jsrPushExternalString(vm, addr, size, &unmapFile, mapping);
+    return 0;
+}
+#endif
+
 static int jsrSeek(FILE* file, long offset, int jsrWhence) {
     int whence = 0;
     switch(jsrWhence) {
@@ -71,6 +190,16 @@ static int jsrSeek(FILE* file, long offset, int jsrWhence) {
 // class File
 #define M_FILE_HANDLE "_handle"
 #define M_FILE_CLOSED "_closed"
+#define M_FILE_LINES  "_lineBuffer"
+
+// The fields of File are read on every call, so they are looked up through cached symbols
+static bool getFileField(JStarVM* vm, BuiltInSymbol id, const char* name) {
+    return jsrGetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, id, name));
+}
+
+static bool setFileField(JStarVM* vm, BuiltInSymbol id, const char* name) {
+    return jsrSetFieldCached(vm, 0, NULL, getBuiltInSymbol(vm, id, name));
+}
 
 JSR_NATIVE(jsr_File_construct) {
     if(jsrIsNull(vm, 3)) {
@@ -92,33 +221,110 @@ JSR_NATIVE(jsr_File_construct) {
         }
 
         jsrPushHandle(vm, (void*)f);
-        jsrSetField(vm, 0, M_FILE_HANDLE);
+        setFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE);
 
         jsrPushBoolean(vm, false);
-        jsrSetField(vm, 0, M_FILE_CLOSED);
+        setFileField(vm, SYM_FILE_CLOSED, M_FILE_CLOSED);
     } else if(jsrIsHandle(vm, 3)) {
-        jsrSetField(vm, 0, M_FILE_HANDLE);
+        setFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE);
         jsrPushBoolean(vm, false);
-        jsrSetField(vm, 0, M_FILE_CLOSED);
+        setFileField(vm, SYM_FILE_CLOSED, M_FILE_CLOSED);
     } else {
         JSR_RAISE(vm, "TypeException", "Provided FILE* handle is not valid");
     }
 
+    // Allocated lazily on the first line read
+    jsrPushNull(vm);
+    setFileField(vm, SYM_FILE_LINES, M_FILE_LINES);
+
     // return `this`. required in native constructors
     jsrPushValue(vm, 0);
     return true;
 }
 
 static bool checkClosed(JStarVM* vm) {
-    if(!jsrGetField(vm, 0, M_FILE_CLOSED)) return false;
+    if(!getFileField(vm, SYM_FILE_CLOSED, M_FILE_CLOSED)) return false;
     bool closed = jsrGetBoolean(vm, -1);
     if(closed) JSR_RAISE(vm, "IOException", "closed file");
     return true;
 }
 
+// Returns the line buffer of the File, creating it if needed
+static LineBuffer* getLineBuffer(JStarVM* vm, FILE* f) {
+    if(!getFileField(vm, SYM_FILE_LINES, M_FILE_LINES)) return NULL;
+    if(jsrIsUserdata(vm, -1)) {
+        return jsrGetUserdata(vm, -1);
+    }
+
+    LineBuffer* lb = jsrPushUserdata(vm, sizeof(*lb), NULL);
+    lb->start = lb->end = 0;
+    lb->regular = isRegularFile(f);
+    setFileField(vm, SYM_FILE_LINES, M_FILE_LINES);
+    return lb;
+}
+
+// Returns the number of bytes read from `f` but not yet consumed by the line reader
+static bool pendingBytes(JStarVM* vm, size_t* pending) {
+    if(!getFileField(vm, SYM_FILE_LINES, M_FILE_LINES)) return false;
+    if(jsrIsUserdata(vm, -1)) {
+        LineBuffer* lb = jsrGetUserdata(vm, -1);
+        *pending = lb->end - lb->start;
+    } else {
+        *pending = 0;
+    }
+    jsrPop(vm);
+    return true;
+}
+
+// Reads up to `n` bytes into `dst`, consuming the data already buffered by the line reader first.
+// Stores the number of bytes read in `read`
+static bool readBytes(JStarVM* vm, FILE* f, void* dst, size_t n, size_t* read) {
+    if(!getFileField(vm, SYM_FILE_LINES, M_FILE_LINES)) return false;
+
+    size_t taken = 0;
+    if(jsrIsUserdata(vm, -1)) {
+        LineBuffer* lb = jsrGetUserdata(vm, -1);
+        size_t avail = lb->end - lb->start;
+        taken = avail < n ? avail : n;
+        if(taken) memcpy(dst, lb->data + lb->start, taken);
+        lb->start += taken;
+    }
+    jsrPop(vm);
+
+    size_t count = 0;
+    if(n > taken) {
+        count = fread((char*)dst + taken, 1, n - taken, f);
+        if(count < n - taken && ferror(f)) JSR_RAISE(vm, "IOException", strerror(errno));
+    }
+
+    *read = taken + count;
+    return true;
+}
+
+// Moves back the position of `f` to the first byte not consumed by the line reader and drops the
+// buffered data. Must be called before any operation that uses or changes the position of `f`
+static bool syncLineBuffer(JStarVM* vm, FILE* f) {
+    if(!getFileField(vm, SYM_FILE_LINES, M_FILE_LINES)) return false;
+    if(!jsrIsUserdata(vm, -1)) {
+        jsrPop(vm);
+        return true;
+    }
+
+    LineBuffer* lb = jsrGetUserdata(vm, -1);
+    size_t pending = lb->end - lb->start;
+    lb->start = lb->end = 0;
+    jsrPop(vm);
+
+    if(pending && fseek(f, -(long)pending, SEEK_CUR)) {
+        JSR_RAISE(vm, "IOException", strerror(errno));
+    }
+
+    return true;
+}
+
 JSR_NATIVE(jsr_File_seek) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
     JSR_CHECK(Int, 1, "off");
     JSR_CHECK(Int, 2, "whence");
@@ -131,6 +337,7 @@ JSR_NATIVE(jsr_File_seek) {
         JSR_RAISE(vm, "InvalidArgException", "Invalid whence (%d)", whence);
     }
 
+    if(!syncLineBuffer(vm, f)) return false;
     if(jsrSeek(f, offset, whence)) {
         JSR_RAISE(vm, "IOException", strerror(errno));
     }
@@ -141,26 +348,30 @@ JSR_NATIVE(jsr_File_seek) {
 
 JSR_NATIVE(jsr_File_tell) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
 
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
 
+    size_t pending;
+    if(!pendingBytes(vm, &pending)) return false;
+
     long off = ftell(f);
     if(off == -1) {
         JSR_RAISE(vm, "IOException", strerror(errno));
     }
 
-    jsrPushNumber(vm, off);
+    jsrPushNumber(vm, off - (long)pending);
     return true;
 }
 
 JSR_NATIVE(jsr_File_rewind) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
 
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
+    if(!syncLineBuffer(vm, f)) return false;
     rewind(f);
 
     jsrPushNull(vm);
@@ -169,7 +380,7 @@ JSR_NATIVE(jsr_File_rewind) {
 
 JSR_NATIVE(jsr_File_read) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
     JSR_CHECK(Int, 1, "bytes");
 
@@ -180,23 +391,56 @@ JSR_NATIVE(jsr_File_read) {
     JStarBuffer data;
     jsrBufferInitCapacity(vm, &data, bytes);
 
-    size_t read = fread(data.data, 1, bytes, f);
-    if(read < (size_t)bytes && ferror(f)) {
+    if(!readBytes(vm, f, data.data, bytes, &data.size)) {
         jsrBufferFree(&data);
-        JSR_RAISE(vm, "IOException", strerror(errno));
+        return false;
     }
 
-    data.size = read;
     jsrBufferPush(&data);
     return true;
 }
 
+JSR_NATIVE(jsr_File_readInto) {
+    if(!checkClosed(vm)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
+    JSR_CHECK(Handle, -1, M_FILE_HANDLE);
+    JSR_CHECK(ByteArray, 1, "buf");
+    JSR_CHECK(Int, 2, "off");
+
+    FILE* f = (FILE*)jsrGetHandle(vm, -1);
+
+    size_t size;
+    jsrGetByteArray(vm, 1, &size);
+
+    size_t off = jsrCheckIndex(vm, 2, size + 1, "off");
+    if(off == SIZE_MAX) return false;
+
+    size_t n = size - off;
+    if(!jsrIsNull(vm, 3)) {
+        JSR_CHECK(Int, 3, "n");
+        double count = jsrGetNumber(vm, 3);
+        if(count < 0 || count > n) {
+            JSR_RAISE(vm, "InvalidArgException", "n must be between 0 and %zu", n);
+        }
+        n = count;
+    }
+
+    uint8_t* bytes = jsrGetByteArray(vm, 1, NULL);
+
+    size_t read;
+    if(!readBytes(vm, f, bytes + off, n, &read)) return false;
+
+    jsrPushNumber(vm, read);
+    return true;
+}
+
 JSR_NATIVE(jsr_File_readAll) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
 
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
+    if(!syncLineBuffer(vm, f)) return false;
     if(fseek(f, 0, SEEK_END) < 0) {
         JSR_RAISE(vm, "IOException", strerror(errno));
     }
@@ -233,22 +477,57 @@ JSR_NATIVE(jsr_File_readAll) {
 
 JSR_NATIVE(jsr_File_readLine) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
-    if(!readline(vm, f)) return false;
+
+    LineBuffer* lb = getLineBuffer(vm, f);
+    if(!lb) return false;
+
+    return readline(vm, f, lb);
+}
+
+JSR_NATIVE(jsr_File_readLines) {
+    if(!checkClosed(vm)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
+    JSR_CHECK(Handle, -1, M_FILE_HANDLE);
+    FILE* f = (FILE*)jsrGetHandle(vm, -1);
+
+    double max = HUGE_VAL;
+    if(!jsrIsNull(vm, 1)) {
+        JSR_CHECK(Int, 1, "n");
+        max = jsrGetNumber(vm, 1);
+        if(max < 0) JSR_RAISE(vm, "InvalidArgException", "n must be >= 0");
+    }
+
+    LineBuffer* lb = getLineBuffer(vm, f);
+    if(!lb) return false;
+
+    jsrPushList(vm);
+    for(double i = 0; i < max; i++) {
+        if(!readline(vm, f, lb)) return false;
+        if(jsrIsNull(vm, -1)) {
+            jsrPop(vm);
+            break;
+        }
+        jsrListAppend(vm, -2);
+        jsrPop(vm);
+    }
+
     return true;
 }
 
 JSR_NATIVE(jsr_File_write) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
-    JSR_CHECK(String, 1, "data");
 
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
-    size_t datalen = jsrGetStringSz(vm, 1);
-    const char* data = jsrGetString(vm, 1);
+    if(!syncLineBuffer(vm, f)) return false;
+
+    size_t datalen;
+    const char* data;
+    if(!getBytes(vm, 1, "data", &data, &datalen)) return false;
 
     if(fwrite(data, 1, datalen, f) < datalen) {
         JSR_RAISE(vm, "IOException", strerror(errno));
@@ -260,26 +539,29 @@ JSR_NATIVE(jsr_File_write) {
 
 JSR_NATIVE(jsr_File_close) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
 
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
 
     jsrPushBoolean(vm, true);
-    jsrSetField(vm, 0, M_FILE_CLOSED);
+    setFileField(vm, SYM_FILE_CLOSED, M_FILE_CLOSED);
+
+    jsrPushNull(vm);
+    setFileField(vm, SYM_FILE_LINES, M_FILE_LINES);
 
     if(fclose(f)) {
         JSR_RAISE(vm, "IOException", strerror(errno));
     }
 
     jsrPushNull(vm);
-    jsrSetField(vm, 0, M_FILE_HANDLE);
+    setFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE);
     return true;
 }
 
 JSR_NATIVE(jsr_File_flush) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
     if(fflush(f) == EOF) JSR_RAISE(vm, "IOException", strerror(errno));
@@ -292,13 +574,16 @@ JSR_NATIVE(jsr_File_reopen) {
     JSR_CHECK(String, 2, "mode");
 
     jsrPushBoolean(vm, false);
-    jsrSetField(vm, 0, M_FILE_CLOSED);
+    setFileField(vm, SYM_FILE_CLOSED, M_FILE_CLOSED);
     jsrPop(vm);
 
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
 
+    jsrPushNull(vm);
+    setFileField(vm, SYM_FILE_LINES, M_FILE_LINES);
+
     const char* path = jsrGetString(vm, 1);
     const char* mode = jsrGetString(vm, 2);
 
@@ -316,9 +601,27 @@ JSR_NATIVE(jsr_File_reopen) {
     return true;
 }
 
+JSR_NATIVE(jsr_File_mmap) {
+#ifdef USE_MMAP
+    if(!checkClosed(vm)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
+    JSR_CHECK(Handle, -1, M_FILE_HANDLE);
+    FILE* f = (FILE*)jsrGetHandle(vm, -1);
+
+    // Make sure the mapping sees the data written through `f`
+    if(fflush(f) == EOF) JSR_RAISE(vm, "IOException", strerror(errno));
+
+    int err = mapFile(vm, fileno(f));
+    if(err) JSR_RAISE(vm, "IOException", strerror(err));
+    return true;
+#else
+    JSR_RAISE(vm, "NotImplementedException", "mmap not supported on current system.");
+#endif
+}
+
 JSR_NATIVE(jsr_File_fileno) {
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
 
@@ -352,10 +655,13 @@ JSR_NATIVE(jsr_Popen_construct) {
     }
 
     jsrPushHandle(vm, f);
-    jsrSetField(vm, 0, M_FILE_HANDLE);
+    setFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE);
 
     jsrPushBoolean(vm, false);
-    jsrSetField(vm, 0, M_FILE_CLOSED);
+    setFileField(vm, SYM_FILE_CLOSED, M_FILE_CLOSED);
+
+    jsrPushNull(vm);
+    setFileField(vm, SYM_FILE_LINES, M_FILE_LINES);
 
     jsrPushValue(vm, 0);
     return true;
@@ -367,13 +673,16 @@ JSR_NATIVE(jsr_Popen_construct) {
 JSR_NATIVE(jsr_Popen_close) {
 #ifdef USE_POPEN
     if(!checkClosed(vm)) return false;
-    if(!jsrGetField(vm, 0, M_FILE_HANDLE)) return false;
+    if(!getFileField(vm, SYM_FILE_HANDLE, M_FILE_HANDLE)) return false;
     JSR_CHECK(Handle, -1, M_FILE_HANDLE);
 
     FILE* f = (FILE*)jsrGetHandle(vm, -1);
 
     jsrPushBoolean(vm, true);
-    jsrSetField(vm, 0, M_FILE_CLOSED);
+    setFileField(vm, SYM_FILE_CLOSED, M_FILE_CLOSED);
+
+    jsrPushNull(vm);
+    setFileField(vm, SYM_FILE_LINES, M_FILE_LINES);
 
     int ret;
     if((ret = pclose(f)) < 0) {
@@ -399,6 +708,30 @@ JSR_NATIVE(jsr_remove) {
     return true;
 }
 
+JSR_NATIVE(jsr_mmap) {
+#ifdef USE_MMAP
+    JSR_CHECK(String, 1, "path");
+    const char* path = jsrGetString(vm, 1);
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        if(errno == ENOENT) {
+            JSR_RAISE(vm, "FileNotFoundException", "Couldn't find file `%s`", path);
+        }
+        JSR_RAISE(vm, "IOException", "%s: %s", path, strerror(errno));
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    int err = mapFile(vm, fd);
+    close(fd);
+
+    if(err) JSR_RAISE(vm, "IOException", "%s: %s", path, strerror(err));
+    return true;
+#else
+    JSR_RAISE(vm, "NotImplementedException", "mmap not supported on current system.");
+#endif
+}
+
 JSR_NATIVE(jsr_rename) {
     JSR_CHECK(String, 1, "oldpath");
     JSR_CHECK(String, 2, "newpath");
@@ -6,8 +6,10 @@
 // class File
 JSR_NATIVE(jsr_File_construct);
 JSR_NATIVE(jsr_File_read);
+JSR_NATIVE(jsr_File_readInto);
 JSR_NATIVE(jsr_File_readAll);
 JSR_NATIVE(jsr_File_readLine);
+JSR_NATIVE(jsr_File_readLines);
 JSR_NATIVE(jsr_File_write);
 JSR_NATIVE(jsr_File_close);
 JSR_NATIVE(jsr_File_seek);
@@ -16,6 +18,7 @@ JSR_NATIVE(jsr_File_rewind);
 JSR_NATIVE(jsr_File_flush);
 JSR_NATIVE(jsr_File_reopen);
 JSR_NATIVE(jsr_File_fileno);
+JSR_NATIVE(jsr_File_mmap);
 // end File
 
 // class Popen
@@ -26,6 +29,7 @@ JSR_NATIVE(jsr_Popen_close);
 // Functions
 JSR_NATIVE(jsr_remove);
 JSR_NATIVE(jsr_rename);
+JSR_NATIVE(jsr_mmap);
 JSR_NATIVE(jsr_io_init);
 
 #endif
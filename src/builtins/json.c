@@ -0,0 +1,942 @@
+#include "json.h"
+
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "core/core.h"
+#include "object.h"
+#include "string_util.h"
+#include "value.h"
+#include "vm.h"
+
+#define MAX_DEPTH       512
+#define MAX_ERROR       128
+#define KEY_CACHE_SIZE  256
+#define MAX_FAST_DIGITS 15
+#define MAX_FAST_EXP    22
+#define MAX_SAFE_INT    9007199254740992.0  // 2^53
+#define MAX_PRECISION   17                  // Significant digits that round-trip any double
+
+#define M_DECODER_STATE "_state"
+
+static const double powersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int hexValue(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// -----------------------------------------------------------------------------
+// PARSER
+// -----------------------------------------------------------------------------
+
+// Recursive descent parser that builds the J* values of a JSON document directly on the VM stack
+typedef struct JSONParser {
+    JStarVM* vm;
+    const char *start, *pos, *end;
+    int depth;
+    JStarBuffer scratch;              // Holds the decoded strings containing escapes
+    Value* keys;       // Object keys already created while parsing the document, `KEY_CACHE_SIZE`
+                       // slots of a Tuple kept on the stack so that the GC can reach them
+} JSONParser;
+
+// Pushes the Tuple holding the key cache on the stack
+static void initParser(JSONParser* p, JStarVM* vm, const char* data, size_t length) {
+    p->vm = vm;
+    p->start = p->pos = data;
+    p->end = data + length;
+    p->depth = 0;
+    p->scratch = (JStarBuffer){0};
+
+    ObjTuple* keys = newTuple(vm, KEY_CACHE_SIZE);
+    push(vm, OBJ_VAL(keys));
+    p->keys = keys->items;
+}
+
+static void freeParser(JSONParser* p) {
+    if(p->scratch.data) jsrBufferFree(&p->scratch);
+}
+
+static bool parseError(JSONParser* p, const char* fmt, ...) {
+    char msg[MAX_ERROR];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+
+    int line = 1;
+    const char* lineStart = p->start;
+    for(const char* c = p->start; (c = memchr(c, '\n', p->pos - c)); c++) {
+        line++;
+        lineStart = c + 1;
+    }
+
+    JSR_RAISE(p->vm, "JSONException", "%s at line %d, column %d", msg, line,
+              (int)(p->pos - lineStart) + 1);
+}
+
+static void skipSpace(JSONParser* p) {
+    while(p->pos < p->end && isSpace(*p->pos)) {
+        p->pos++;
+    }
+}
+
+static bool match(JSONParser* p, char c) {
+    skipSpace(p);
+    if(p->pos < p->end && *p->pos == c) {
+        p->pos++;
+        return true;
+    }
+    return false;
+}
+
+// Returns the length of the longest prefix of `str` that doesn't need any further processing to be
+// part of a string, i.e. that doesn't contain a quote, a backslash or a control character
+static size_t plainSpan(const char* str, size_t len, bool* isCtrl) {
+    size_t span = strSpanNotIn(str, len, "\"\\", 2);
+    size_t ctrlSpan = strSpanNotInRange(str, span, 0, 0x1f);
+    *isCtrl = ctrlSpan < span;
+    return ctrlSpan;
+}
+
+static void appendUtf8(JStarBuffer* b, uint32_t cp) {
+    char out[4];
+    size_t len;
+    if(cp < 0x80) {
+        out[0] = (char)cp;
+        len = 1;
+    } else if(cp < 0x800) {
+        out[0] = (char)(0xc0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3f));
+        len = 2;
+    } else if(cp < 0x10000) {
+        out[0] = (char)(0xe0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        out[2] = (char)(0x80 | (cp & 0x3f));
+        len = 3;
+    } else {
+        out[0] = (char)(0xf0 | (cp >> 18));
+        out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+        out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        out[3] = (char)(0x80 | (cp & 0x3f));
+        len = 4;
+    }
+    jsrBufferAppend(b, out, len);
+}
+
+// Parses the 4 hex digits of a `\u` escape at `p->pos`
+static bool parseHex4(JSONParser* p, uint32_t* cp) {
+    if(p->end - p->pos < 4) return parseError(p, "Invalid unicode escape");
+
+    *cp = 0;
+    for(int i = 0; i < 4; i++) {
+        int digit = hexValue(p->pos[i]);
+        if(digit < 0) return parseError(p, "Invalid unicode escape");
+        *cp = (*cp << 4) | (uint32_t)digit;
+    }
+
+    p->pos += 4;
+    return true;
+}
+
+// Parses the `\u` escape after the backslash at `p->pos`, combining surrogate pairs
+static bool parseUnicodeEscape(JSONParser* p) {
+    p->pos++;
+    uint32_t cp;
+    if(!parseHex4(p, &cp)) return false;
+
+    if(cp >= 0xd800 && cp <= 0xdbff && p->end - p->pos >= 2 && p->pos[0] == '\\' &&
+       p->pos[1] == 'u') {
+        const char* pairStart = p->pos;
+        p->pos += 2;
+
+        uint32_t low;
+        if(!parseHex4(p, &low)) return false;
+
+        if(low >= 0xdc00 && low <= 0xdfff) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+        } else {
+            // Not a pair, the second escape is decoded on its own
+            p->pos = pairStart;
+        }
+    }
+
+    appendUtf8(&p->scratch, cp);
+    return true;
+}
+
+// Parses the escape sequence after the backslash at `p->pos`, appending it to the scratch buffer
+static bool parseEscape(JSONParser* p) {
+    if(++p->pos == p->end) return parseError(p, "Unterminated string");
+
+    char c;
+    switch(*p->pos) {
+    case '"':
+    case '\\':
+    case '/':
+        c = *p->pos;
+        break;
+    case 'b':
+        c = '\b';
+        break;
+    case 'f':
+        c = '\f';
+        break;
+    case 'n':
+        c = '\n';
+        break;
+    case 'r':
+        c = '\r';
+        break;
+    case 't':
+        c = '\t';
+        break;
+    case 'u':
+        return parseUnicodeEscape(p);
+    default:
+        return parseError(p, "Invalid escape character '%c'", *p->pos);
+    }
+
+    jsrBufferAppendChar(&p->scratch, c);
+    p->pos++;
+    return true;
+}
+
+// Parses the string starting at the quote at `p->pos`. The contents are returned in `str`, that
+// either points into the document or, if the string contains escapes, into the scratch buffer
+static bool parseString(JSONParser* p, const char** str, size_t* length) {
+    const char* start = ++p->pos;
+
+    bool isCtrl;
+    size_t span = plainSpan(start, p->end - start, &isCtrl);
+    p->pos += span;
+
+    // Fast path: no escapes
+    if(!isCtrl && p->pos < p->end && *p->pos == '"') {
+        p->pos++;
+        *str = start;
+        *length = span;
+        return true;
+    }
+
+    if(p->scratch.data) {
+        jsrBufferClear(&p->scratch);
+    } else {
+        jsrBufferInit(p->vm, &p->scratch);
+    }
+    jsrBufferAppend(&p->scratch, start, span);
+
+    for(;;) {
+        if(isCtrl) return parseError(p, "Control character in string");
+        if(p->pos == p->end) return parseError(p, "Unterminated string");
+        if(*p->pos == '"') break;
+        if(!parseEscape(p)) return false;
+
+        span = plainSpan(p->pos, p->end - p->pos, &isCtrl);
+        jsrBufferAppend(&p->scratch, p->pos, span);
+        p->pos += span;
+    }
+
+    p->pos++;
+    *str = p->scratch.data;
+    *length = p->scratch.size;
+    return true;
+}
+
+// Returns the String for an object key, reusing the one created for an earlier occurrence of the
+// same key in the document if possible. Keys are interned, as tables intern them anyway
+static ObjString* internKey(JSONParser* p, const char* data, size_t length) {
+    size_t hash = length;
+    if(length) {
+        hash = hash * 31 + (unsigned char)data[0];
+        hash = hash * 31 + (unsigned char)data[length - 1];
+        hash = hash * 31 + (unsigned char)data[length / 2];
+    }
+
+    Value* entry = &p->keys[hash & (KEY_CACHE_SIZE - 1)];
+    if(IS_STRING(*entry)) {
+        ObjString* key = AS_STRING(*entry);
+        if(key->length == length && memcmp(key->data, data, length) == 0) return key;
+    }
+
+    ObjString* key = copyStringInterned(p->vm, data, length);
+    *entry = OBJ_VAL(key);
+    return key;
+}
+
+static bool parseNumber(JSONParser* p) {
+    const char* start = p->pos;
+    const char* c = p->pos;
+    bool negative = *c == '-';
+    if(negative) c++;
+
+    const char* intStart = c;
+    if(c < p->end && *c == '0') {
+        c++;
+    } else {
+        while(c < p->end && isDigit(*c)) c++;
+    }
+    const char* intEnd = c;
+
+    if(intStart == intEnd) {
+        p->pos = c;
+        return parseError(p, "Invalid number");
+    }
+
+    const char *fracStart = c, *fracEnd = c;
+    if(c < p->end && *c == '.') {
+        fracStart = ++c;
+        while(c < p->end && isDigit(*c)) c++;
+        fracEnd = c;
+        if(fracStart == fracEnd) {
+            p->pos = c;
+            return parseError(p, "Invalid number");
+        }
+    }
+
+    int exp = 0;
+    if(c < p->end && (*c == 'e' || *c == 'E')) {
+        c++;
+        bool negExp = false;
+        if(c < p->end && (*c == '+' || *c == '-')) negExp = *c++ == '-';
+
+        const char* expStart = c;
+        while(c < p->end && isDigit(*c)) {
+            if(exp < 10000) exp = exp * 10 + (*c - '0');
+            c++;
+        }
+        if(c == expStart) {
+            p->pos = c;
+            return parseError(p, "Invalid number");
+        }
+        if(negExp) exp = -exp;
+    }
+
+    p->pos = c;
+
+    // Fast path: an integer mantissa and a power of 10 that are both exactly representable give a
+    // correctly rounded result with a single multiplication or division
+    size_t intDigits = intEnd - intStart, fracDigits = fracEnd - fracStart;
+    int exp10 = exp - (int)fracDigits;
+    if(intDigits + fracDigits <= MAX_FAST_DIGITS && exp10 >= -MAX_FAST_EXP &&
+       exp10 <= MAX_FAST_EXP) {
+        uint64_t mantissa = 0;
+        for(const char* d = intStart; d < intEnd; d++) mantissa = mantissa * 10 + (*d - '0');
+        for(const char* d = fracStart; d < fracEnd; d++) mantissa = mantissa * 10 + (*d - '0');
+
+        double num = (double)mantissa;
+        num = exp10 < 0 ? num / powersOf10[-exp10] : num * powersOf10[exp10];
+        push(p->vm, NUM_VAL(negative ? -num : num));
+        return true;
+    }
+
+    // strtod needs a NUL terminated string
+    char buf[64];
+    size_t length = c - start;
+    if(length < sizeof(buf)) {
+        memcpy(buf, start, length);
+        buf[length] = '\0';
+        push(p->vm, NUM_VAL(strtod(buf, NULL)));
+    } else {
+        if(p->scratch.data) {
+            jsrBufferClear(&p->scratch);
+        } else {
+            jsrBufferInit(p->vm, &p->scratch);
+        }
+        jsrBufferAppend(&p->scratch, start, length);
+        push(p->vm, NUM_VAL(strtod(p->scratch.data, NULL)));
+    }
+
+    return true;
+}
+
+static bool parseLiteral(JSONParser* p, const char* literal, size_t length, Value val) {
+    if((size_t)(p->end - p->pos) < length || memcmp(p->pos, literal, length) != 0) {
+        return parseError(p, "Invalid literal");
+    }
+    p->pos += length;
+    push(p->vm, val);
+    return true;
+}
+
+static bool parseValue(JSONParser* p);
+
+static bool parseObject(JSONParser* p) {
+    JStarVM* vm = p->vm;
+    ObjTable* table = newTable(vm);
+    push(vm, OBJ_VAL(table));
+
+    p->pos++;
+    if(match(p, '}')) return true;
+
+    do {
+        skipSpace(p);
+        if(p->pos == p->end || *p->pos != '"') return parseError(p, "Expected string key");
+
+        const char* key;
+        size_t length;
+        if(!parseString(p, &key, &length)) return false;
+        push(vm, OBJ_VAL(internKey(p, key, length)));
+
+        if(!match(p, ':')) return parseError(p, "Expected ':'");
+        if(!parseValue(p)) return false;
+
+        bool newEntry;
+        if(!tableSet(vm, table, vm->sp[-2], vm->sp[-1], &newEntry)) return false;
+        pop(vm);
+        pop(vm);
+    } while(match(p, ','));
+
+    if(!match(p, '}')) return parseError(p, "Expected ',' or '}'");
+    return true;
+}
+
+static bool parseArray(JSONParser* p) {
+    JStarVM* vm = p->vm;
+    ObjList* list = newList(vm, 0);
+    push(vm, OBJ_VAL(list));
+
+    p->pos++;
+    if(match(p, ']')) return true;
+
+    do {
+        if(!parseValue(p)) return false;
+        listAppend(vm, list, peek(vm));
+        pop(vm);
+    } while(match(p, ','));
+
+    if(!match(p, ']')) return parseError(p, "Expected ',' or ']'");
+    return true;
+}
+
+static bool parseValue(JSONParser* p) {
+    skipSpace(p);
+    if(p->pos == p->end) return parseError(p, "Unexpected end of input");
+
+    switch(*p->pos) {
+    case '{':
+    case '[': {
+        if(++p->depth > MAX_DEPTH) return parseError(p, "Maximum nesting depth exceeded");
+        jsrEnsureStack(p->vm, 3);
+        bool ok = *p->pos == '{' ? parseObject(p) : parseArray(p);
+        p->depth--;
+        return ok;
+    }
+    case '"': {
+        const char* str;
+        size_t length;
+        if(!parseString(p, &str, &length)) return false;
+        ObjString* s = newString(p->vm, length);
+        memcpy(s->data, str, length);
+        push(p->vm, OBJ_VAL(s));
+        return true;
+    }
+    case 't':
+        return parseLiteral(p, "true", 4, TRUE_VAL);
+    case 'f':
+        return parseLiteral(p, "false", 5, FALSE_VAL);
+    case 'n':
+        return parseLiteral(p, "null", 4, NULL_VAL);
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        return parseNumber(p);
+    default:
+        return parseError(p, "Unexpected character '%c'", *p->pos);
+    }
+}
+
+// Parses the single JSON value contained in `data` and pushes it on the stack
+static bool parseDocument(JStarVM* vm, const char* data, size_t length) {
+    JSONParser p;
+    initParser(&p, vm, data, length);
+
+    bool ok = parseValue(&p);
+    if(ok) {
+        skipSpace(&p);
+        if(p.pos != p.end) ok = parseError(&p, "Unexpected data after the document");
+    }
+
+    // Replace the key cache with the parsed value
+    if(ok) {
+        vm->sp[-2] = vm->sp[-1];
+        pop(vm);
+    }
+
+    freeParser(&p);
+    return ok;
+}
+
+JSR_NATIVE(jsr_json_parse) {
+    const char* data;
+    size_t length;
+    if(!getBytes(vm, 1, "str", &data, &length)) return false;
+    return parseDocument(vm, data, length);
+}
+
+// -----------------------------------------------------------------------------
+// SERIALIZER
+// -----------------------------------------------------------------------------
+
+typedef struct JSONWriter {
+    JStarVM* vm;
+    JStarBuffer buf;
+    int indent;  // Spaces per nesting level, or -1 for compact output
+    int depth;
+} JSONWriter;
+
+static void writeString(JSONWriter* w, const char* str, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+
+    JStarBuffer* b = &w->buf;
+    jsrBufferAppendChar(b, '"');
+
+    const char* end = str + length;
+    while(str < end) {
+        bool isCtrl;
+        size_t span = plainSpan(str, end - str, &isCtrl);
+        jsrBufferAppend(b, str, span);
+        str += span;
+        if(str == end) break;
+
+        char c = *str++;
+        switch(c) {
+        case '"':
+            jsrBufferAppend(b, "\\\"", 2);
+            break;
+        case '\\':
+            jsrBufferAppend(b, "\\\\", 2);
+            break;
+        case '\b':
+            jsrBufferAppend(b, "\\b", 2);
+            break;
+        case '\f':
+            jsrBufferAppend(b, "\\f", 2);
+            break;
+        case '\n':
+            jsrBufferAppend(b, "\\n", 2);
+            break;
+        case '\r':
+            jsrBufferAppend(b, "\\r", 2);
+            break;
+        case '\t':
+            jsrBufferAppend(b, "\\t", 2);
+            break;
+        default: {
+            char esc[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf]};
+            jsrBufferAppend(b, esc, sizeof(esc));
+            break;
+        }
+        }
+    }
+
+    jsrBufferAppendChar(b, '"');
+}
+
+static bool writeNumber(JSONWriter* w, double num) {
+    if(isnan(num) || isinf(num)) {
+        JSR_RAISE(w->vm, "JSONException", "Cannot serialize %s, JSON has no NaN or infinities",
+                  isnan(num) ? "NaN" : num > 0 ? "Infinity" : "-Infinity");
+    }
+
+    char str[32];
+    int length;
+    if(trunc(num) == num && num > -MAX_SAFE_INT && num < MAX_SAFE_INT) {
+        length = snprintf(str, sizeof(str), "%" PRId64, (int64_t)num);
+    } else {
+        // Use the shortest representation that converts back to the same Number
+        for(int precision = DBL_DIG; precision <= MAX_PRECISION; precision++) {
+            length = snprintf(str, sizeof(str), "%.*g", precision, num);
+            if(strtod(str, NULL) == num) break;
+        }
+    }
+
+    jsrBufferAppend(&w->buf, str, length);
+    return true;
+}
+
+static void writeNewline(JSONWriter* w) {
+    if(w->indent < 0) return;
+    jsrBufferAppendChar(&w->buf, '\n');
+    for(int i = 0; i < w->depth * w->indent; i++) {
+        jsrBufferAppendChar(&w->buf, ' ');
+    }
+}
+
+static bool writeValue(JSONWriter* w, Value val);
+
+static bool writeArray(JSONWriter* w, const Value* items, size_t count) {
+    jsrBufferAppendChar(&w->buf, '[');
+    if(count == 0) {
+        jsrBufferAppendChar(&w->buf, ']');
+        return true;
+    }
+
+    w->depth++;
+    for(size_t i = 0; i < count; i++) {
+        if(i > 0) jsrBufferAppendChar(&w->buf, ',');
+        writeNewline(w);
+        if(!writeValue(w, items[i])) return false;
+    }
+    w->depth--;
+
+    writeNewline(w);
+    jsrBufferAppendChar(&w->buf, ']');
+    return true;
+}
+
+static bool writeObject(JSONWriter* w, ObjTable* table) {
+    jsrBufferAppendChar(&w->buf, '{');
+    if(table->count == 0) {
+        jsrBufferAppendChar(&w->buf, '}');
+        return true;
+    }
+
+    w->depth++;
+    bool first = true;
+    for(size_t i = 0; i <= table->sizeMask; i++) {
+        TableEntry* e = &table->entries[i];
+        if(IS_NULL(e->key)) continue;
+
+        if(!IS_STRING(e->key)) {
+            JSR_RAISE(w->vm, "TypeException", "Only Tables with String keys can be serialized, got %s",
+                      getClass(w->vm, e->key)->name->data);
+        }
+
+        if(!first) jsrBufferAppendChar(&w->buf, ',');
+        first = false;
+
+        writeNewline(w);
+        writeString(w, AS_STRING(e->key)->data, AS_STRING(e->key)->length);
+        jsrBufferAppend(&w->buf, ": ", w->indent < 0 ? 1 : 2);
+        if(!writeValue(w, e->val)) return false;
+    }
+    w->depth--;
+
+    writeNewline(w);
+    jsrBufferAppendChar(&w->buf, '}');
+    return true;
+}
+
+static bool writeValue(JSONWriter* w, Value val) {
+    if(IS_NULL(val)) {
+        jsrBufferAppend(&w->buf, "null", 4);
+        return true;
+    }
+    if(IS_BOOL(val)) {
+        if(AS_BOOL(val)) {
+            jsrBufferAppend(&w->buf, "true", 4);
+        } else {
+            jsrBufferAppend(&w->buf, "false", 5);
+        }
+        return true;
+    }
+    if(IS_NUM(val)) {
+        return writeNumber(w, AS_NUM(val));
+    }
+    if(IS_STRING(val)) {
+        writeString(w, AS_STRING(val)->data, AS_STRING(val)->length);
+        return true;
+    }
+
+    if(w->depth >= MAX_DEPTH) {
+        JSR_RAISE(w->vm, "JSONException", "Maximum nesting depth exceeded, the value may be cyclic");
+    }
+
+    if(IS_LIST(val) || IS_TUPLE(val)) {
+        size_t count;
+        Value* items = getValues(AS_OBJ(val), &count);
+        return writeArray(w, items, count);
+    }
+    if(IS_TABLE(val)) {
+        return writeObject(w, AS_TABLE(val));
+    }
+
+    JSR_RAISE(w->vm, "TypeException", "Object of type %s cannot be serialized to JSON",
+              getClass(w->vm, val)->name->data);
+}
+
+JSR_NATIVE(jsr_json_dump) {
+    JSONWriter w = {.vm = vm, .indent = -1};
+    if(!jsrIsNull(vm, 2)) {
+        JSR_CHECK(Int, 2, "indent");
+        double indent = jsrGetNumber(vm, 2);
+        if(indent < 0 || indent > 64) JSR_RAISE(vm, "InvalidArgException", "indent must be in [0, 64]");
+        w.indent = (int)indent;
+    }
+
+    jsrBufferInit(vm, &w.buf);
+    if(!writeValue(&w, vm->apiStack[1])) {
+        jsrBufferFree(&w.buf);
+        return false;
+    }
+
+    jsrBufferPush(&w.buf);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// STREAMING DECODER
+// -----------------------------------------------------------------------------
+
+#define NO_VALUE SIZE_MAX
+
+// Progress through the top-level array of a Decoder created with `unwrapArray`
+typedef enum ArrayState {
+    ARRAY_OPEN,   // Expecting the opening '['
+    ARRAY_FIRST,  // Expecting the first element or ']'
+    ARRAY_NEXT,   // Expecting ',' or ']' after an element
+    ARRAY_ELEM,   // Expecting an element after ','
+    ARRAY_DONE,   // The array has been closed
+} ArrayState;
+
+// Input fed to a Decoder, along with the state of the scan that finds where top-level values end.
+// Only complete values are handed to the parser, so that every byte is parsed once
+typedef struct DecoderState {
+    char* data;         // Bytes fed but not yet consumed
+    size_t size, capacity;
+    size_t scan;        // How far `data` has been scanned
+    size_t valueStart;  // Start of the value being scanned, or NO_VALUE
+    int depth;          // Nesting depth of the value being scanned, 0 for strings and scalars
+    bool inString, escape;
+    bool unwrapArray;
+    ArrayState arrayState;
+} DecoderState;
+
+static void freeDecoderState(void* udata) {
+    DecoderState* st = udata;
+    free(st->data);
+}
+
+static DecoderState* getDecoderState(JStarVM* vm) {
+    if(!jsrGetField(vm, 0, M_DECODER_STATE)) return NULL;
+    if(!jsrCheckUserdata(vm, -1, M_DECODER_STATE)) return NULL;
+    DecoderState* st = jsrGetUserdata(vm, -1);
+    jsrPop(vm);
+    return st;
+}
+
+// Parses the value ending at `end` and appends it to the list at `listSlot`
+static bool completeValue(JStarVM* vm, DecoderState* st, size_t end, int listSlot) {
+    if(!parseDocument(vm, st->data + st->valueStart, end - st->valueStart)) return false;
+    jsrListAppend(vm, listSlot);
+    jsrPop(vm);
+
+    st->valueStart = NO_VALUE;
+    if(st->unwrapArray) st->arrayState = ARRAY_NEXT;
+    return true;
+}
+
+typedef enum ScanResult {
+    SCAN_SKIP,   // The byte was consumed
+    SCAN_VALUE,  // A value starts at the byte
+    SCAN_ERROR,
+} ScanResult;
+
+// Handles a byte between top-level values
+static ScanResult scanBetweenValues(JStarVM* vm, DecoderState* st) {
+    char c = st->data[st->scan];
+    if(isSpace(c)) {
+        st->scan++;
+        return SCAN_SKIP;
+    }
+
+    if(st->unwrapArray) {
+        switch(st->arrayState) {
+        case ARRAY_OPEN:
+            if(c != '[') {
+                jsrRaise(vm, "JSONException", "Expected '[' at the start of the stream");
+                return SCAN_ERROR;
+            }
+            st->arrayState = ARRAY_FIRST;
+            st->scan++;
+            return SCAN_SKIP;
+        case ARRAY_FIRST:
+            if(c != ']') break;
+            st->arrayState = ARRAY_DONE;
+            st->scan++;
+            return SCAN_SKIP;
+        case ARRAY_NEXT:
+            if(c != ',' && c != ']') {
+                jsrRaise(vm, "JSONException", "Expected ',' or ']' after an array element");
+                return SCAN_ERROR;
+            }
+            st->arrayState = c == ',' ? ARRAY_ELEM : ARRAY_DONE;
+            st->scan++;
+            return SCAN_SKIP;
+        case ARRAY_ELEM:
+            break;
+        case ARRAY_DONE:
+            jsrRaise(vm, "JSONException", "Unexpected data after the end of the array");
+            return SCAN_ERROR;
+        }
+    }
+
+    if(c == ',' || c == ':' || c == ']' || c == '}') {
+        jsrRaise(vm, "JSONException", "Unexpected character '%c'", c);
+        return SCAN_ERROR;
+    }
+
+    return SCAN_VALUE;
+}
+
+// Scans the data fed so far, parsing every complete top-level value into the list at `listSlot`.
+// If `final` is true there is no more input, so a trailing scalar is complete
+static bool decode(JStarVM* vm, DecoderState* st, int listSlot, bool final) {
+    while(st->scan < st->size) {
+        char* data = st->data;
+        size_t avail = st->size - st->scan;
+
+        if(st->valueStart == NO_VALUE) {
+            ScanResult res = scanBetweenValues(vm, st);
+            if(res == SCAN_ERROR) return false;
+            if(res == SCAN_SKIP) continue;
+
+            st->valueStart = st->scan;
+            st->depth = 0;
+            if(data[st->scan] == '{' || data[st->scan] == '[') {
+                st->depth = 1;
+                st->scan++;
+            } else if(data[st->scan] == '"') {
+                st->inString = true;
+                st->scan++;
+            }
+        } else if(st->inString) {
+            if(st->escape) {
+                st->escape = false;
+                st->scan++;
+                continue;
+            }
+
+            st->scan += strSpanNotIn(data + st->scan, avail, "\"\\", 2);
+            if(st->scan == st->size) break;
+
+            if(data[st->scan++] == '\\') {
+                st->escape = true;
+            } else {
+                st->inString = false;
+                if(st->depth == 0 && !completeValue(vm, st, st->scan, listSlot)) return false;
+            }
+        } else if(st->depth == 0) {
+            // Scalars end at the first whitespace or structural character
+            st->scan += strSpanNotIn(data + st->scan, avail, " \t\r\n,:[]{}\"", 11);
+            if(st->scan == st->size) break;
+            if(!completeValue(vm, st, st->scan, listSlot)) return false;
+        } else {
+            st->scan += strSpanNotIn(data + st->scan, avail, "{}[]\"", 5);
+            if(st->scan == st->size) break;
+
+            switch(data[st->scan++]) {
+            case '{':
+            case '[':
+                st->depth++;
+                break;
+            case '}':
+            case ']':
+                if(--st->depth == 0 && !completeValue(vm, st, st->scan, listSlot)) return false;
+                break;
+            case '"':
+                st->inString = true;
+                break;
+            }
+        }
+    }
+
+    if(final && st->valueStart != NO_VALUE) {
+        if(st->inString || st->depth > 0) JSR_RAISE(vm, "JSONException", "Unexpected end of input");
+        if(!completeValue(vm, st, st->size, listSlot)) return false;
+    }
+    if(final && st->unwrapArray && st->arrayState != ARRAY_DONE) {
+        JSR_RAISE(vm, "JSONException", "Unterminated array at the end of the stream");
+    }
+
+    // Drop the consumed bytes
+    size_t consumed = st->valueStart != NO_VALUE ? st->valueStart : st->scan;
+    memmove(st->data, st->data + consumed, st->size - consumed);
+    st->size -= consumed;
+    st->scan -= consumed;
+    if(st->valueStart != NO_VALUE) st->valueStart -= consumed;
+
+    return true;
+}
+
+// class Decoder
+JSR_NATIVE(jsr_Decoder_construct) {
+    JSR_CHECK(Boolean, 1, "unwrapArray");
+
+    DecoderState* st = jsrPushUserdata(vm, sizeof(*st), &freeDecoderState);
+    *st = (DecoderState){0};
+    st->valueStart = NO_VALUE;
+    st->unwrapArray = jsrGetBoolean(vm, 1);
+    st->arrayState = ARRAY_OPEN;
+    jsrSetField(vm, 0, M_DECODER_STATE);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 0);
+    return true;
+}
+
+JSR_NATIVE(jsr_Decoder_feed) {
+    DecoderState* st = getDecoderState(vm);
+    if(!st) return false;
+
+    const char* chunk;
+    size_t length;
+    if(!getBytes(vm, 1, "chunk", &chunk, &length)) return false;
+
+    if(st->size + length > st->capacity) {
+        size_t newCap = st->capacity ? st->capacity : 4096;
+        while(newCap < st->size + length) newCap *= 2;
+
+        char* newData = realloc(st->data, newCap);
+        if(!newData) JSR_RAISE(vm, "JSONException", "Out of memory");
+
+        st->data = newData;
+        st->capacity = newCap;
+    }
+
+    if(length) memcpy(st->data + st->size, chunk, length);
+    st->size += length;
+
+    jsrPushList(vm);
+    return decode(vm, st, 2, false);
+}
+
+JSR_NATIVE(jsr_Decoder_close) {
+    DecoderState* st = getDecoderState(vm);
+    if(!st) return false;
+
+    jsrPushList(vm);
+    return decode(vm, st, 1, true);
+}
+// end
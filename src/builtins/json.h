@@ -0,0 +1,15 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "jstar.h"
+
+JSR_NATIVE(jsr_json_parse);
+JSR_NATIVE(jsr_json_dump);
+
+// class Decoder
+JSR_NATIVE(jsr_Decoder_construct);
+JSR_NATIVE(jsr_Decoder_feed);
+JSR_NATIVE(jsr_Decoder_close);
+// end
+
+#endif
@@ -7,65 +7,210 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "object.h"
+#include "string_util.h"
 #include "value.h"
 #include "vm.h"
 
-#define ESCAPE             '%'
-#define MAX_CAPTURES       31
-#define MAX_ERROR          256
-#define CAPTURE_UNFINISHED -1
-#define CAPTURE_POSITION   -2
+#define ESCAPE           '%'
+#define MAX_CAPTURES     31
+#define MAX_ERROR        256
+#define CACHE_SIZE       32
+#define CAPTURE_POSITION -1
+#define BACKTRACK_BUDGET 4
+#define MAX_LITERAL      32
+#define MAX_SCAN_BYTES   8
+
+#define M_REGEX_PROGRAM "_program"
+#define M_REGEX_PATTERN "pattern"
+#define M_REGEX_CACHE   "_cache"
 
 typedef struct {
     const char* start;
     ptrdiff_t length;
 } StringSlice;
 
-typedef struct RegexState {
-    const char *string, *end;
+// -----------------------------------------------------------------------------
+// COMPILED REGEX
+// -----------------------------------------------------------------------------
+
+// A set of bytes represented as a 256-bit bitmap
+typedef struct CharSet {
+    uint32_t bits[8];
+} CharSet;
+
+typedef enum RegexOp {
+    OP_SET,       // Matches a byte contained in `set`, repeated as specified by `rep`
+    OP_BACKREF,   // Matches the same text matched by a previous capture
+    OP_OPEN,      // Starts a capture
+    OP_CLOSE,     // Ends a capture
+    OP_POSITION,  // Captures the current position
+    OP_END,       // Matches only at the end of the string
+    OP_MATCH,     // Successful end of the program
+} RegexOp;
+
+typedef enum RegexRep {
+    REP_ONE,       // Exactly one byte
+    REP_OPTIONAL,  // `?`, zero or one bytes
+    REP_STAR,      // `*`, the longest sequence of zero or more bytes
+    REP_PLUS,      // `+`, the longest sequence of one or more bytes
+    REP_LAZY,      // `-`, the shortest sequence of zero or more bytes
+} RegexRep;
+
+typedef struct RegexNode {
+    uint8_t op, rep;
+    uint8_t capture;  // The capture index of OP_BACKREF, OP_OPEN, OP_CLOSE and OP_POSITION
+    CharSet set;
+} RegexNode;
+
+// Instructions of the linear engine, a Pike VM simulating the NFA of the pattern
+typedef enum PikeOp {
+    PIKE_CHAR,   // Consumes a byte contained in the set of node `x`
+    PIKE_SPLIT,  // Continues both at `x` and `y`, `x` having the higher priority
+    PIKE_JMP,    // Continues at `x`
+    PIKE_SAVE,   // Saves the current position in capture slot `x`
+    PIKE_END,    // Matches only at the end of the string
+    PIKE_MATCH,  // Successful end of the program
+} PikeOp;
+
+typedef struct PikeInst {
+    uint8_t op;
+    int x, y;
+} PikeInst;
+
+typedef enum RegexEngine {
+    ENGINE_AUTO,       // Backtracking with a bounded number of steps, then the linear engine
+    ENGINE_BACKTRACK,  // Recursive backtracking over the nodes, needed for back-references
+    ENGINE_LINEAR,     // Pike VM, O(n * m) in the length of the string and of the pattern
+} RegexEngine;
+
+// How to find the positions of a string where a match can start
+typedef enum ScanKind {
+    SCAN_NONE,    // A match can start anywhere
+    SCAN_PREFIX,  // A match must start with `prefix`
+    SCAN_BYTES,   // A match must start with one of `firstBytes`
+    SCAN_RANGE,   // A match must start with a byte in [firstLow, firstHigh]
+    SCAN_SET,     // A match must start with a byte in `first`
+} ScanKind;
+
+// A regex compiled to a sequence of nodes, with character classes and quantifiers already
+// resolved. Patterns that can run on the linear engine are also compiled to Pike VM instructions.
+// It is stored in a Userdata together with a copy of the pattern it was compiled from.
+typedef struct Regex {
+    uint32_t hash;        // The hash of the pattern
+    bool anchored;        // Whether the pattern starts with `^`
+    uint8_t engine;       // The RegexEngine used to match the pattern
+    int captureCount;     // Number of captures, including the whole match at index 0
+    uint32_t positions;   // Bitmask of the position captures
+    size_t patternLength;
+    const char* pattern;
+    size_t instCount;
+    PikeInst* insts;
+    uint8_t scan;          // The ScanKind used to skip to the next candidate match
+    CharSet first;         // Bytes that can start a match
+    uint8_t firstLow, firstHigh;
+    size_t firstCount;
+    char firstBytes[MAX_SCAN_BYTES];
+    size_t prefixLength;   // Literal that every match starts with
+    char prefix[MAX_LITERAL];
+    size_t literalLength;  // Literal that every match contains, if different from the prefix
+    char literal[MAX_LITERAL];
+    size_t nodeCount;
+    RegexNode nodes[];
+} Regex;
+
+static void addToSet(CharSet* set, unsigned char c) {
+    set->bits[c >> 5] |= 1u << (c & 31);
+}
+
+static bool inSet(const CharSet* set, unsigned char c) {
+    return set->bits[c >> 5] & (1u << (c & 31));
+}
+
+// Returns the number of bytes in `set`
+static size_t setSize(const CharSet* set) {
+    size_t size = 0;
+    for(int c = 0; c <= UINT8_MAX; c++) {
+        if(inSet(set, c)) size++;
+    }
+    return size;
+}
+
+static bool isZeroWidth(const RegexNode* node) {
+    return node->op == OP_OPEN || node->op == OP_CLOSE || node->op == OP_POSITION;
+}
+
+static bool isLiteral(const RegexNode* node) {
+    return node->op == OP_SET && setSize(&node->set) == 1;
+}
+
+static char literalByte(const RegexNode* node) {
+    int c = 0;
+    while(!inSet(&node->set, c)) {
+        c++;
+    }
+    return (char)c;
+}
+
+// -----------------------------------------------------------------------------
+// REGEX COMPILER
+// -----------------------------------------------------------------------------
+
+typedef enum CaptureState {
+    CAPTURE_OPEN,
+    CAPTURE_CLOSED,
+    CAPTURE_POS,
+} CaptureState;
+
+typedef struct RegexCompiler {
+    const char *ptr, *end;
+    RegexNode* nodes;  // Where to emit the nodes, NULL when only counting them
+    RegexNode scratch;
+    size_t nodeCount;
+    int captureCount;
+    uint8_t captures[MAX_CAPTURES];
+    bool hasBackReferences;
     bool error;
     char errorMessage[MAX_ERROR];
-    int captureCount;
-    StringSlice captures[MAX_CAPTURES];
-} RegexState;
-
-static void initState(RegexState* rs, const char* string, size_t length) {
-    rs->string = string;
-    rs->end = string + length;
-    rs->error = false;
-    rs->captureCount = 1;
-    rs->captures[0].start = string;
-    rs->captures[0].length = CAPTURE_UNFINISHED;
+} RegexCompiler;
+
+static void initCompiler(RegexCompiler* c, const char* pattern, size_t length, RegexNode* nodes) {
+    c->ptr = pattern;
+    c->end = pattern + length;
+    c->nodes = nodes;
+    c->nodeCount = 0;
+    c->captureCount = 1;
+    c->hasBackReferences = false;
+    c->error = false;
 }
 
-static void setError(RegexState* rs, const char* fmt, ...) {
-    if(rs->error) return;
-    rs->error = true;
+static void compileError(RegexCompiler* c, const char* fmt, ...) {
+    if(c->error) return;
+    c->error = true;
     va_list args;
     va_start(args, fmt);
-    int written = vsnprintf(rs->errorMessage, MAX_ERROR, fmt, args);
+    int written = vsnprintf(c->errorMessage, MAX_ERROR, fmt, args);
     va_end(args);
     JSR_ASSERT(written < MAX_ERROR, "Error message was truncated");
 }
 
-// -----------------------------------------------------------------------------
-// MATCHING ENGINE
-// -----------------------------------------------------------------------------
-
-static const char* match(RegexState* rs, const char* str, const char* regex);
-
-static bool isAtEnd(const char* ptr) {
-    return *ptr == '\0';
+static RegexNode* emit(RegexCompiler* c, RegexOp op, int capture) {
+    RegexNode* node = c->nodes ? &c->nodes[c->nodeCount] : &c->scratch;
+    c->nodeCount++;
+    node->op = op;
+    node->rep = REP_ONE;
+    node->capture = capture;
+    return node;
 }
 
-static bool matchClass(char c, char cls) {
+static bool matchClass(unsigned char c, char cls) {
     bool res;
-    switch(tolower(cls)) {
+    switch(tolower((unsigned char)cls)) {
     case 'a':
         res = isalpha(c);
         break;
@@ -94,12 +239,12 @@ static bool matchClass(char c, char cls) {
         res = isxdigit(c);
         break;
     default:
-        return c == cls;
+        return c == (unsigned char)cls;
     }
-    return isupper(cls) ? !res : res;
+    return isupper((unsigned char)cls) ? !res : res;
 }
 
-static bool matchCustomClass(char c, const char* regexPtr, const char* classEnd) {
+static bool matchCustomClass(unsigned char c, const char* regexPtr, const char* classEnd) {
     bool ret = true;
     if(regexPtr[1] == '^') {
         ret = false;
@@ -114,10 +259,10 @@ static bool matchCustomClass(char c, const char* regexPtr, const char* classEnd)
             }
         } else if(regexPtr[1] == '-' && regexPtr + 2 < classEnd) {
             regexPtr += 2;
-            if(regexPtr[-2] <= c && c <= *regexPtr) {
+            if((unsigned char)regexPtr[-2] <= c && c <= (unsigned char)*regexPtr) {
                 return ret;
             }
-        } else if(*regexPtr == c) {
+        } else if((unsigned char)*regexPtr == c) {
             return ret;
         }
     }
@@ -125,7 +270,7 @@ static bool matchCustomClass(char c, const char* regexPtr, const char* classEnd)
     return !ret;
 }
 
-static bool matchClassOrChar(char c, const char* regex, const char* classEnd) {
+static bool matchClassOrChar(unsigned char c, const char* regex, const char* classEnd) {
     switch(*regex) {
     case '.':
         return true;
@@ -134,251 +279,797 @@ static bool matchClassOrChar(char c, const char* regex, const char* classEnd) {
     case '[':
         return matchCustomClass(c, regex, classEnd - 1);
     default:
-        return c == *regex;
+        return c == (unsigned char)*regex;
+    }
+}
+
+static const char* findClassEnd(RegexCompiler* c, const char* regexPtr) {
+    switch(*regexPtr++) {
+    case ESCAPE:
+        if(regexPtr == c->end) {
+            compileError(c, "Malformed regex, unmatched `%c`", ESCAPE);
+            return NULL;
+        }
+        return regexPtr + 1;
+    case '[':
+        do {
+            if(regexPtr == c->end) {
+                compileError(c, "Malformed regex, unmatched `[`");
+                return NULL;
+            }
+            if(*regexPtr++ == ESCAPE && regexPtr != c->end) {
+                regexPtr++;
+            }
+        } while(regexPtr == c->end || *regexPtr != ']');
+
+        return regexPtr + 1;
+    default:
+        return regexPtr;
     }
 }
 
-static int finishCaptures(RegexState* rs) {
-    for(int i = rs->captureCount - 1; i > 0; i--) {
-        if(rs->captures[i].length == CAPTURE_UNFINISHED) return i;
+// Compiles a single character, class or set, together with its optional quantifier
+static bool compileItem(RegexCompiler* c) {
+    const char* classEnd = findClassEnd(c, c->ptr);
+    if(classEnd == NULL) return false;
+
+    RegexNode* node = emit(c, OP_SET, 0);
+    if(c->nodes) {
+        memset(&node->set, 0, sizeof(node->set));
+        for(int ch = 0; ch <= UINT8_MAX; ch++) {
+            if(matchClassOrChar(ch, c->ptr, classEnd)) addToSet(&node->set, ch);
+        }
+    }
+
+    if(classEnd < c->end) {
+        switch(*classEnd) {
+        case '?':
+            node->rep = REP_OPTIONAL;
+            classEnd++;
+            break;
+        case '+':
+            node->rep = REP_PLUS;
+            classEnd++;
+            break;
+        case '*':
+            node->rep = REP_STAR;
+            classEnd++;
+            break;
+        case '-':
+            node->rep = REP_LAZY;
+            classEnd++;
+            break;
+        default:
+            break;
+        }
     }
-    setError(rs, "Invalid regex capture");
-    return -1;
+
+    c->ptr = classEnd;
+    return true;
 }
 
-static const char* startCapture(RegexState* rs, const char* stringPtr, const char* regexPtr) {
-    if(rs->captureCount >= MAX_CAPTURES) {
-        setError(rs, "Max capture number exceeded: %d", MAX_CAPTURES);
-        return NULL;
+static bool startCapture(RegexCompiler* c) {
+    if(c->captureCount >= MAX_CAPTURES) {
+        compileError(c, "Max capture number exceeded: %d", MAX_CAPTURES);
+        return false;
     }
 
-    if(regexPtr[1] != ')') {
-        rs->captures[rs->captureCount].length = CAPTURE_UNFINISHED;
+    int capture = c->captureCount++;
+    if(c->ptr + 1 < c->end && c->ptr[1] == ')') {
+        c->captures[capture] = CAPTURE_POS;
+        emit(c, OP_POSITION, capture);
+        c->ptr += 2;
     } else {
-        rs->captures[rs->captureCount].length = CAPTURE_POSITION;
-        regexPtr++;
+        c->captures[capture] = CAPTURE_OPEN;
+        emit(c, OP_OPEN, capture);
+        c->ptr++;
     }
 
-    rs->captures[rs->captureCount++].start = stringPtr;
-    const char* res = match(rs, stringPtr, regexPtr + 1);
-    if(res == NULL) {
-        rs->captureCount--;
+    return true;
+}
+
+static bool endCapture(RegexCompiler* c) {
+    for(int i = c->captureCount - 1; i > 0; i--) {
+        if(c->captures[i] == CAPTURE_OPEN) {
+            c->captures[i] = CAPTURE_CLOSED;
+            emit(c, OP_CLOSE, i);
+            c->ptr++;
+            return true;
+        }
     }
 
-    return res;
+    compileError(c, "Invalid regex capture");
+    return false;
 }
 
-static const char* endCapture(RegexState* rs, const char* stringPtr, const char* regexPtr) {
-    int i = finishCaptures(rs);
-    if(i == -1) return NULL;
+static bool compileBackReference(RegexCompiler* c) {
+    int capture = 0;
+    while(++c->ptr < c->end && isdigit((unsigned char)*c->ptr)) {
+        if(capture <= MAX_CAPTURES) capture = capture * 10 + (*c->ptr - '0');
+    }
 
-    rs->captures[i].length = stringPtr - rs->captures[i].start;
-    const char* res = match(rs, stringPtr, regexPtr + 1);
-    if(res == NULL) {
-        rs->captures[i].length = CAPTURE_UNFINISHED;
+    if(capture == 0 || capture >= c->captureCount || c->captures[capture] != CAPTURE_CLOSED) {
+        compileError(c, "Invalid capture index %%%d", capture);
+        return false;
     }
 
-    return res;
+    emit(c, OP_BACKREF, capture);
+    c->hasBackReferences = true;
+    return true;
 }
 
-static const char* matchCapture(RegexState* rs, const char* stringPtr, int captureIdx) {
-    if(captureIdx > rs->captureCount - 1 || rs->captures[captureIdx].length == CAPTURE_UNFINISHED ||
-       rs->captures[captureIdx].length == CAPTURE_POSITION) {
-        setError(rs, "Invalid capture index %%%d", captureIdx);
-        return NULL;
+static bool compilePattern(RegexCompiler* c) {
+    while(c->ptr < c->end) {
+        bool ok;
+        switch(*c->ptr) {
+        case '(':
+            ok = startCapture(c);
+            break;
+        case ')':
+            ok = endCapture(c);
+            break;
+        case '$':
+            // Treat `$` specially only if at pattern end
+            if(c->ptr + 1 == c->end) {
+                emit(c, OP_END, 0);
+                c->ptr++;
+                ok = true;
+            } else {
+                ok = compileItem(c);
+            }
+            break;
+        case ESCAPE:
+            // If there are digits after a `%`, then it's a capture reference
+            if(c->ptr + 1 < c->end && isdigit((unsigned char)c->ptr[1])) {
+                ok = compileBackReference(c);
+            } else {
+                ok = compileItem(c);
+            }
+            break;
+        default:
+            ok = compileItem(c);
+            break;
+        }
+
+        if(!ok) return false;
     }
 
-    const char* capture = rs->captures[captureIdx].start;
-    size_t captureLen = rs->captures[captureIdx].length;
-    if((size_t)(rs->end - stringPtr) < captureLen || memcmp(stringPtr, capture, captureLen) != 0) {
-        return NULL;
+    for(int i = 1; i < c->captureCount; i++) {
+        if(c->captures[i] == CAPTURE_OPEN) {
+            compileError(c, "Malformed regex, unmatched `(`");
+            return false;
+        }
     }
 
-    return stringPtr + captureLen;
+    emit(c, OP_MATCH, 0);
+    return true;
 }
 
-static const char* greedyMatch(RegexState* rs, const char* stringPtr, const char* regexPtr,
-                               const char* clsEnd) {
-    ptrdiff_t i = 0;
-    while(!isAtEnd(&stringPtr[i]) && matchClassOrChar(stringPtr[i], regexPtr, clsEnd)) {
-        i++;
+static size_t emitInst(PikeInst* insts, size_t pc, PikeOp op, int x, int y) {
+    if(insts) insts[pc] = (PikeInst){op, x, y};
+    return pc + 1;
+}
+
+// Compiles the nodes of `re` to Pike VM instructions, returning their number.
+// When `insts` is NULL the instructions are only counted
+static size_t compileLinear(const Regex* re, PikeInst* insts) {
+    size_t pc = 0;
+    for(size_t i = 0; i < re->nodeCount; i++) {
+        const RegexNode* node = &re->nodes[i];
+        switch((RegexOp)node->op) {
+        case OP_SET:
+            switch((RegexRep)node->rep) {
+            case REP_ONE:
+                pc = emitInst(insts, pc, PIKE_CHAR, i, 0);
+                break;
+            case REP_OPTIONAL:
+                pc = emitInst(insts, pc, PIKE_SPLIT, pc + 1, pc + 2);
+                pc = emitInst(insts, pc, PIKE_CHAR, i, 0);
+                break;
+            case REP_STAR:
+                pc = emitInst(insts, pc, PIKE_SPLIT, pc + 1, pc + 3);
+                pc = emitInst(insts, pc, PIKE_CHAR, i, 0);
+                pc = emitInst(insts, pc, PIKE_JMP, pc - 2, 0);
+                break;
+            case REP_PLUS:
+                pc = emitInst(insts, pc, PIKE_CHAR, i, 0);
+                pc = emitInst(insts, pc, PIKE_SPLIT, pc - 1, pc + 1);
+                break;
+            case REP_LAZY:
+                pc = emitInst(insts, pc, PIKE_SPLIT, pc + 3, pc + 1);
+                pc = emitInst(insts, pc, PIKE_CHAR, i, 0);
+                pc = emitInst(insts, pc, PIKE_JMP, pc - 2, 0);
+                break;
+            }
+            break;
+        case OP_OPEN:
+        case OP_POSITION:
+            pc = emitInst(insts, pc, PIKE_SAVE, 2 * node->capture, 0);
+            break;
+        case OP_CLOSE:
+            pc = emitInst(insts, pc, PIKE_SAVE, 2 * node->capture + 1, 0);
+            break;
+        case OP_END:
+            pc = emitInst(insts, pc, PIKE_END, 0, 0);
+            break;
+        case OP_MATCH:
+            pc = emitInst(insts, pc, PIKE_MATCH, 0, 0);
+            break;
+        case OP_BACKREF:
+            JSR_UNREACHABLE();
+        }
     }
+    return pc;
+}
 
-    while(i >= 0) {
-        const char* res = match(rs, stringPtr + i, clsEnd + 1);
-        if(res != NULL) {
-            return res;
+// Finds the bytes that can start a match, and returns how to scan for them
+static ScanKind analyzeFirstBytes(Regex* re) {
+    memset(&re->first, 0, sizeof(re->first));
+
+    for(size_t i = 0; i < re->nodeCount; i++) {
+        const RegexNode* node = &re->nodes[i];
+        if(isZeroWidth(node)) continue;
+
+        // Back-references and `$` could match the empty string, and so could the whole pattern
+        if(node->op != OP_SET) return SCAN_NONE;
+
+        for(int w = 0; w < 8; w++) {
+            re->first.bits[w] |= node->set.bits[w];
         }
-        if(rs->error) {
-            return NULL;
+
+        if(node->rep == REP_ONE || node->rep == REP_PLUS) break;
+    }
+
+    size_t size = setSize(&re->first);
+    if(size == UINT8_MAX + 1) return SCAN_NONE;
+
+    int low = 0, high = UINT8_MAX;
+    while(!inSet(&re->first, low)) low++;
+    while(!inSet(&re->first, high)) high--;
+
+    re->firstLow = low;
+    re->firstHigh = high;
+    if((size_t)(high - low + 1) == size) return SCAN_RANGE;
+
+    if(size <= MAX_SCAN_BYTES) {
+        re->firstCount = 0;
+        for(int c = low; c <= high; c++) {
+            if(inSet(&re->first, c)) re->firstBytes[re->firstCount++] = (char)c;
         }
-        i--;
+        return SCAN_BYTES;
     }
 
-    return NULL;
+    return SCAN_SET;
 }
 
-static const char* lazyMatch(RegexState* rs, const char* stringPtr, const char* regexPtr,
-                             const char* clsEnd) {
-    do {
-        const char* res = match(rs, stringPtr, clsEnd + 1);
-        if(res != NULL) {
-            return res;
+// Extracts the literal prefix and the longest literal required by every match of `re`, that are
+// used to quickly discard the strings and positions that cannot match
+static void analyzeRegex(Regex* re) {
+    re->prefixLength = 0;
+    for(size_t i = 0; i < re->nodeCount && re->prefixLength < MAX_LITERAL; i++) {
+        const RegexNode* node = &re->nodes[i];
+        if(isZeroWidth(node)) continue;
+        if(!isLiteral(node) || node->rep != REP_ONE) break;
+        re->prefix[re->prefixLength++] = literalByte(node);
+    }
+
+    re->literalLength = 0;
+    char run[MAX_LITERAL];
+    size_t runLength = 0;
+
+    for(size_t i = 0; i < re->nodeCount; i++) {
+        const RegexNode* node = &re->nodes[i];
+        if(isZeroWidth(node)) continue;
+
+        // A single byte repeated with `+` must appear at least once, but ends the literal
+        bool required = isLiteral(node) && (node->rep == REP_ONE || node->rep == REP_PLUS);
+        if(required && runLength < MAX_LITERAL) {
+            run[runLength++] = literalByte(node);
         }
-        if(rs->error) {
-            return NULL;
+
+        if(!required || node->rep != REP_ONE) {
+            if(runLength > re->literalLength) {
+                memcpy(re->literal, run, runLength);
+                re->literalLength = runLength;
+            }
+            runLength = 0;
         }
-    } while(!isAtEnd(stringPtr) && matchClassOrChar(*stringPtr++, regexPtr, clsEnd));
+    }
+
+    // The prefix is already looked for when scanning for candidate positions
+    if(re->literalLength <= re->prefixLength) {
+        re->literalLength = 0;
+    }
 
-    return NULL;
+    re->scan = re->prefixLength > 0 ? SCAN_PREFIX : analyzeFirstBytes(re);
 }
 
-static const char* findClassEnd(RegexState* rs, const char* regexPtr) {
-    switch(*regexPtr++) {
-    case ESCAPE:
-        if(isAtEnd(regexPtr)) {
-            setError(rs, "Malformed regex, unmatched `%c`", ESCAPE);
-            return NULL;
+// Compiles `pattern` and pushes the resulting program on the stack as a Userdata.
+// Returns NULL, leaving a RegexException on the stack, if the pattern is malformed or cannot be
+// run by the requested engine
+static Regex* compileRegex(JStarVM* vm, const char* pattern, size_t length, uint32_t hash,
+                           RegexEngine engine) {
+    bool anchored = length > 0 && pattern[0] == '^';
+    if(anchored) {
+        pattern++;
+        length--;
+    }
+
+    // First pass: validate the pattern and count its nodes
+    RegexCompiler c;
+    initCompiler(&c, pattern, length, NULL);
+    if(!compilePattern(&c)) {
+        jsrRaise(vm, "RegexException", "%s", c.errorMessage);
+        return NULL;
+    }
+
+    if(engine == ENGINE_LINEAR && c.hasBackReferences) {
+        jsrRaise(vm, "RegexException", "Back-references are not supported by the linear engine");
+        return NULL;
+    }
+
+    if(c.hasBackReferences) engine = ENGINE_BACKTRACK;
+
+    bool linear = engine != ENGINE_BACKTRACK;
+    size_t nodeCount = c.nodeCount;
+
+    // The instructions of the linear engine are at most 3 per node
+    size_t nodesSize = sizeof(RegexNode) * nodeCount;
+    size_t instsSize = linear ? sizeof(PikeInst) * 3 * nodeCount : 0;
+    size_t size = sizeof(Regex) + nodesSize + instsSize + length + anchored + 1;
+
+    Regex* re = jsrPushUserdata(vm, size, NULL);
+    re->hash = hash;
+    re->anchored = anchored;
+    re->engine = engine;
+    re->captureCount = c.captureCount;
+    re->nodeCount = nodeCount;
+
+    // Second pass: emit the nodes. Cannot fail, since the pattern has already been validated
+    initCompiler(&c, pattern, length, re->nodes);
+    compilePattern(&c);
+
+    re->positions = 0;
+    for(int i = 1; i < c.captureCount; i++) {
+        if(c.captures[i] == CAPTURE_POS) re->positions |= 1u << i;
+    }
+
+    re->insts = (PikeInst*)((char*)re->nodes + nodesSize);
+    re->instCount = linear ? compileLinear(re, re->insts) : 0;
+    analyzeRegex(re);
+
+    char* source = (char*)re->insts + instsSize;
+    memcpy(source, pattern - anchored, length + anchored);
+    source[length + anchored] = '\0';
+    re->pattern = source;
+    re->patternLength = length + anchored;
+
+    return re;
+}
+
+// -----------------------------------------------------------------------------
+// PREFILTERS
+// -----------------------------------------------------------------------------
+
+// Returns the first position in [str, end] where a match of the unanchored `re` can start, or NULL
+// if there is none
+static const char* nextCandidate(const Regex* re, const char* str, const char* end) {
+    size_t len = end - str, skip = 0;
+    switch((ScanKind)re->scan) {
+    case SCAN_NONE:
+        return str;
+    case SCAN_PREFIX:
+        return strFind(str, len, re->prefix, re->prefixLength);
+    case SCAN_BYTES:
+        skip = strSpanNotIn(str, len, re->firstBytes, re->firstCount);
+        break;
+    case SCAN_RANGE:
+        skip = strSpanNotInRange(str, len, re->firstLow, re->firstHigh);
+        break;
+    case SCAN_SET:
+        while(skip < len && !inSet(&re->first, str[skip])) {
+            skip++;
         }
-        return regexPtr + 1;
-    case '[':
-        do {
-            if(isAtEnd(regexPtr)) {
-                setError(rs, "Malformed regex, unmatched `[`");
+        break;
+    }
+
+    // All the other scans look for a byte, so a match cannot start at the end of the string
+    return skip == len ? NULL : str + skip;
+}
+
+// Returns whether the string can contain a match of `re`, based on the literal it requires
+static bool containsLiteral(const Regex* re, const char* str, const char* end) {
+    return re->literalLength == 0 ||
+           strFind(str, end - str, re->literal, re->literalLength) != NULL;
+}
+
+// -----------------------------------------------------------------------------
+// BACKTRACKING ENGINE
+// -----------------------------------------------------------------------------
+
+typedef struct RegexState {
+    const char *string, *end;
+    size_t budget;  // Steps left to the backtracking engine before giving up
+    int captureCount;
+    StringSlice captures[MAX_CAPTURES];
+} RegexState;
+
+static void initState(RegexState* rs, const Regex* re, const char* string, size_t length) {
+    rs->string = string;
+    rs->end = string + length;
+    rs->captureCount = re->captureCount;
+}
+
+static const char* match(RegexState* rs, const char* str, const RegexNode* node) {
+    for(;; node++) {
+        if(rs->budget == 0) return NULL;
+        rs->budget--;
+
+        switch((RegexOp)node->op) {
+        case OP_MATCH:
+            return str;
+        case OP_OPEN:
+            rs->captures[node->capture].start = str;
+            break;
+        case OP_CLOSE: {
+            StringSlice* capture = &rs->captures[node->capture];
+            capture->length = str - capture->start;
+            break;
+        }
+        case OP_POSITION:
+            rs->captures[node->capture].start = str;
+            rs->captures[node->capture].length = CAPTURE_POSITION;
+            break;
+        case OP_BACKREF: {
+            const StringSlice* capture = &rs->captures[node->capture];
+            if(rs->end - str < capture->length ||
+               memcmp(str, capture->start, capture->length) != 0) {
                 return NULL;
             }
-            if(*regexPtr++ == ESCAPE && !isAtEnd(regexPtr)) {
-                regexPtr++;
+            str += capture->length;
+            break;
+        }
+        case OP_END:
+            if(str != rs->end) return NULL;
+            break;
+        case OP_SET:
+            switch((RegexRep)node->rep) {
+            case REP_ONE:
+                if(str == rs->end || !inSet(&node->set, *str)) return NULL;
+                str++;
+                break;
+            case REP_OPTIONAL:
+                if(str != rs->end && inSet(&node->set, *str)) {
+                    const char* res = match(rs, str + 1, node + 1);
+                    if(res != NULL) return res;
+                }
+                break;
+            case REP_STAR:
+            case REP_PLUS: {
+                const char* min = node->rep == REP_PLUS ? str + 1 : str;
+                const char* max = str;
+                while(max != rs->end && inSet(&node->set, *max)) {
+                    max++;
+                }
+
+                size_t scanned = max - str;
+                rs->budget = rs->budget > scanned ? rs->budget - scanned : 0;
+
+                if(max < min) return NULL;
+
+                // Backtrack from the longest sequence, the shortest one is tried by the loop
+                for(; max > min; max--) {
+                    const char* res = match(rs, max, node + 1);
+                    if(res != NULL) return res;
+                }
+                str = min;
+                break;
+            }
+            case REP_LAZY:
+                for(;;) {
+                    const char* res = match(rs, str, node + 1);
+                    if(res != NULL) return res;
+                    if(str == rs->end || !inSet(&node->set, *str)) return NULL;
+                    str++;
+                }
             }
-        } while(*regexPtr != ']');
+            break;
+        }
+    }
+}
 
-        return regexPtr + 1;
-    default:
-        return regexPtr;
+static bool backtrackMatch(RegexState* rs, const Regex* re, const char* str) {
+    do {
+        if(!re->anchored && (str = nextCandidate(re, str, rs->end)) == NULL) return false;
+
+        const char* res = match(rs, str, re->nodes);
+        if(res != NULL) {
+            rs->captures[0].start = str;
+            rs->captures[0].length = res - str;
+            return true;
+        }
+    } while(!re->anchored && rs->budget != 0 && str++ != rs->end);
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// LINEAR ENGINE
+// -----------------------------------------------------------------------------
+
+// The Pike VM advances all the threads of the NFA in lockstep, one byte of the string at a time.
+// Threads are kept in priority order, the same order in which the backtracking engine would try
+// the alternatives, and only the highest priority thread reaching an instruction is kept. This
+// gives the same matches of the backtracking engine in O(n * m) time and O(m) memory.
+
+typedef struct PikeThread {
+    size_t pc;
+    const char** slots;
+} PikeThread;
+
+typedef struct PikeList {
+    size_t count;
+    PikeThread* threads;
+} PikeList;
+
+typedef struct PikeVM {
+    const PikeInst* insts;
+    const RegexNode* nodes;
+    const char* end;
+    int slotCount;
+    unsigned generation;
+    unsigned* marks;  // The generation in which an instruction was last added to a list
+} PikeVM;
+
+#define PIKE_STACK_BUF 4096
+
+static void addThread(PikeVM* p, PikeList* l, size_t pc, const char* sp, const char** slots) {
+    if(p->marks[pc] == p->generation) return;
+    p->marks[pc] = p->generation;
+
+    const PikeInst* inst = &p->insts[pc];
+    switch((PikeOp)inst->op) {
+    case PIKE_JMP:
+        addThread(p, l, inst->x, sp, slots);
+        break;
+    case PIKE_SPLIT:
+        addThread(p, l, inst->x, sp, slots);
+        addThread(p, l, inst->y, sp, slots);
+        break;
+    case PIKE_SAVE: {
+        const char* old = slots[inst->x];
+        slots[inst->x] = sp;
+        addThread(p, l, pc + 1, sp, slots);
+        slots[inst->x] = old;
+        break;
+    }
+    case PIKE_END:
+        if(sp == p->end) addThread(p, l, pc + 1, sp, slots);
+        break;
+    case PIKE_CHAR:
+    case PIKE_MATCH: {
+        PikeThread* t = &l->threads[l->count++];
+        t->pc = pc;
+        memcpy(t->slots, slots, sizeof(*slots) * p->slotCount);
+        break;
+    }
     }
 }
 
-static const char* matchRepOperator(RegexState* rs, const char* stringPtr, const char* regexPtr) {
-    const char* classEnd = findClassEnd(rs, regexPtr);
-    if(classEnd == NULL) return NULL;
+static bool pikeMatch(JStarVM* vm, RegexState* rs, const Regex* re, const char* str) {
+    size_t n = re->instCount;
+    int slotCount = 2 * re->captureCount;
+
+    // Two thread lists with their capture slots, the scratch and matched slots, and the marks
+    size_t slotsSize = sizeof(const char*) * slotCount;
+    size_t size = 2 * n * (sizeof(PikeThread) + slotsSize) + 2 * slotsSize + sizeof(unsigned) * n;
+
+    // Avoid an allocation for the common case of small patterns
+    void* stackBuf[PIKE_STACK_BUF / sizeof(void*)];
+    char* mem = size <= sizeof(stackBuf) ? (char*)stackBuf : vm->realloc(NULL, 0, size);
+    JSR_ASSERT(mem, "Out of memory");
 
-    bool isMatch = !isAtEnd(stringPtr) && matchClassOrChar(*stringPtr, regexPtr, classEnd);
-    switch(*classEnd) {
-    case '?': {
-        const char* res;
-        if(isMatch && (res = match(rs, stringPtr + 1, classEnd + 1)) != NULL) return res;
-        return match(rs, stringPtr, classEnd + 1);
+    PikeThread* threads = (PikeThread*)mem;
+    const char** slotsMem = (const char**)(threads + 2 * n);
+    for(size_t i = 0; i < 2 * n; i++) {
+        threads[i].slots = slotsMem + i * slotCount;
     }
-    case '+':
-        return isMatch ? greedyMatch(rs, stringPtr + 1, regexPtr, classEnd) : NULL;
-    case '*':
-        return greedyMatch(rs, stringPtr, regexPtr, classEnd);
-    case '-':
-        return lazyMatch(rs, stringPtr, regexPtr, classEnd);
-    default:
-        return isMatch ? match(rs, stringPtr + 1, classEnd) : NULL;
-    }
-}
-
-static const char* match(RegexState* rs, const char* stringPtr, const char* regexPtr) {
-    switch(*regexPtr) {
-    case '\0':
-        return stringPtr;
-    case '(':
-        return startCapture(rs, stringPtr, regexPtr);
-    case ')':
-        return endCapture(rs, stringPtr, regexPtr);
-    case '$':
-        // Treat `$` specially only if at string end
-        if(isAtEnd(&regexPtr[1])) {
-            return isAtEnd(stringPtr) ? stringPtr : NULL;
+
+    const char** slots = slotsMem + 2 * n * slotCount;
+    const char** matched = slots + slotCount;
+
+    PikeVM p = {re->insts, re->nodes, rs->end, slotCount, 1, (unsigned*)(matched + slotCount)};
+    memset(p.marks, 0, sizeof(unsigned) * n);
+
+    PikeList lists[2] = {{0, threads}, {0, threads + n}};
+    PikeList *clist = &lists[0], *nlist = &lists[1];
+    bool found = false;
+
+    for(const char* sp = str;; sp++) {
+        // When no attempt is ongoing skip straight to the next position where one can start
+        if(clist->count == 0 && !found && !re->anchored) {
+            sp = nextCandidate(re, sp, rs->end);
+            if(sp == NULL) break;
         }
-        return matchRepOperator(rs, stringPtr, regexPtr);
-    case ESCAPE:
-        // If there are digits after a `%`, then it's a capture reference
-        if(isdigit(regexPtr[1])) {
-            int digitCount = 1;
-            while(isdigit(regexPtr[digitCount])) {
-                digitCount++;
+
+        // Start a new match attempt at this position, with a lower priority than the ongoing ones
+        if(!found && (sp == str || !re->anchored)) {
+            for(int i = 0; i < slotCount; i++) {
+                slots[i] = NULL;
             }
+            slots[0] = sp;
+            addThread(&p, clist, 0, sp, slots);
+        }
 
-            int capture = strtol(regexPtr + 1, NULL, 10);
-            if((stringPtr = matchCapture(rs, stringPtr, capture)) == NULL) {
-                return NULL;
+        // No thread can match anymore, and no new attempts will be started
+        if(clist->count == 0 && (found || re->anchored)) break;
+
+        p.generation++;
+        nlist->count = 0;
+
+        for(size_t i = 0; i < clist->count; i++) {
+            const PikeThread* t = &clist->threads[i];
+            const PikeInst* inst = &re->insts[t->pc];
+
+            if(inst->op == PIKE_MATCH) {
+                // Threads with a lower priority than the match can be discarded
+                memcpy(matched, t->slots, slotsSize);
+                matched[1] = sp;
+                found = true;
+                break;
             }
 
-            return match(rs, stringPtr, regexPtr + digitCount);
+            if(sp != rs->end && inSet(&re->nodes[inst->x].set, *sp)) {
+                addThread(&p, nlist, t->pc + 1, sp + 1, t->slots);
+            }
+        }
+
+        PikeList* tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+
+        if(sp == rs->end) break;
+    }
+
+    if(found) {
+        for(int i = 0; i < re->captureCount; i++) {
+            rs->captures[i].start = matched[2 * i];
+            if(re->positions & (1u << i)) {
+                rs->captures[i].length = CAPTURE_POSITION;
+            } else {
+                rs->captures[i].length = matched[2 * i + 1] - matched[2 * i];
+            }
         }
-        return matchRepOperator(rs, stringPtr, regexPtr);
-    default:
-        return matchRepOperator(rs, stringPtr, regexPtr);
     }
+
+    if(mem != (char*)stackBuf) vm->realloc(mem, size, 0);
+    return found;
 }
 
 // Entry point of the regex matching algorithm
-static bool matchRegex(RegexState* rs, const char* str, size_t len, const char* regex, int offset) {
-    initState(rs, str, len);
+static bool matchRegex(JStarVM* vm, RegexState* rs, const Regex* re, const char* str, size_t len,
+                       size_t offset) {
+    initState(rs, re, str, len);
+    if(!containsLiteral(re, str + offset, rs->end)) return false;
+
+    switch((RegexEngine)re->engine) {
+    case ENGINE_AUTO:
+        // Backtracking is faster on most patterns, but can take exponential time on some of them.
+        // Bound its steps to O(n * m), and use the linear engine if it exceeds them
+        rs->budget = BACKTRACK_BUDGET * (len - offset + 1) * re->instCount;
+        if(backtrackMatch(rs, re, str + offset)) return true;
+        return rs->budget == 0 && pikeMatch(vm, rs, re, str + offset);
+    case ENGINE_BACKTRACK:
+        rs->budget = SIZE_MAX;
+        return backtrackMatch(rs, re, str + offset);
+    case ENGINE_LINEAR:
+        return pikeMatch(vm, rs, re, str + offset);
+    }
 
-    // negative offsets start from end of string
-    if(offset < 0) {
-        offset += len;
+    JSR_UNREACHABLE();
+}
+
+// -----------------------------------------------------------------------------
+// REGEX CACHE
+// -----------------------------------------------------------------------------
+
+// Pushes on the stack the compiled program of the pattern String at `slot`. Programs are kept in
+// the module's cache, a List of at most CACHE_SIZE entries sorted from the most recently used.
+// Returns NULL, leaving an exception on the stack, if the pattern is malformed
+static Regex* pushCachedRegex(JStarVM* vm, int slot) {
+    ObjString* pattern = AS_STRING(vm->apiStack[slot]);
+    uint32_t hash = stringGetHash(vm, pattern);
+
+    if(!jsrGetGlobal(vm, NULL, M_REGEX_CACHE)) return NULL;
+    ObjList* cache = AS_LIST(peek(vm));
+
+    for(size_t i = 0; i < cache->count; i++) {
+        Regex* re = (Regex*)AS_USERDATA(cache->items[i])->data;
+        if(re->hash == hash && re->patternLength == pattern->length &&
+           memcmp(re->pattern, pattern->data, pattern->length) == 0) {
+            Value program = cache->items[i];
+            memmove(cache->items + 1, cache->items, sizeof(Value) * i);
+            cache->items[0] = program;
+
+            pop(vm);
+            push(vm, program);
+            return re;
+        }
     }
 
-    if(offset < 0 || (size_t)offset > len) {
-        setError(rs, "Invalid starting offset: %d", offset);
-        return false;
+    Regex* re = compileRegex(vm, pattern->data, pattern->length, hash, ENGINE_AUTO);
+    if(re == NULL) return NULL;
+
+    // Evict the least recently used program if the cache is full
+    if(cache->count < CACHE_SIZE) {
+        listAppend(vm, cache, NULL_VAL);
     }
 
-    str += offset;
+    Value program = pop(vm);
+    memmove(cache->items + 1, cache->items, sizeof(Value) * (cache->count - 1));
+    cache->items[0] = program;
 
-    if(*regex == '^') {
-        const char* res = match(rs, str, regex + 1);
-        if(res != NULL) {
-            rs->captures[0].length = res - str;
-            return true;
-        }
-        return false;
+    pop(vm);
+    push(vm, program);
+    return re;
+}
+
+// Pushes on the stack the compiled program of the pattern String or Regex at `slot`.
+// Returns NULL, leaving an exception on the stack, in case of errors
+static Regex* pushRegex(JStarVM* vm, int slot) {
+    if(jsrIsString(vm, slot)) {
+        return pushCachedRegex(vm, slot);
     }
 
-    do {
-        const char* res = match(rs, str, regex);
-        if(res != NULL) {
-            rs->captures[0].start = str;
-            rs->captures[0].length = res - str;
-            return true;
-        }
-        if(rs->error) return false;
-    } while(!isAtEnd(str++));
+    if(!jsrGetGlobal(vm, NULL, "Regex")) return NULL;
+    bool isRegex = jsrIs(vm, slot, -1);
+    jsrPop(vm);
 
-    return false;
+    if(!isRegex) {
+        jsrRaise(vm, "TypeException", "regex must be either a String or a Regex.");
+        return NULL;
+    }
+
+    if(!jsrGetField(vm, slot, M_REGEX_PROGRAM)) return NULL;
+    return jsrGetUserdata(vm, -1);
 }
 
 // -----------------------------------------------------------------------------
 // J* NATIVES
 // -----------------------------------------------------------------------------
 
+// The natives below are shared between the module functions, that take the regex as a String or
+// a Regex argument, and the methods of Regex. In both cases the subject string is in slot 1.
+
 typedef enum FindRes {
     FIND_ERR,
     FIND_MATCH,
     FIND_NOMATCH,
 } FindRes;
 
-static FindRes find(JStarVM* vm, RegexState* rs) {
-    if(!jsrCheckString(vm, 1, "str") || !jsrCheckString(vm, 2, "regex") ||
-       !jsrCheckInt(vm, 3, "off")) {
+static FindRes find(JStarVM* vm, RegexState* rs, int regexSlot, int offSlot) {
+    if(!jsrCheckString(vm, 1, "str") || !jsrCheckInt(vm, offSlot, "off")) {
         return FIND_ERR;
     }
 
-    size_t len = jsrGetStringSz(vm, 1);
-    const char* string = jsrGetString(vm, 1);
-    const char* regex = jsrGetString(vm, 2);
-    double offset = jsrGetNumber(vm, 3);
+    const Regex* re = pushRegex(vm, regexSlot);
+    if(re == NULL) return FIND_ERR;
 
-    if(!matchRegex(rs, string, len, regex, offset)) {
-        if(rs->error) {
-            jsrRaise(vm, "RegexException", "%s\n", rs->error);
-            return FIND_ERR;
-        }
+    size_t len;
+    const char* string = jsrGetStringBytes(vm, 1, &len);
+    double offset = jsrGetNumber(vm, offSlot);
+
+    // negative offsets start from end of string
+    if(offset < 0) {
+        offset += len;
+    }
+
+    if(offset < 0 || offset > len) {
+        jsrRaise(vm, "RegexException", "Invalid starting offset: %g", offset);
+        return FIND_ERR;
+    }
+
+    if(!matchRegex(vm, rs, re, string, len, offset)) {
         jsrPushNull(vm);
         return FIND_NOMATCH;
     }
@@ -390,22 +1081,22 @@ static bool pushCapture(JStarVM* vm, RegexState* rs, int captureIdx) {
     if(captureIdx < 0 || captureIdx >= rs->captureCount) {
         JSR_RAISE(vm, "RegexException", "Invalid capture index %%%d", captureIdx);
     }
-    if(rs->captures[captureIdx].length == CAPTURE_UNFINISHED) {
-        JSR_RAISE(vm, "RegexException", "Unfinished capture");
-    }
 
     if(rs->captures[captureIdx].length == CAPTURE_POSITION) {
         jsrPushNumber(vm, rs->captures[captureIdx].start - rs->string);
     } else {
-        jsrPushStringSz(vm, rs->captures[captureIdx].start, rs->captures[captureIdx].length);
+        // The matched string is always in slot 1, captures can reference its characters
+        ObjString* str = AS_STRING(vm->apiStack[1]);
+        size_t start = rs->captures[captureIdx].start - rs->string;
+        push(vm, OBJ_VAL(newStringSlice(vm, str, start, rs->captures[captureIdx].length)));
     }
 
     return true;
 }
 
-JSR_NATIVE(jsr_re_match) {
+static bool reMatch(JStarVM* vm, int regexSlot, int offSlot) {
     RegexState rs;
-    FindRes res = find(vm, &rs);
+    FindRes res = find(vm, &rs, regexSlot, offSlot);
 
     // An exception was thrown, return error
     if(res == FIND_ERR) return false;
@@ -428,9 +1119,9 @@ JSR_NATIVE(jsr_re_match) {
     return true;
 }
 
-JSR_NATIVE(jsr_re_find) {
+static bool reFind(JStarVM* vm, int regexSlot, int offSlot) {
     RegexState rs;
-    FindRes res = find(vm, &rs);
+    FindRes res = find(vm, &rs, regexSlot, offSlot);
 
     // An exception was thrown, return error
     if(res == FIND_ERR) return false;
@@ -459,13 +1150,14 @@ static bool madeProgress(StringSlice match, const char* lastMatch) {
     return match.start != lastMatch || match.length != 0;
 }
 
-JSR_NATIVE(jsr_re_matchAll) {
+static bool reMatchAll(JStarVM* vm, int regexSlot) {
     JSR_CHECK(String, 1, "str");
-    JSR_CHECK(String, 2, "regex");
 
-    size_t len = jsrGetStringSz(vm, 1);
-    const char* str = jsrGetString(vm, 1);
-    const char* regex = jsrGetString(vm, 2);
+    const Regex* re = pushRegex(vm, regexSlot);
+    if(re == NULL) return false;
+
+    size_t len;
+    const char* str = jsrGetStringBytes(vm, 1, &len);
 
     jsrPushList(vm);
 
@@ -474,10 +1166,7 @@ JSR_NATIVE(jsr_re_matchAll) {
 
     while(offset <= len) {
         RegexState rs;
-        if(!matchRegex(&rs, str, len, regex, offset)) {
-            if(rs.error) {
-                JSR_RAISE(vm, "RegexException", rs.errorMessage);
-            }
+        if(!matchRegex(vm, &rs, re, str, len, offset)) {
             return true;
         }
 
@@ -515,17 +1204,17 @@ JSR_NATIVE(jsr_re_matchAll) {
 }
 
 static bool substitute(JStarVM* vm, RegexState* rs, JStarBuffer* b, const char* sub) {
-    for(; !isAtEnd(sub); sub++) {
+    for(; *sub != '\0'; sub++) {
         switch(*sub) {
         case ESCAPE:
             sub++;
 
-            if(isAtEnd(sub) || !isdigit(*sub)) {
-                JSR_RAISE(vm, "RegexException", "Invalid substring", ESCAPE);
+            if(!isdigit((unsigned char)*sub)) {
+                JSR_RAISE(vm, "RegexException", "Invalid substring");
             }
 
             int digitCount = 0;
-            while(isdigit(sub[digitCount])) {
+            while(isdigit((unsigned char)sub[digitCount])) {
                 digitCount++;
             }
 
@@ -557,19 +1246,20 @@ static bool substituteCall(JStarVM* vm, RegexState* rs, JStarBuffer* b, int fnSl
     return true;
 }
 
-JSR_NATIVE(jsr_re_substituteAll) {
+static bool reSubstituteAll(JStarVM* vm, int regexSlot, int subSlot, int numSlot) {
     JSR_CHECK(String, 1, "str");
-    JSR_CHECK(String, 2, "regex");
-    JSR_CHECK(Int, 4, "num");
+    JSR_CHECK(Int, numSlot, "num");
 
-    if(!jsrIsString(vm, 3) && !jsrIsFunction(vm, 3)) {
+    if(!jsrIsString(vm, subSlot) && !jsrIsFunction(vm, subSlot)) {
         JSR_RAISE(vm, "TypeException", "`sub` must be either a String or a Function.");
     }
 
-    size_t len = jsrGetStringSz(vm, 1);
-    const char* str = jsrGetString(vm, 1);
-    const char* regex = jsrGetString(vm, 2);
-    int num = jsrGetNumber(vm, 4);
+    const Regex* re = pushRegex(vm, regexSlot);
+    if(re == NULL) return false;
+
+    size_t len;
+    const char* str = jsrGetStringBytes(vm, 1, &len);
+    int num = jsrGetNumber(vm, numSlot);
 
     JStarBuffer buf;
     jsrBufferInit(vm, &buf);
@@ -580,11 +1270,7 @@ JSR_NATIVE(jsr_re_substituteAll) {
 
     while(offset <= len) {
         RegexState rs;
-        if(!matchRegex(&rs, str, len, regex, offset)) {
-            if(rs.error) {
-                jsrBufferFree(&buf);
-                JSR_RAISE(vm, "RegexException", rs.errorMessage);
-            }
+        if(!matchRegex(vm, &rs, re, str, len, offset)) {
             break;
         }
 
@@ -600,14 +1286,14 @@ JSR_NATIVE(jsr_re_substituteAll) {
         ptrdiff_t offsetSinceLastMatch = match.start - (lastMatch ? lastMatch : str);
         jsrBufferAppend(&buf, lastMatch ? lastMatch : str, offsetSinceLastMatch);
 
-        if(jsrIsString(vm, 3)) {
-            const char* sub = jsrGetString(vm, 3);
+        if(jsrIsString(vm, subSlot)) {
+            const char* sub = jsrGetString(vm, subSlot);
             if(!substitute(vm, &rs, &buf, sub)) {
                 jsrBufferFree(&buf);
                 return false;
             }
         } else {
-            if(!substituteCall(vm, &rs, &buf, 3)) {
+            if(!substituteCall(vm, &rs, &buf, subSlot)) {
                 jsrBufferFree(&buf);
                 return false;
             }
@@ -635,6 +1321,65 @@ JSR_NATIVE(jsr_re_substituteAll) {
     return true;
 }
 
+JSR_NATIVE(jsr_re_match) {
+    return reMatch(vm, 2, 3);
+}
+
+JSR_NATIVE(jsr_re_find) {
+    return reFind(vm, 2, 3);
+}
+
+JSR_NATIVE(jsr_re_matchAll) {
+    return reMatchAll(vm, 2);
+}
+
+JSR_NATIVE(jsr_re_substituteAll) {
+    return reSubstituteAll(vm, 2, 3, 4);
+}
+
+// class Regex
+JSR_NATIVE(jsr_Regex_construct) {
+    JSR_CHECK(String, 1, "pattern");
+
+    // The engine is chosen automatically when `linear` is null, and only such programs are cached
+    if(jsrIsNull(vm, 2)) {
+        if(!pushCachedRegex(vm, 1)) return false;
+    } else {
+        JSR_CHECK(Boolean, 2, "linear");
+        RegexEngine engine = jsrGetBoolean(vm, 2) ? ENGINE_LINEAR : ENGINE_BACKTRACK;
+        ObjString* pattern = AS_STRING(vm->apiStack[1]);
+        uint32_t hash = stringGetHash(vm, pattern);
+        if(!compileRegex(vm, pattern->data, pattern->length, hash, engine)) return false;
+    }
+
+    jsrSetField(vm, 0, M_REGEX_PROGRAM);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 1);
+    jsrSetField(vm, 0, M_REGEX_PATTERN);
+    jsrPop(vm);
+
+    jsrPushValue(vm, 0);
+    return true;
+}
+
+JSR_NATIVE(jsr_Regex_match) {
+    return reMatch(vm, 0, 2);
+}
+
+JSR_NATIVE(jsr_Regex_find) {
+    return reFind(vm, 0, 2);
+}
+
+JSR_NATIVE(jsr_Regex_matchAll) {
+    return reMatchAll(vm, 0);
+}
+
+JSR_NATIVE(jsr_Regex_substituteAll) {
+    return reSubstituteAll(vm, 0, 2, 3);
+}
+// end
+
 /**
  * MIT LICENSE
  *
@@ -8,4 +8,12 @@ JSR_NATIVE(jsr_re_find);
 JSR_NATIVE(jsr_re_matchAll);
 JSR_NATIVE(jsr_re_substituteAll);
 
+// class Regex
+JSR_NATIVE(jsr_Regex_construct);
+JSR_NATIVE(jsr_Regex_match);
+JSR_NATIVE(jsr_Regex_find);
+JSR_NATIVE(jsr_Regex_matchAll);
+JSR_NATIVE(jsr_Regex_substituteAll);
+// end
+
 #endif
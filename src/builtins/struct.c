@@ -0,0 +1,412 @@
+#include "struct.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "endianness.h"
+#include "object.h"
+#include "util.h"
+#include "value.h"
+#include "vm.h"
+
+#define M_ITER_FORMAT "_format"
+#define M_ITER_BUFFER "_buffer"
+#define M_ITER_SIZE   "_size"
+
+// A format string being decoded
+typedef struct Format {
+    const char *code, *end;  // Next code to decode and end of the format
+    bool little;             // Whether the record is little endian
+} Format;
+
+// A format code together with its repeat count
+typedef struct FormatItem {
+    char code;
+    size_t count;
+} FormatItem;
+
+static bool isHostLittle(void) {
+    const uint16_t one = 1;
+    return *(const uint8_t*)&one == 1;
+}
+
+static void initFormat(Format* fmt, const char* format, size_t length) {
+    fmt->code = format;
+    fmt->end = format + length;
+    fmt->little = isHostLittle();
+
+    if(length == 0) return;
+
+    switch(*format) {
+    case '<':
+        fmt->little = true;
+        fmt->code++;
+        break;
+    case '>':
+    case '!':
+        fmt->little = false;
+        fmt->code++;
+        break;
+    case '=':
+        fmt->code++;
+        break;
+    }
+}
+
+// Returns the size in bytes of a value of `code`, or 0 if `code` is not a valid format code
+static size_t codeSize(char code) {
+    switch(code) {
+    case 'x':
+    case 'b':
+    case 'B':
+    case '?':
+    case 's':
+        return 1;
+    case 'h':
+    case 'H':
+        return 2;
+    case 'i':
+    case 'I':
+    case 'f':
+        return 4;
+    case 'q':
+    case 'Q':
+    case 'd':
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+// Decodes the next item of `fmt`, returning false when there are none left. `item.code` is '\0' if
+// the format ends after a repeat count. Counts too large for a size_t saturate to SIZE_MAX
+static bool nextItem(Format* fmt, FormatItem* item) {
+    const char* c = fmt->code;
+    while(c < fmt->end && isspace((unsigned char)*c)) {
+        c++;
+    }
+
+    if(c == fmt->end) {
+        fmt->code = c;
+        return false;
+    }
+
+    size_t count = 1;
+    if(isdigit((unsigned char)*c)) {
+        count = 0;
+        while(c < fmt->end && isdigit((unsigned char)*c)) {
+            size_t digit = *c++ - '0';
+            count = count > (SIZE_MAX - digit) / 10 ? SIZE_MAX : count * 10 + digit;
+        }
+    }
+
+    item->code = c < fmt->end ? *c++ : '\0';
+    item->count = count;
+    fmt->code = c;
+    return true;
+}
+
+// Checks the format String at `slot` and initializes `fmt` with it, computing the size of its
+// records and the number of values they contain. Returns false, leaving an exception on the stack,
+// if the format is malformed
+static bool parseFormat(JStarVM* vm, int slot, Format* fmt, size_t* size, size_t* values) {
+    JSR_CHECK(String, slot, "format");
+    initFormat(fmt, jsrGetString(vm, slot), jsrGetStringSz(vm, slot));
+
+    *size = 0;
+    *values = 0;
+
+    Format f = *fmt;
+    FormatItem item;
+    while(nextItem(&f, &item)) {
+        if(item.code == '\0') {
+            JSR_RAISE(vm, "StructException", "Repeat count without format code");
+        }
+
+        size_t itemSize = codeSize(item.code);
+        if(itemSize == 0) {
+            JSR_RAISE(vm, "StructException", "Invalid format code '%c'", item.code);
+        }
+        if(item.count > (SIZE_MAX - *size) / itemSize) {
+            JSR_RAISE(vm, "StructException", "Record size too large");
+        }
+
+        *size += item.count * itemSize;
+        if(item.code == 's') {
+            *values += 1;
+        } else if(item.code != 'x') {
+            *values += item.count;
+        }
+    }
+
+    return true;
+}
+
+static uint64_t load(const uint8_t* p, size_t size, bool little) {
+    switch(size) {
+    case 1:
+        return *p;
+    case 2: {
+        uint16_t v;
+        memcpy(&v, p, sizeof(v));
+        return little ? le16toh(v) : be16toh(v);
+    }
+    case 4: {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return little ? le32toh(v) : be32toh(v);
+    }
+    case 8: {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return little ? le64toh(v) : be64toh(v);
+    }
+    }
+    JSR_UNREACHABLE();
+}
+
+static void store(uint8_t* p, uint64_t bits, size_t size, bool little) {
+    switch(size) {
+    case 1:
+        *p = (uint8_t)bits;
+        return;
+    case 2: {
+        uint16_t v = little ? htole16((uint16_t)bits) : htobe16((uint16_t)bits);
+        memcpy(p, &v, sizeof(v));
+        return;
+    }
+    case 4: {
+        uint32_t v = little ? htole32((uint32_t)bits) : htobe32((uint32_t)bits);
+        memcpy(p, &v, sizeof(v));
+        return;
+    }
+    case 8: {
+        uint64_t v = little ? htole64(bits) : htobe64(bits);
+        memcpy(p, &v, sizeof(v));
+        return;
+    }
+    }
+    JSR_UNREACHABLE();
+}
+
+static Value unpackValue(char code, const uint8_t* p, bool little) {
+    uint64_t bits = load(p, codeSize(code), little);
+    switch(code) {
+    case 'b':
+        return NUM_VAL((int8_t)bits);
+    case 'h':
+        return NUM_VAL((int16_t)bits);
+    case 'i':
+        return NUM_VAL((int32_t)bits);
+    case 'q':
+        return NUM_VAL((int64_t)bits);
+    case 'B':
+    case 'H':
+    case 'I':
+    case 'Q':
+        return NUM_VAL(bits);
+    case '?':
+        return BOOL_VAL(bits != 0);
+    case 'f':
+        return NUM_VAL(REINTERPRET_CAST(uint32_t, float, (uint32_t)bits));
+    case 'd':
+        return NUM_VAL(REINTERPRET_CAST(uint64_t, double, bits));
+    }
+    JSR_UNREACHABLE();
+}
+
+static bool packValue(JStarVM* vm, char code, Value val, uint8_t* out, bool little) {
+    size_t size = codeSize(code);
+
+    if(code == '?') {
+        if(!IS_BOOL(val)) JSR_RAISE(vm, "TypeException", "Format code '?' requires a Boolean.");
+        store(out, AS_BOOL(val), size, little);
+        return true;
+    }
+
+    if(!IS_NUM(val)) JSR_RAISE(vm, "TypeException", "Format code '%c' requires a Number.", code);
+    double num = AS_NUM(val);
+
+    switch(code) {
+    case 'f':
+        store(out, REINTERPRET_CAST(float, uint32_t, (float)num), size, little);
+        return true;
+    case 'd':
+        store(out, REINTERPRET_CAST(double, uint64_t, num), size, little);
+        return true;
+    }
+
+    if(trunc(num) != num) {
+        JSR_RAISE(vm, "TypeException", "Format code '%c' requires an integer.", code);
+    }
+
+    // Lowercase codes are the signed integers
+    bool isSigned = islower((unsigned char)code);
+    double max = ldexp(1.0, (int)(size * 8 - isSigned));
+    double min = isSigned ? -max : 0;
+    if(num < min || num >= max) {
+        JSR_RAISE(vm, "StructException", "%g out of range for format code '%c'", num, code);
+    }
+
+    store(out, isSigned ? (uint64_t)(int64_t)num : (uint64_t)num, size, little);
+    return true;
+}
+
+// Decodes a record of `fmt` from `data` into `values`, that must be reachable as new Strings can
+// trigger a garbage collection
+static void unpackValues(JStarVM* vm, Format fmt, const uint8_t* data, Value* values) {
+    FormatItem item;
+    while(nextItem(&fmt, &item)) {
+        switch(item.code) {
+        case 'x':
+            data += item.count;
+            break;
+        case 's': {
+            ObjString* str = newString(vm, item.count);
+            memcpy(str->data, data, item.count);
+            *values++ = OBJ_VAL(str);
+            data += item.count;
+            break;
+        }
+        default: {
+            size_t size = codeSize(item.code);
+            for(size_t i = 0; i < item.count; i++) {
+                *values++ = unpackValue(item.code, data, fmt.little);
+                data += size;
+            }
+            break;
+        }
+        }
+    }
+}
+
+// Unpacks the record of the format at `fmtSlot` found at `offset` in the buffer at `bufSlot`, and
+// pushes a Tuple with its values. If `exact` is true the buffer must contain only the record
+static bool unpackRecord(JStarVM* vm, int fmtSlot, int bufSlot, size_t offset, bool exact) {
+    Format fmt;
+    size_t size, count;
+    if(!parseFormat(vm, fmtSlot, &fmt, &size, &count)) return false;
+
+    const char* bytes;
+    size_t length;
+    if(!getBytes(vm, bufSlot, "buffer", &bytes, &length)) return false;
+    const uint8_t* data = (const uint8_t*)bytes;
+
+    if(exact && length != size) {
+        JSR_RAISE(vm, "StructException", "Buffer of %zu bytes, but the record has %zu", length,
+                  size);
+    }
+    if(offset > length || length - offset < size) {
+        JSR_RAISE(vm, "StructException", "Buffer of %zu bytes too small for a record of %zu at %zu",
+                  length, size, offset);
+    }
+
+    ObjTuple* tuple = newTuple(vm, count);
+    push(vm, OBJ_VAL(tuple));
+    unpackValues(vm, fmt, data + offset, tuple->items);
+    return true;
+}
+
+JSR_NATIVE(jsr_struct_size) {
+    Format fmt;
+    size_t size, count;
+    if(!parseFormat(vm, 1, &fmt, &size, &count)) return false;
+    jsrPushNumber(vm, size);
+    return true;
+}
+
+JSR_NATIVE(jsr_struct_pack) {
+    Format fmt;
+    size_t size, count;
+    if(!parseFormat(vm, 1, &fmt, &size, &count)) return false;
+
+    ObjTuple* args = AS_TUPLE(vm->apiStack[2]);
+    if(args->count != count) {
+        JSR_RAISE(vm, "StructException", "Format requires %zu values, got %zu", count,
+                  args->count);
+    }
+
+    ObjString* str = newString(vm, size);
+    push(vm, OBJ_VAL(str));
+
+    uint8_t* out = (uint8_t*)str->data;
+    const Value* values = args->items;
+
+    FormatItem item;
+    while(nextItem(&fmt, &item)) {
+        switch(item.code) {
+        case 'x':
+            memset(out, 0, item.count);
+            out += item.count;
+            break;
+        case 's': {
+            Value val = *values++;
+            if(!IS_STRING(val)) JSR_RAISE(vm, "TypeException", "Format code 's' requires a String.");
+
+            ObjString* s = AS_STRING(val);
+            size_t len = s->length < item.count ? s->length : item.count;
+            memcpy(out, s->data, len);
+            memset(out + len, 0, item.count - len);
+            out += item.count;
+            break;
+        }
+        default: {
+            size_t itemSize = codeSize(item.code);
+            for(size_t i = 0; i < item.count; i++) {
+                if(!packValue(vm, item.code, *values++, out, fmt.little)) return false;
+                out += itemSize;
+            }
+            break;
+        }
+        }
+    }
+
+    return true;
+}
+
+JSR_NATIVE(jsr_struct_unpack) {
+    return unpackRecord(vm, 1, 2, 0, true);
+}
+
+JSR_NATIVE(jsr_struct_unpackFrom) {
+    JSR_CHECK(Int, 3, "offset");
+    double offset = jsrGetNumber(vm, 3);
+    if(offset < 0) JSR_RAISE(vm, "InvalidArgException", "offset must be >= 0");
+    return unpackRecord(vm, 1, 2, (size_t)offset, false);
+}
+
+// class UnpackIter
+JSR_NATIVE(jsr_UnpackIter_iter) {
+    if(!jsrGetField(vm, 0, M_ITER_SIZE)) return false;
+    JSR_CHECK(Number, -1, M_ITER_SIZE);
+    size_t size = (size_t)jsrGetNumber(vm, -1);
+
+    if(!jsrGetField(vm, 0, M_ITER_BUFFER)) return false;
+    const char* bytes;
+    size_t length;
+    if(!getBytes(vm, -1, "buffer", &bytes, &length)) return false;
+
+    size_t offset = 0;
+    if(IS_NUM(vm->apiStack[1])) {
+        offset = (size_t)AS_NUM(vm->apiStack[1]) + size;
+    }
+
+    if(offset < length && length - offset >= size) {
+        push(vm, NUM_VAL(offset));
+    } else {
+        push(vm, BOOL_VAL(false));
+    }
+    return true;
+}
+
+JSR_NATIVE(jsr_UnpackIter_next) {
+    if(!jsrGetField(vm, 0, M_ITER_FORMAT)) return false;
+    if(!jsrGetField(vm, 0, M_ITER_BUFFER)) return false;
+    return unpackRecord(vm, -2, -1, (size_t)AS_NUM(vm->apiStack[1]), false);
+}
+// end
@@ -0,0 +1,16 @@
+#ifndef STRUCT_H
+#define STRUCT_H
+
+#include "jstar.h"
+
+JSR_NATIVE(jsr_struct_size);
+JSR_NATIVE(jsr_struct_pack);
+JSR_NATIVE(jsr_struct_unpack);
+JSR_NATIVE(jsr_struct_unpackFrom);
+
+// class UnpackIter
+JSR_NATIVE(jsr_UnpackIter_iter);
+JSR_NATIVE(jsr_UnpackIter_next);
+// end
+
+#endif
@@ -13,8 +13,8 @@ void initCode(Code* c) {
 }
 
 void freeCode(JStarVM* vm, Code* c) {
-    arrayFree(vm, &c->bytecode);
-    arrayFree(vm, &c->lines);
+    if(!c->externalBytecode) arrayFree(vm, &c->bytecode);
+    if(!c->externalLines) arrayFree(vm, &c->lines);
     arrayFree(vm, &c->consts);
     arrayFree(vm, &c->symbols);
 }
@@ -1,6 +1,7 @@
 #ifndef CHUNK_H
 #define CHUNK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -27,11 +28,22 @@ typedef struct {
 // A runtime representation of a J* bytecode chunk.
 // Stores the bytecode, the constants and the symbols used in the chunk, as well as metadata
 // associated with each opcode (such as the original source line number).
+// The bytecode and the line information can also reference external read-only memory (for example
+// a memory mapped compiled file or a runtime snapshot shared by multiple VMs), in which case they
+// are not freed along with the Code. If `owner` is not NULL, it is the object responsible for
+// keeping the external memory alive.
+// A Code whose `lazyChunk` field is set is empty and has yet to be deserialized from the compiled
+// chunk at `lazyChunk`, between the `lazyStart` and `lazyEnd` offsets.
 typedef struct Code {
     Bytecode bytecode;
     Lines lines;
     Values consts;
     Symbols symbols;
+    bool externalBytecode;
+    bool externalLines;
+    struct Obj* owner;
+    const uint8_t* lazyChunk;
+    size_t lazyStart, lazyEnd;
 } Code;
 
 void initCode(Code* c);
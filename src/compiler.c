@@ -378,7 +378,7 @@ static int resolveUpvalue(Compiler* c, JStarIdentifier id, JStarLoc loc) {
 static bool resolveGlobal(Compiler* c, JStarIdentifier id) {
     if(c->module) {
         if(hashTableIntGetString(&c->module->globalNames, id.name, id.length,
-                                 hashBytes(id.name, id.length))) {
+                                 stringHash(c->vm, id.name, id.length))) {
             return true;
         }
     } else if(resolveCoreSymbol(id)) {
@@ -11,8 +11,20 @@
     #define htobe16(x) OSSwapHostToBigInt16(x)
     #define be16toh(x) OSSwapBigToHostInt16(x)
 
+    #define htobe32(x) OSSwapHostToBigInt32(x)
+    #define be32toh(x) OSSwapBigToHostInt32(x)
+
     #define htobe64(x) OSSwapHostToBigInt64(x)
     #define be64toh(x) OSSwapBigToHostInt64(x)
+
+    #define htole16(x) OSSwapHostToLittleInt16(x)
+    #define le16toh(x) OSSwapLittleToHostInt16(x)
+
+    #define htole32(x) OSSwapHostToLittleInt32(x)
+    #define le32toh(x) OSSwapLittleToHostInt32(x)
+
+    #define htole64(x) OSSwapHostToLittleInt64(x)
+    #define le64toh(x) OSSwapLittleToHostInt64(x)
 #elif defined(JSTAR_OPENBSD)
     #include <sys/endian.h> // IWYU pragma: export
 #elif defined(JSTAR_FREEBSD)
@@ -28,23 +40,50 @@
             #define htobe16(x) _byteswap_ushort(x)
             #define be16toh(x) _byteswap_ushort(x)
 
+            #define htobe32(x) _byteswap_ulong(x)
+            #define be32toh(x) _byteswap_ulong(x)
+
             #define htobe64(x) _byteswap_uint64(x)
             #define be64toh(x) _byteswap_uint64(x)
         #elif defined(__GNUC__)
             #define htobe16(x) __builtin_bswap16(x)
             #define be16toh(x) __builtin_bswap16(x)
 
+            #define htobe32(x) __builtin_bswap32(x)
+            #define be32toh(x) __builtin_bswap32(x)
+
             #define htobe64(x) __builtin_bswap64(x)
             #define be64toh(x) __builtin_bswap64(x)
         #else
             #error Unsupported compiler: unknown endianness conversion functions
         #endif
+
+        #define htole16(x) (x)
+        #define le16toh(x) (x)
+
+        #define htole32(x) (x)
+        #define le32toh(x) (x)
+
+        #define htole64(x) (x)
+        #define le64toh(x) (x)
     #elif BYTE_ORDER == BIG_ENDIAN
         #define htobe16(x) (x)
         #define be16toh(x) (x)
 
+        #define htobe32(x) (x)
+        #define be32toh(x) (x)
+
         #define htobe64(x) (x)
         #define be64toh(x) (x)
+
+        #define htole16(x) __builtin_bswap16(x)
+        #define le16toh(x) __builtin_bswap16(x)
+
+        #define htole32(x) __builtin_bswap32(x)
+        #define le32toh(x) __builtin_bswap32(x)
+
+        #define htole64(x) __builtin_bswap64(x)
+        #define le64toh(x) __builtin_bswap64(x)
     #else
         #error Unsupported platform: unknown endiannes
     #endif
@@ -95,6 +95,7 @@ static void recursevelyReach(JStarVM* vm, Obj* o) {
         ObjFunction* func = (ObjFunction*)o;
         reachObject(vm, (Obj*)func->base.name);
         reachObject(vm, (Obj*)func->base.module);
+        reachObject(vm, func->code.owner);
         reachValues(vm, func->code.consts);
         for(size_t i = 0; i < func->code.symbols.count; i++) {
             reachObject(vm, (Obj*)func->code.symbols.items[i].cache.key);
@@ -183,13 +184,26 @@ static void recursevelyReach(JStarVM* vm, Obj* o) {
     case OBJ_STACK_TRACE: {
         ObjStackTrace* stackTrace = (ObjStackTrace*)o;
         for(size_t i = 0; i < stackTrace->records.count; i++) {
+            reachObject(vm, (Obj*)stackTrace->records.items[i].path);
             reachObject(vm, (Obj*)stackTrace->records.items[i].funcName);
             reachObject(vm, (Obj*)stackTrace->records.items[i].moduleName);
         }
         break;
     }
+    case OBJ_STRING: {
+        ObjString* str = (ObjString*)o;
+        if(str->kind == STR_SLICE) {
+            reachObject(vm, (Obj*)((ObjSliceString*)str)->parent);
+        }
+        break;
+    }
+    case OBJ_TYPED_ARRAY:
+        reachObject(vm, (Obj*)((ObjTypedArray*)o)->parent);
+        break;
+    case OBJ_BYTE_ARRAY:
+        reachObject(vm, (Obj*)((ObjByteArray*)o)->parent);
+        break;
     case OBJ_USERDATA:
-    case OBJ_STRING:
         break;
     }
 }
@@ -237,6 +251,11 @@ void garbageCollect(JStarVM* vm) {
 
         for(JStarSymbol* s = vm->symbols; s != NULL; s = s->next) {
             reachObject(vm, s->sym.key);
+            reachObject(vm, (Obj*)s->name);
+        }
+
+        for(JStarCallHandle* h = vm->callHandles; h != NULL; h = h->next) {
+            reachValue(vm, h->callee);
         }
 
         reachCompilerRoots(vm, vm->currCompiler);
@@ -250,11 +269,6 @@ void garbageCollect(JStarVM* vm) {
         }
     }
 
-    {
-        PROFILE("{sweep-strings}::garbageCollect");
-        sweepStrings(&vm->stringPool);
-    }
-
     sweepObjects(vm);
 
     vm->reachedStack.count = 0;
@@ -52,10 +52,12 @@
                                                                                                   \
     void free##name##HashTable(name##HashTable* t) {                                              \
         if(t->entries) t->vm->realloc(t->entries, (t->sizeMask + 1) * sizeof(name##Entry), 0);    \
+        init##name##HashTable(t->vm, t);                                                          \
     }                                                                                             \
                                                                                                   \
-    static name##Entry* findEntry(name##Entry* entries, size_t sizeMask, struct ObjString* key) { \
-        size_t i = stringGetHash(key) & sizeMask;                                                 \
+    static name##Entry* findEntry(JStarVM* vm, name##Entry* entries, size_t sizeMask,             \
+                                   struct ObjString* key) {                                       \
+        size_t i = stringGetHash(vm, key) & sizeMask;                                             \
         name##Entry* tomb = NULL;                                                                 \
                                                                                                   \
         for(;;) {                                                                                 \
@@ -88,7 +90,7 @@
             for(size_t i = 0; i <= t->sizeMask; i++) {                                            \
                 name##Entry* e = &t->entries[i];                                                  \
                 if(!e->key) continue;                                                             \
-                name##Entry* dest = find##Entry(newEntries, newSize - 1, e->key);                 \
+                name##Entry* dest = find##Entry(t->vm, newEntries, newSize - 1, e->key);          \
                 *dest = (name##Entry){e->key, e->value};                                          \
             }                                                                                     \
             t->vm->realloc(t->entries, (t->sizeMask + 1) * sizeof(name##Entry), 0);               \
@@ -104,7 +106,7 @@
             resizeEntries(t);                                                                     \
         }                                                                                         \
                                                                                                   \
-        name##Entry* e = findEntry(t->entries, t->sizeMask, key);                                 \
+        name##Entry* e = findEntry(t->vm, t->entries, t->sizeMask, key);                          \
         bool newEntry = !e->key;                                                                  \
         if(newEntry) {                                                                            \
             t->count++;                                                                           \
@@ -117,7 +119,7 @@
                                                                                                   \
     bool hashTable##name##Get(const name##HashTable* t, struct ObjString* key, V* res) {          \
         if(t->entries == NULL) return false;                                                      \
-        name##Entry* e = findEntry(t->entries, t->sizeMask, key);                                 \
+        name##Entry* e = findEntry(t->vm, t->entries, t->sizeMask, key);                          \
         if(!e->key) return false;                                                                 \
         *res = e->value;                                                                          \
         return true;                                                                              \
@@ -125,12 +127,12 @@
                                                                                                   \
     bool hashTable##name##ContainsKey(const name##HashTable* t, struct ObjString* key) {          \
         if(t->entries == NULL) return false;                                                      \
-        return findEntry(t->entries, t->sizeMask, key)->key != NULL;                              \
+        return findEntry(t->vm, t->entries, t->sizeMask, key)->key != NULL;                       \
     }                                                                                             \
                                                                                                   \
     bool hashTable##name##Del(name##HashTable* t, struct ObjString* key) {                        \
         if(t->count == 0) return false;                                                           \
-        name##Entry* e = findEntry(t->entries, t->sizeMask, key);                                 \
+        name##Entry* e = findEntry(t->vm, t->entries, t->sizeMask, key);                          \
         if(!e->key) return false;                                                                 \
         *e = (name##Entry){NULL, TOMB_MARKER};                                                    \
         t->count--;                                                                               \
@@ -156,7 +158,7 @@
             name##Entry* e = &t->entries[i];                                                      \
             if(!e->key) {                                                                         \
                 if(IS_INVALID_VAL(e->value)) return NULL;                                         \
-            } else if(stringGetHash(e->key) == hash && e->key->length == length &&                \
+            } else if(stringGetHash(t->vm, e->key) == hash && e->key->length == length &&         \
                       memcmp(e->key->data, str, length) == 0) {                                   \
                 return e->key;                                                                    \
             }                                                                                     \
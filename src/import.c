@@ -34,16 +34,21 @@ ObjFunction* compileModule(JStarVM* vm, const char* path, ObjString* name, JStar
     return fn;
 }
 
-JStarResult deserializeModule(JStarVM* vm, const char* path, ObjString* name, const void* code,
-                              size_t len, ObjFunction** out) {
-    PROFILE_FUNC();
-    JStarResult res = deserialize(vm, getOrCreateModule(vm, path, name), code, len, out);
+static void reportDeserializeError(JStarVM* vm, JStarResult res, const char* path) {
     if(res == JSR_VERSION_ERR) {
         vm->errorCallback(vm, res, path, (JStarLoc){0}, "Incompatible binary file version");
     }
     if(res == JSR_DESERIALIZE_ERR) {
         vm->errorCallback(vm, res, path, (JStarLoc){0}, "Malformed binary file");
     }
+}
+
+JStarResult deserializeModule(JStarVM* vm, const char* path, ObjString* name, const void* code,
+                              size_t len, bool borrow, Obj* owner, ObjFunction** out) {
+    PROFILE_FUNC();
+    ObjModule* module = getOrCreateModule(vm, path, name);
+    JStarResult res = deserialize(vm, module, code, len, borrow, owner, out);
+    reportDeserializeError(vm, res, path);
     return res;
 }
 
@@ -86,7 +91,7 @@ static void parseError(const char* file, JStarLoc loc, const char* error, void*
 }
 
 static ObjModule* importSource(JStarVM* vm, const char* path, ObjString* name, const char* src,
-                               size_t len) {
+                               size_t len, const JStarImportResult* res) {
     PROFILE_FUNC();
 
     JStarStmt* program = jsrParse(path, src, len, parseError, &vm->astArena, vm);
@@ -103,19 +108,56 @@ static ObjModule* importSource(JStarVM* vm, const char* path, ObjString* name, c
     }
 
     push(vm, OBJ_VAL(fn));
+
+    // Hand out the compiled module to the embedder for caching
+    if(res && res->cacheCode) {
+        PROFILE("{cache-code}::importSource");
+        JStarBuffer code = serialize(vm, fn);
+        res->cacheCode(code.data, code.size, res->userData);
+        jsrBufferFree(&code);
+    }
+
     vm->sp[-1] = OBJ_VAL(newClosure(vm, fn));
     return fn->base.module;
 }
 
+// Payload of the userdatum that owns the compiled code of an import result
+typedef struct CodeOwner {
+    void (*releaseCode)(void* userData);
+    void* userData;
+} CodeOwner;
+
+static void finalizeCodeOwner(void* data) {
+    CodeOwner* owner = data;
+    owner->releaseCode(owner->userData);
+}
+
+static ObjUserdata* newCodeOwner(JStarVM* vm, const JStarImportResult* res) {
+    ObjUserdata* udata = newUserData(vm, sizeof(CodeOwner), &finalizeCodeOwner);
+    CodeOwner* owner = (CodeOwner*)udata->data;
+    owner->releaseCode = res->releaseCode;
+    owner->userData = res->userData;
+    return udata;
+}
+
+// Imports compiled code. Errors are reported only if `report` is true, so that failures that
+// can be recovered from stay silent
 static ObjModule* importBinary(JStarVM* vm, const char* path, ObjString* name, const void* code,
-                               size_t len) {
+                               size_t len, bool borrow, Obj* owner, bool report) {
     PROFILE_FUNC();
 
     JSR_ASSERT(isCompiledCode(code, len), "`code` must be a valid compiled chunk");
 
+    if(owner) push(vm, OBJ_VAL(owner));
+
     ObjFunction* fn;
-    JStarResult res = deserializeModule(vm, path, name, code, len, &fn);
+    ObjModule* module = getOrCreateModule(vm, path, name);
+    JStarResult res = deserialize(vm, module, code, len, borrow, owner, &fn);
+
+    if(owner) pop(vm);
+
     if(res != JSR_SUCCESS) {
+        if(report) reportDeserializeError(vm, res, path);
         return NULL;
     }
 
@@ -124,6 +166,36 @@ static ObjModule* importBinary(JStarVM* vm, const char* path, ObjString* name, c
     return fn->base.module;
 }
 
+// Imports the module `name` from the code resolved by the import callback
+static ObjModule* importResolved(JStarVM* vm, ObjString* name, JStarImportResult* res) {
+    ObjModule* module;
+    bool codeOwned = false;
+
+    if(isCompiledCode(res->code, res->codeLength)) {
+        // If the embedder lets us manage the lifetime of the code, reference it in place. The
+        // owner userdatum will release it once all functions referencing it are collected
+        Obj* owner = res->releaseCode ? (Obj*)newCodeOwner(vm, res) : NULL;
+        codeOwned = owner != NULL;
+        module = importBinary(vm, res->path, name, res->code, res->codeLength, codeOwned, owner,
+                              res->fallback == NULL);
+
+        // The code may be a stale or damaged cache, let the embedder provide a replacement
+        if(module == NULL && res->fallback) {
+            JStarImportResult fallback = res->fallback(res->userData);
+            fallback.fallback = NULL;
+            if(fallback.code) module = importResolved(vm, name, &fallback);
+        }
+    } else {
+        module = importSource(vm, res->path, name, res->code, res->codeLength, res);
+    }
+
+    if(res->finalize) res->finalize(res->userData);
+    if(res->releaseCode && !codeOwned) res->releaseCode(res->userData);
+    if(module == NULL) return NULL;
+    if(res->reg) module->registry = res->reg;
+    return module;
+}
+
 ObjModule* importModule(JStarVM* vm, ObjString* name) {
     PROFILE_FUNC();
 
@@ -132,9 +204,10 @@ ObjModule* importModule(JStarVM* vm, ObjString* name) {
         return getModule(vm, name);
     }
 
+    // Built-in modules live in static memory, so their bytecode can be referenced in place
     size_t len;
     const void* builtin = readBuiltInModule(name->data, &len);
-    if(builtin) return importBinary(vm, name->data, name, builtin, len);
+    if(builtin) return importBinary(vm, name->data, name, builtin, len, true, NULL, true);
 
     if(!vm->importCallback) return NULL;
 
@@ -147,16 +220,5 @@ ObjModule* importModule(JStarVM* vm, ObjString* name) {
     vm->apiStack = vm->stack + apiStackOffset;
 
     if(!res.code) return NULL;
-
-    ObjModule* module;
-    if(isCompiledCode(res.code, res.codeLength)) {
-        module = importBinary(vm, res.path, name, res.code, res.codeLength);
-    } else {
-        module = importSource(vm, res.path, name, res.code, res.codeLength);
-    }
-
-    if(res.finalize) res.finalize(res.userData);
-    if(module == NULL) return NULL;
-    if(res.reg) module->registry = res.reg;
-    return module;
+    return importResolved(vm, name, &res);
 }
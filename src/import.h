@@ -1,6 +1,7 @@
 #ifndef IMPORT_H
 #define IMPORT_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "jstar.h"
@@ -23,10 +24,11 @@
 ObjFunction* compileModule(JStarVM* vm, const char* path, ObjString* name, JStarStmt* program);
 
 // Similar to the above, but deserialize a module from bytecode.
+// If `borrow` is true the bytecode is referenced in place, see `deserialize` in serialize.h.
 // On success, returns JSR_SUCCESS and sets 'out' to the deserialized function.
 // On error, returns an error code and leaves out unchanged.
 JStarResult deserializeModule(JStarVM* vm, const char* path, ObjString* name, const void* code,
-                              size_t len, ObjFunction** out);
+                              size_t len, bool borrow, Obj* owner, ObjFunction** out);
 
 // Sets a module in the cache.
 void setModule(JStarVM* vm, ObjString* name, ObjModule* module);
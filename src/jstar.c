@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "array.h"
 #include "buffer.h"
 #include "compiler.h"
 #include "conf.h"
@@ -25,6 +26,7 @@
 // -----------------------------------------------------------------------------
 // API - The bulk of the API (jstar.h) implementation
 // JStarNewVM, jsrInitRuntime and JStarFreeVM functions are implemented in vm.c
+// jsrSnapshotRuntime is implemented in snapshot.c
 // -----------------------------------------------------------------------------
 
 static bool validateSlot(const JStarVM* vm, int slot) {
@@ -76,6 +78,17 @@ static ObjModule* getModuleOrRaise(JStarVM* vm, const char* moduleName) {
     return mod;
 }
 
+// Similar to the above, but reuses the module cached in a global lookup symbol if it has the
+// requested name. Modules are never replaced once registered, so the name is enough to tell
+static ObjModule* getSymbolModuleOrRaise(JStarVM* vm, const char* moduleName,
+                                         const JStarSymbol* sym) {
+    if(moduleName && sym->sym.key && sym->sym.type == SYMBOL_GLOBAL) {
+        ObjModule* mod = (ObjModule*)sym->sym.key;
+        if(strcmp(mod->name->data, moduleName) == 0) return mod;
+    }
+    return getModuleOrRaise(vm, moduleName);
+}
+
 void jsrPrintErrorCB(JStarVM* vm, JStarResult err, const char* file, JStarLoc loc,
                      const char* error) {
     (void)vm, (void)err;
@@ -101,6 +114,9 @@ JStarConf jsrGetConf(void) {
         NULL,
         NULL,
         NULL,
+        NULL,
+        0,
+        0,
     };
 }
 
@@ -187,7 +203,7 @@ JStarResult jsrEvalModule(JStarVM* vm, const char* path, const char* module, con
 
     ObjFunction* fn;
     ObjString* name = copyCStringInterned(vm, module);
-    JStarResult res = deserializeModule(vm, path, name, code, len, &fn);
+    JStarResult res = deserializeModule(vm, path, name, code, len, false, NULL, &fn);
     if(res != JSR_SUCCESS) return res;
     if(!eval(vm, path, fn)) return JSR_RUNTIME_ERR;
 
@@ -228,7 +244,7 @@ JStarResult jsrDisassembleCode(JStarVM* vm, const char* path, const void* code,
     ObjFunction* fn;
     // Use dummy module since the code won't be executed
     ObjString* dummy = copyCStringInterned(vm, "");
-    JStarResult res = deserializeModule(vm, path, dummy, code, len, &fn);
+    JStarResult res = deserializeModule(vm, path, dummy, code, len, false, NULL, &fn);
 
     if(res == JSR_SUCCESS) {
         disassembleFunction(fn);
@@ -256,6 +272,13 @@ static bool executeCall(JStarVM* vm, int evalDepth) {
     return true;
 }
 
+// Returns the name looked up by a cached API function, avoiding interning it if the symbol is
+// already bound to it
+static ObjString* symbolName(JStarVM* vm, const char* name, const JStarSymbol* sym) {
+    if(sym->name) return sym->name;
+    return copyCStringInterned(vm, name);
+}
+
 bool jsrCall(JStarVM* vm, uint8_t argc) {
     int evalDepth = vm->frameCount;
 
@@ -279,7 +302,7 @@ bool jsrCallMethod(JStarVM* vm, const char* name, uint8_t argc) {
 bool jsrCallMethodCached(JStarVM* vm, const char* name, uint8_t argc, JStarSymbol* sym) {
     int evalDepth = vm->frameCount;
 
-    if(!invokeValue(vm, copyCStringInterned(vm, name), argc, &sym->sym)) {
+    if(!invokeValue(vm, symbolName(vm, name, sym), argc, &sym->sym)) {
         callError(vm, evalDepth, argc);
         return false;
     }
@@ -291,6 +314,52 @@ bool jsrCallMethodCached(JStarVM* vm, const char* name, uint8_t argc, JStarSymbo
     return true;
 }
 
+JStarCallHandle* jsrNewCallHandle(JStarVM* vm, int slot, uint8_t argc) {
+    JStarCallHandle* h = GC_ALLOC(vm, sizeof(*h));
+    *h = (JStarCallHandle){.callee = apiStackSlot(vm, slot), .argc = argc};
+
+    h->next = vm->callHandles;
+    if(vm->callHandles) vm->callHandles->prev = h;
+    vm->callHandles = h;
+
+    if(!prepareCallHandle(vm, h)) {
+        jsrFreeCallHandle(vm, h);
+        return NULL;
+    }
+
+    return h;
+}
+
+void jsrFreeCallHandle(JStarVM* vm, JStarCallHandle* h) {
+    if(vm->callHandles == h) {
+        vm->callHandles = h->next;
+    }
+
+    if(h->prev != NULL) {
+        h->prev->next = h->next;
+    }
+    if(h->next != NULL) {
+        h->next->prev = h->prev;
+    }
+
+    GC_FREE(vm, JStarCallHandle, h);
+}
+
+bool jsrInvokeHandle(JStarVM* vm, const JStarCallHandle* h) {
+    int evalDepth = vm->frameCount;
+
+    if(!callHandle(vm, h)) {
+        callError(vm, evalDepth, h->argc);
+        return false;
+    }
+
+    if(!executeCall(vm, evalDepth)) {
+        return false;
+    }
+
+    return true;
+}
+
 JStarSymbol* jsrNewSymbol(JStarVM* vm) {
     JStarSymbol* sym = GC_ALLOC(vm, sizeof(*sym));
     *sym = (JStarSymbol){0};
@@ -302,6 +371,13 @@ JStarSymbol* jsrNewSymbol(JStarVM* vm) {
     return sym;
 }
 
+JStarSymbol* jsrNewSymbolNamed(JStarVM* vm, const char* name) {
+    // The symbol is already linked in the symbol list, so the name is reachable once set
+    JStarSymbol* sym = jsrNewSymbol(vm);
+    sym->name = copyCStringInterned(vm, name);
+    return sym;
+}
+
 void jsrFreeSymbol(JStarVM* vm, JStarSymbol* sym) {
     if(vm->symbols == sym) {
         vm->symbols = sym->next;
@@ -483,7 +559,6 @@ void jsrPushBoolean(JStarVM* vm, bool boolean) {
 
 void jsrPushStringSz(JStarVM* vm, const char* string, size_t length) {
     checkStack(vm);
-    // TODO: intern this?
     ObjString* str = newString(vm, length);
     memcpy(str->data, string, length);
     push(vm, OBJ_VAL(str));
@@ -493,6 +568,12 @@ void jsrPushString(JStarVM* vm, const char* string) {
     jsrPushStringSz(vm, string, strlen(string));
 }
 
+void jsrPushExternalString(JStarVM* vm, const char* data, size_t length,
+                           void (*release)(void* userData), void* userData) {
+    checkStack(vm);
+    push(vm, OBJ_VAL(newExternalString(vm, data, length, release, userData)));
+}
+
 void jsrPushHandle(JStarVM* vm, void* handle) {
     checkStack(vm);
     push(vm, HANDLE_VAL(handle));
@@ -517,6 +598,71 @@ void jsrPushTuple(JStarVM* vm, size_t size) {
     push(vm, OBJ_VAL(tup));
 }
 
+static void numbersToValues(Value* items, const double* numbers, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        items[i] = NUM_VAL(numbers[i]);
+    }
+}
+
+// Fills `items` with new strings. The sequence owning `items` must be reachable, as allocating
+// the strings can trigger a collection
+static void stringsToValues(JStarVM* vm, Value* items, const char* const* strings, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        size_t length = strlen(strings[i]);
+        ObjString* str = newString(vm, length);
+        memcpy(str->data, strings[i], length);
+        items[i] = OBJ_VAL(str);
+    }
+}
+
+static bool valuesToNumbers(JStarVM* vm, const Value* items, size_t start, size_t count,
+                            double* out, const char* seqName) {
+    for(size_t i = 0; i < count; i++) {
+        Value v = items[start + i];
+        if(!IS_NUM(v)) {
+            ObjClass* cls = getClass(vm, v);
+            jsrRaise(vm, "TypeException", "%s element %zu must be a number, got %s.", seqName,
+                     start + i, cls->name->data);
+            return false;
+        }
+        out[i] = AS_NUM(v);
+    }
+    return true;
+}
+
+void jsrPushNumberList(JStarVM* vm, const double* numbers, size_t count) {
+    checkStack(vm);
+    ObjList* lst = newList(vm, count);
+    numbersToValues(lst->items, numbers, count);
+    lst->count = count;
+    push(vm, OBJ_VAL(lst));
+}
+
+void jsrPushNumberTuple(JStarVM* vm, const double* numbers, size_t count) {
+    checkStack(vm);
+    ObjTuple* tup = newTuple(vm, count);
+    numbersToValues(tup->items, numbers, count);
+    push(vm, OBJ_VAL(tup));
+}
+
+void jsrPushStringList(JStarVM* vm, const char* const* strings, size_t count) {
+    checkStack(vm);
+    ObjList* lst = newList(vm, count);
+    for(size_t i = 0; i < count; i++) {
+        lst->items[i] = NULL_VAL;
+    }
+    lst->count = count;
+    push(vm, OBJ_VAL(lst));
+    stringsToValues(vm, lst->items, strings, count);
+}
+
+void jsrPushStringTuple(JStarVM* vm, const char* const* strings, size_t count) {
+    checkStack(vm);
+    ObjTuple* tup = newTuple(vm, count);
+    push(vm, OBJ_VAL(tup));
+    stringsToValues(vm, tup->items, strings, count);
+}
+
 void jsrPushTable(JStarVM* vm) {
     checkStack(vm);
     push(vm, OBJ_VAL(newTable(vm)));
@@ -534,6 +680,24 @@ void* jsrPushUserdata(JStarVM* vm, size_t size, void (*finalize)(void*)) {
     return (void*)udata->data;
 }
 
+void* jsrPushTypedArray(JStarVM* vm, JStarArrayType type, size_t count) {
+    checkStack(vm);
+    if(count > typedArrayMaxCount(type)) {
+        jsrRaise(vm, "InvalidArgException", "Typed array of %zu elements is too large", count);
+        return NULL;
+    }
+    ObjTypedArray* arr = newTypedArray(vm, type, count);
+    push(vm, OBJ_VAL(arr));
+    return arr->data;
+}
+
+void* jsrPushByteArray(JStarVM* vm, size_t size) {
+    checkStack(vm);
+    ObjByteArray* arr = newByteArray(vm, size);
+    push(vm, OBJ_VAL(arr));
+    return arr->data;
+}
+
 bool jsrPushNative(JStarVM* vm, const char* moduleName, const char* name, JStarNative nat,
                    uint8_t argc) {
     checkStack(vm);
@@ -626,6 +790,23 @@ size_t jsrListGetLength(const JStarVM* vm, int slot) {
     return AS_LIST(lst)->count;
 }
 
+void jsrListExtendNumbers(JStarVM* vm, int slot, const double* numbers, size_t count) {
+    Value lstVal = apiStackSlot(vm, slot);
+    JSR_ASSERT(IS_LIST(lstVal), "Not a list");
+    ObjList* lst = AS_LIST(lstVal);
+    arrayReserveGC(vm, lst, lst->count + count);
+    numbersToValues(lst->items + lst->count, numbers, count);
+    lst->count += count;
+}
+
+bool jsrListGetNumbers(JStarVM* vm, int slot, size_t start, size_t count, double* out) {
+    Value lstVal = apiStackSlot(vm, slot);
+    JSR_ASSERT(IS_LIST(lstVal), "Not a list");
+    ObjList* lst = AS_LIST(lstVal);
+    JSR_ASSERT(start <= lst->count && count <= lst->count - start, "Out of bounds");
+    return valuesToNumbers(vm, lst->items, start, count, out, "List");
+}
+
 void jsrTupleGet(JStarVM* vm, size_t i, int slot) {
     Value tupVal = apiStackSlot(vm, slot);
     JSR_ASSERT(IS_TUPLE(tupVal), "Not a tuple");
@@ -640,6 +821,14 @@ size_t jsrTupleGetLength(const JStarVM* vm, int slot) {
     return AS_TUPLE(tup)->count;
 }
 
+bool jsrTupleGetNumbers(JStarVM* vm, int slot, size_t start, size_t count, double* out) {
+    Value tupVal = apiStackSlot(vm, slot);
+    JSR_ASSERT(IS_TUPLE(tupVal), "Not a tuple");
+    ObjTuple* tup = AS_TUPLE(tupVal);
+    JSR_ASSERT(start <= tup->count && count <= tup->count - start, "Out of bounds");
+    return valuesToNumbers(vm, tup->items, start, count, out, "Tuple");
+}
+
 // NOTE: jsrSubscriptGet and jsrSubscriptSet end up calling `invokeMethod` on the
 // generic overload path. If such overloads are J* functions instead of natives, we
 // must make sure to execute the pushed function frame. To do this, we use the same
@@ -697,7 +886,7 @@ bool jsrSetField(JStarVM* vm, int slot, const char* name) {
 
 bool jsrSetFieldCached(JStarVM* vm, int slot, const char* name, JStarSymbol* sym) {
     push(vm, apiStackSlot(vm, slot));
-    return setValueField(vm, copyCStringInterned(vm, name), &sym->sym);
+    return setValueField(vm, symbolName(vm, name, sym), &sym->sym);
 }
 
 bool jsrGetField(JStarVM* vm, int slot, const char* name) {
@@ -707,7 +896,7 @@ bool jsrGetField(JStarVM* vm, int slot, const char* name) {
 
 bool jsrGetFieldCached(JStarVM* vm, int slot, const char* name, JStarSymbol* sym) {
     push(vm, apiStackSlot(vm, slot));
-    return getValueField(vm, copyCStringInterned(vm, name), &sym->sym);
+    return getValueField(vm, symbolName(vm, name, sym), &sym->sym);
 }
 
 bool jsrImportModule(JStarVM* vm, const char* moduleName) {
@@ -732,9 +921,9 @@ bool jsrSetGlobal(JStarVM* vm, const char* moduleName, const char* name) {
 }
 
 bool jsrSetGlobalCached(JStarVM* vm, const char* moduleName, const char* name, JStarSymbol* sym) {
-    ObjModule* mod = getModuleOrRaise(vm, moduleName);
+    ObjModule* mod = getSymbolModuleOrRaise(vm, moduleName, sym);
     if(!mod) return false;
-    setGlobalName(vm, mod, copyCStringInterned(vm, name), &sym->sym);
+    setGlobalName(vm, mod, symbolName(vm, name, sym), &sym->sym);
     return true;
 }
 
@@ -744,9 +933,9 @@ bool jsrGetGlobal(JStarVM* vm, const char* moduleName, const char* name) {
 }
 
 bool jsrGetGlobalCached(JStarVM* vm, const char* moduleName, const char* name, JStarSymbol* sym) {
-    ObjModule* mod = getModuleOrRaise(vm, moduleName);
+    ObjModule* mod = getSymbolModuleOrRaise(vm, moduleName, sym);
     if(!mod) return false;
-    return getGlobalName(vm, mod, copyCStringInterned(vm, name), &sym->sym);
+    return getGlobalName(vm, mod, symbolName(vm, name, sym), &sym->sym);
 }
 
 void jsrBindNative(JStarVM* vm, int clsSlot, int natSlot) {
@@ -769,14 +958,32 @@ void* jsrGetUserdata(JStarVM* vm, int slot) {
     return (void*)AS_USERDATA(apiStackSlot(vm, slot))->data;
 }
 
+void* jsrGetTypedArray(JStarVM* vm, int slot, JStarArrayType* type, size_t* count) {
+    JSR_ASSERT(IS_TYPED_ARRAY(apiStackSlot(vm, slot)), "slot is not a typed array");
+    ObjTypedArray* arr = AS_TYPED_ARRAY(apiStackSlot(vm, slot));
+    if(type) *type = (JStarArrayType)arr->type;
+    if(count) *count = arr->count;
+    return arr->data;
+}
+
+void* jsrGetByteArray(JStarVM* vm, int slot, size_t* size) {
+    JSR_ASSERT(IS_BYTE_ARRAY(apiStackSlot(vm, slot)), "slot is not a ByteArray");
+    size_t length;
+    void* bytes = byteArrayBytes(AS_BYTE_ARRAY(apiStackSlot(vm, slot)), &length);
+    if(size) *size = length;
+    return bytes;
+}
+
 double jsrGetNumber(const JStarVM* vm, int slot) {
     JSR_ASSERT(IS_NUM(apiStackSlot(vm, slot)), "slot is not a Number");
     return AS_NUM(apiStackSlot(vm, slot));
 }
 
-const char* jsrGetString(const JStarVM* vm, int slot) {
+const char* jsrGetString(JStarVM* vm, int slot) {
     JSR_ASSERT(IS_STRING(apiStackSlot(vm, slot)), "slot is not a String");
-    return AS_STRING(apiStackSlot(vm, slot))->data;
+    ObjString* str = AS_STRING(apiStackSlot(vm, slot));
+    stringFlatten(vm, str);
+    return str->data;
 }
 
 size_t jsrGetStringSz(const JStarVM* vm, int slot) {
@@ -784,6 +991,13 @@ size_t jsrGetStringSz(const JStarVM* vm, int slot) {
     return AS_STRING(apiStackSlot(vm, slot))->length;
 }
 
+const char* jsrGetStringBytes(const JStarVM* vm, int slot, size_t* length) {
+    JSR_ASSERT(IS_STRING(apiStackSlot(vm, slot)), "slot is not a String");
+    ObjString* str = AS_STRING(apiStackSlot(vm, slot));
+    if(length) *length = str->length;
+    return str->data;
+}
+
 bool jsrGetBoolean(const JStarVM* vm, int slot) {
     JSR_ASSERT(IS_BOOL(apiStackSlot(vm, slot)), "slot is not a Boolean");
     return AS_BOOL(apiStackSlot(vm, slot));
@@ -844,6 +1058,16 @@ bool jsrIsUserdata(const JStarVM* vm, int slot) {
     return IS_USERDATA(val);
 }
 
+bool jsrIsTypedArray(const JStarVM* vm, int slot) {
+    Value val = apiStackSlot(vm, slot);
+    return IS_TYPED_ARRAY(val);
+}
+
+bool jsrIsByteArray(const JStarVM* vm, int slot) {
+    Value val = apiStackSlot(vm, slot);
+    return IS_BYTE_ARRAY(val);
+}
+
 bool jsrCheckNumber(JStarVM* vm, int slot, const char* name) {
     if(!jsrIsNumber(vm, slot)) JSR_RAISE(vm, "TypeException", "%s must be a number.", name);
     return true;
@@ -904,6 +1128,18 @@ bool jsrCheckUserdata(JStarVM* vm, int slot, const char* name) {
     return true;
 }
 
+bool jsrCheckTypedArray(JStarVM* vm, int slot, const char* name) {
+    if(!jsrIsTypedArray(vm, slot)) {
+        JSR_RAISE(vm, "TypeException", "%s must be a typed array.", name);
+    }
+    return true;
+}
+
+bool jsrCheckByteArray(JStarVM* vm, int slot, const char* name) {
+    if(!jsrIsByteArray(vm, slot)) JSR_RAISE(vm, "TypeException", "%s must be a ByteArray.", name);
+    return true;
+}
+
 size_t jsrCheckIndexNum(JStarVM* vm, double i, size_t max) {
     if(i >= 0 && i < max) return (size_t)i;
     jsrRaise(vm, "IndexOutOfBoundException", "%g.", i);
@@ -21,4 +21,8 @@
 // increased for each stack frame, leading to an overall increase in memory usage by the VM.
 #define MAX_HANDLERS 6
 
+// Minimum length for a String slice to reference the characters of its parent instead of copying
+// them. Copying short slices is cheaper, and avoids keeping big Strings alive through tiny ones.
+#define MIN_STRING_SLICE 64
+
 #endif
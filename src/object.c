@@ -25,8 +25,7 @@ const char* ObjTypeNames[] = {
 // OBJECT ALLOCATION FUNCTIONS
 // -----------------------------------------------------------------------------
 
-static Obj* newObj(JStarVM* vm, size_t size, ObjClass* cls, ObjType type) {
-    Obj* o = GC_ALLOC(vm, size);
+static Obj* initObj(JStarVM* vm, Obj* o, ObjClass* cls, ObjType type) {
     o->cls = cls;
     o->type = type;
     o->reached = false;
@@ -35,6 +34,10 @@ static Obj* newObj(JStarVM* vm, size_t size, ObjClass* cls, ObjType type) {
     return o;
 }
 
+static Obj* newObj(JStarVM* vm, size_t size, ObjClass* cls, ObjType type) {
+    return initObj(vm, GC_ALLOC(vm, size), cls, type);
+}
+
 static Obj* newVarObj(JStarVM* vm, size_t size, size_t varSize, size_t count, ObjClass* cls,
                       ObjType type) {
     return newObj(vm, size + varSize * count, cls, type);
@@ -227,6 +230,68 @@ ObjList* newList(JStarVM* vm, size_t capacity) {
     return lst;
 }
 
+static const CoreClass typedArrayClasses[] = {
+    [JSR_ARRAY_FLOAT64] = CORE_CLASS_FLOAT64_ARRAY,
+    [JSR_ARRAY_INT32] = CORE_CLASS_INT32_ARRAY,
+    [JSR_ARRAY_UINT8] = CORE_CLASS_UINT8_ARRAY,
+};
+
+ObjTypedArray* newTypedArray(JStarVM* vm, JStarArrayType type, size_t count) {
+    JSR_ASSERT(count <= typedArrayMaxCount(type), "Typed array too large");
+    size_t size = typedArrayElemSize(type) * count;
+    void* data = NULL;
+    if(count > 0) {
+        data = GC_ALLOC(vm, size);
+        memset(data, 0, size);
+    }
+
+    ObjClass* arrClass = vm->coreClasses[typedArrayClasses[type]];
+    ObjTypedArray* arr = (ObjTypedArray*)newObj(vm, sizeof(*arr), arrClass, OBJ_TYPED_ARRAY);
+    arr->type = type;
+    arr->count = count;
+    arr->data = data;
+    arr->parent = NULL;
+    return arr;
+}
+
+ObjTypedArray* newTypedArrayView(JStarVM* vm, ObjTypedArray* arr, size_t start, size_t length) {
+    JSR_ASSERT(start + length <= arr->count, "View out of bounds");
+    ObjTypedArray* view = (ObjTypedArray*)newObj(vm, sizeof(*view), arr->base.cls, OBJ_TYPED_ARRAY);
+    view->type = arr->type;
+    view->count = length;
+    view->data = (char*)arr->data + start * typedArrayElemSize(arr->type);
+    view->parent = arr->parent ? arr->parent : arr;
+    return view;
+}
+
+ObjByteArray* newByteArray(JStarVM* vm, size_t size) {
+    uint8_t* data = NULL;
+    if(size > 0) {
+        data = GC_ALLOC(vm, size);
+        memset(data, 0, size);
+    }
+
+    ObjClass* arrClass = vm->coreClasses[CORE_CLASS_BYTE_ARRAY];
+    ObjByteArray* arr = (ObjByteArray*)newObj(vm, sizeof(*arr), arrClass, OBJ_BYTE_ARRAY);
+    arr->size = size;
+    arr->capacity = size;
+    arr->data = data;
+    arr->offset = 0;
+    arr->parent = NULL;
+    return arr;
+}
+
+ObjByteArray* newByteArrayView(JStarVM* vm, ObjByteArray* arr, size_t start, size_t length) {
+    ObjClass* arrClass = vm->coreClasses[CORE_CLASS_BYTE_ARRAY];
+    ObjByteArray* view = (ObjByteArray*)newObj(vm, sizeof(*view), arrClass, OBJ_BYTE_ARRAY);
+    view->size = length;
+    view->capacity = 0;
+    view->data = NULL;
+    view->offset = arr->offset + start;
+    view->parent = arr->parent ? arr->parent : arr;
+    return view;
+}
+
 ObjTable* newTable(JStarVM* vm) {
     ObjClass* tableClass = vm->coreClasses[CORE_CLASS_TABLE];
     ObjTable* table = (ObjTable*)newObj(vm, sizeof(*table), tableClass, OBJ_TABLE);
@@ -238,30 +303,111 @@ ObjTable* newTable(JStarVM* vm) {
 }
 
 ObjString* newString(JStarVM* vm, size_t length) {
-    char* data = GC_ALLOC(vm, length + 1);
     ObjClass* strClass = vm->coreClasses[CORE_CLASS_STR];
-    ObjString* str = (ObjString*)newObj(vm, sizeof(*str), strClass, OBJ_STRING);
-    str->length = length;
-    str->hash = 0;
-    str->interned = false;
-    str->data = data;
-    str->data[str->length] = '\0';
-    return str;
+    ObjOwnedString* str = (ObjOwnedString*)newVarObj(vm, sizeof(*str), sizeof(char), length + 1,
+                                                     strClass, OBJ_STRING);
+    str->base.length = length;
+    str->base.hash = 0;
+    str->base.interned = false;
+    str->base.kind = STR_OWNED;
+    str->base.data = str->chars;
+    str->chars[length] = '\0';
+    return (ObjString*)str;
+}
+
+ObjString* newExternalString(JStarVM* vm, const char* data, size_t length,
+                             void (*release)(void* userData), void* userData) {
+    ObjClass* strClass = vm->coreClasses[CORE_CLASS_STR];
+    ObjExternalString* str = (ObjExternalString*)newObj(vm, sizeof(*str), strClass, OBJ_STRING);
+    str->base.length = length;
+    str->base.hash = 0;
+    str->base.interned = false;
+    str->base.kind = STR_EXTERNAL;
+    str->base.data = (char*)data;
+    str->release = release;
+    str->userData = userData;
+    str->flattened = false;
+    return (ObjString*)str;
+}
+
+static ObjString* newSlice(JStarVM* vm, ObjString* parent, char* data, size_t length) {
+    ObjClass* strClass = vm->coreClasses[CORE_CLASS_STR];
+    ObjSliceString* slice = (ObjSliceString*)newObj(vm, sizeof(*slice), strClass, OBJ_STRING);
+    slice->base.length = length;
+    slice->base.hash = 0;
+    slice->base.interned = false;
+    slice->base.kind = STR_SLICE;
+    slice->base.data = data;
+    slice->parent = parent;
+    return (ObjString*)slice;
+}
+
+ObjString* newStringSlice(JStarVM* vm, ObjString* str, size_t start, size_t length) {
+    JSR_ASSERT(start + length <= str->length, "Slice out of bounds");
+
+    if(length < MIN_STRING_SLICE) {
+        ObjString* copy = newString(vm, length);
+        memcpy(copy->data, str->data + start, length);
+        return copy;
+    }
+
+    // Reference the String that actually owns the characters, so that chains of slices don't keep
+    // intermediate Strings alive
+    ObjString* parent = str;
+    if(str->kind == STR_SLICE && ((ObjSliceString*)str)->parent) {
+        parent = ((ObjSliceString*)str)->parent;
+    }
+
+    return newSlice(vm, parent, str->data + start, length);
+}
+
+static ObjBufferString* newBufferString(JStarVM* vm, size_t capacity) {
+    char* data = GC_ALLOC(vm, capacity + 1);
+    ObjClass* strClass = vm->coreClasses[CORE_CLASS_STR];
+    ObjBufferString* buf = (ObjBufferString*)newObj(vm, sizeof(*buf), strClass, OBJ_STRING);
+    buf->base.length = 0;
+    buf->base.hash = 0;
+    buf->base.interned = false;
+    buf->base.kind = STR_BUFFER;
+    buf->base.data = data;
+    buf->base.data[0] = '\0';
+    buf->capacity = capacity;
+    return buf;
+}
+
+static void addToPool(JStarVM* vm, ObjString* str) {
+    str->interned = true;
+    hashTableValuePut(&vm->stringPool, str, NULL_VAL);
 }
 
 ObjString* copyStringInterned(JStarVM* vm, const void* data, size_t length) {
-    uint32_t hash = hashBytes(data, length);
+    uint32_t hash = stringHash(vm, data, length);
     ObjString* interned = hashTableValueGetString(&vm->stringPool, data, length, hash);
     if(interned == NULL) {
         interned = newString(vm, length);
         memcpy(interned->data, data, length);
         interned->hash = hash;
-        interned->interned = true;
-        hashTableValuePut(&vm->stringPool, interned, NULL_VAL);
+        addToPool(vm, interned);
     }
     return interned;
 }
 
+ObjString* stringIntern(JStarVM* vm, ObjString* str) {
+    if(str->interned) return str;
+
+    uint32_t hash = stringGetHash(vm, str);
+    ObjString* interned = hashTableValueGetString(&vm->stringPool, str->data, str->length, hash);
+    if(interned) return interned;
+
+    // Owned strings can join the pool as they are, the others would keep their memory alive
+    if(str->kind != STR_OWNED) {
+        return copyStringInterned(vm, str->data, str->length);
+    }
+
+    addToPool(vm, str);
+    return str;
+}
+
 ObjString* copyCStringInterned(JStarVM* vm, const char* str) {
     return copyStringInterned(vm, str, strlen(str));
 }
@@ -270,8 +416,41 @@ void freeObject(JStarVM* vm, Obj* o) {
     switch(o->type) {
     case OBJ_STRING: {
         ObjString* s = (ObjString*)o;
-        GC_FREE_ARRAY(vm, char, s->data, s->length + 1);
-        GC_FREE(vm, ObjString, s);
+        // The pool holds its strings weakly, so they leave it when they are collected
+        if(s->interned) {
+            hashTableValueDel(&vm->stringPool, s);
+        }
+
+        switch(s->kind) {
+        case STR_OWNED:
+            GC_FREE_VAR(vm, ObjOwnedString, char, s->length + 1, s);
+            break;
+        case STR_EXTERNAL: {
+            ObjExternalString* ext = (ObjExternalString*)s;
+            if(ext->flattened) {
+                GC_FREE_ARRAY(vm, char, s->data, s->length + 1);
+            }
+            if(ext->release) {
+                ext->release(ext->userData);
+            }
+            GC_FREE(vm, ObjExternalString, ext);
+            break;
+        }
+        case STR_SLICE: {
+            ObjSliceString* slice = (ObjSliceString*)s;
+            if(!slice->parent) {
+                GC_FREE_ARRAY(vm, char, s->data, s->length + 1);
+            }
+            GC_FREE(vm, ObjSliceString, slice);
+            break;
+        }
+        case STR_BUFFER: {
+            ObjBufferString* buf = (ObjBufferString*)s;
+            GC_FREE_ARRAY(vm, char, s->data, buf->capacity + 1);
+            GC_FREE(vm, ObjBufferString, buf);
+            break;
+        }
+        }
         break;
     }
     case OBJ_NATIVE: {
@@ -360,6 +539,22 @@ void freeObject(JStarVM* vm, Obj* o) {
         GC_FREE_VAR(vm, ObjUserdata, uint8_t, udata->size, udata);
         break;
     }
+    case OBJ_TYPED_ARRAY: {
+        ObjTypedArray* arr = (ObjTypedArray*)o;
+        if(!arr->parent && arr->data) {
+            GC_FREE_ARRAY(vm, char, arr->data, typedArrayElemSize(arr->type) * arr->count);
+        }
+        GC_FREE(vm, ObjTypedArray, arr);
+        break;
+    }
+    case OBJ_BYTE_ARRAY: {
+        ObjByteArray* arr = (ObjByteArray*)o;
+        if(arr->data) {
+            GC_FREE_ARRAY(vm, uint8_t, arr->data, arr->capacity);
+        }
+        GC_FREE(vm, ObjByteArray, arr);
+        break;
+    }
     }
 }
 
@@ -487,17 +682,134 @@ void listRemove(ObjList* lst, size_t index) {
     lst->count--;
 }
 
-uint32_t stringGetHash(ObjString* str) {
+void byteArrayReserve(JStarVM* vm, ObjByteArray* arr, size_t capacity) {
+    JSR_ASSERT(!arr->parent, "Cannot grow a ByteArray view");
+    if(capacity <= arr->capacity) return;
+
+    // Stop doubling before overflowing, and allocate exactly `capacity` bytes instead
+    size_t newCapacity = arr->capacity ? arr->capacity : ARRAY_INIT_CAP;
+    while(newCapacity < capacity) {
+        if(newCapacity > SIZE_MAX / 2) {
+            newCapacity = capacity;
+            break;
+        }
+        newCapacity *= 2;
+    }
+
+    arr->data = gcAlloc(vm, arr->data, arr->capacity, newCapacity);
+    arr->capacity = newCapacity;
+}
+
+void byteArrayResize(JStarVM* vm, ObjByteArray* arr, size_t size) {
+    byteArrayReserve(vm, arr, size);
+    if(size > arr->size) {
+        memset(arr->data + arr->size, 0, size - arr->size);
+    }
+    arr->size = size;
+}
+
+void byteArrayAppend(JStarVM* vm, ObjByteArray* arr, const void* data, size_t length) {
+    if(length == 0) return;
+    JSR_ASSERT(length <= SIZE_MAX - arr->size, "ByteArray too large");
+    byteArrayReserve(vm, arr, arr->size + length);
+    memcpy(arr->data + arr->size, data, length);
+    arr->size += length;
+}
+
+uint32_t stringHash(JStarVM* vm, const char* data, size_t length) {
+    uint32_t hash = hashBytes(data, length, vm->hashSeed);
+    return hash ? hash : hash + 1;  // Reserve hash value `0`
+}
+
+uint32_t stringGetHash(JStarVM* vm, ObjString* str) {
     if(str->hash == 0) {
-        uint32_t hash = hashBytes(str->data, str->length);
-        str->hash = hash ? hash : hash + 1;  // Reserve hash value `0`
+        str->hash = stringHash(vm, str->data, str->length);
     }
     return str->hash;
 }
 
 bool stringEquals(ObjString* s1, ObjString* s2) {
-    if(s1->interned && s2->interned) return s1 == s2;
-    return s1->length == s2->length && memcmp(s1->data, s2->data, s1->length) == 0;
+    if(s1 == s2) return true;
+    if(s1->interned && s2->interned) return false;
+    if(s1->length != s2->length) return false;
+    if(s1->hash && s2->hash && s1->hash != s2->hash) return false;
+    return memcmp(s1->data, s2->data, s1->length) == 0;
+}
+
+// Returns the buffer of `str` if `str` is a slice at the end of its used part, NULL otherwise
+static ObjBufferString* appendableBuffer(ObjString* str) {
+    if(str->kind != STR_SLICE) return NULL;
+
+    ObjString* parent = ((ObjSliceString*)str)->parent;
+    if(!parent || parent->kind != STR_BUFFER) return NULL;
+    if(str->data + str->length != parent->data + parent->length) return NULL;
+
+    return (ObjBufferString*)parent;
+}
+
+ObjString* stringConcat(JStarVM* vm, ObjString* s1, ObjString* s2) {
+    size_t length = s1->length + s2->length;
+
+    // The characters past the end of `s1` are not used by any String, so we can append in place
+    ObjBufferString* buf = appendableBuffer(s1);
+    if(buf && buf->capacity - buf->base.length >= s2->length) {
+        memcpy(buf->base.data + buf->base.length, s2->data, s2->length);
+        buf->base.length += s2->length;
+        buf->base.data[buf->base.length] = '\0';
+        return newSlice(vm, (ObjString*)buf, s1->data, length);
+    }
+
+    if(length < MIN_STRING_SLICE) {
+        ObjString* result = newString(vm, length);
+        memcpy(result->data, s1->data, s1->length);
+        memcpy(result->data + s1->length, s2->data, s2->length);
+        return result;
+    }
+
+    // Only leave room for further concatenations once `s1` has proven to be the result of one, so
+    // that one-off concatenations don't pay for spare capacity they never use
+    buf = newBufferString(vm, buf ? length * 2 : length);
+    memcpy(buf->base.data, s1->data, s1->length);
+    memcpy(buf->base.data + s1->length, s2->data, s2->length);
+    buf->base.length = length;
+    buf->base.data[length] = '\0';
+
+    push(vm, OBJ_VAL(buf));
+    ObjString* result = newSlice(vm, (ObjString*)buf, buf->base.data, length);
+    pop(vm);
+
+    return result;
+}
+
+static char* copyData(JStarVM* vm, ObjString* str) {
+    char* data = GC_ALLOC(vm, str->length + 1);
+    memcpy(data, str->data, str->length);
+    data[str->length] = '\0';
+    return data;
+}
+
+void stringFlatten(JStarVM* vm, ObjString* str) {
+    switch(str->kind) {
+    case STR_OWNED:
+    case STR_BUFFER:
+        return;
+    case STR_EXTERNAL: {
+        // The embedder's memory is released only on collection, as slices may still reference it
+        ObjExternalString* ext = (ObjExternalString*)str;
+        if(ext->flattened) return;
+        str->data = copyData(vm, str);
+        ext->flattened = true;
+        return;
+    }
+    case STR_SLICE: {
+        // Drop the reference to the parent, so that it can be collected
+        ObjSliceString* slice = (ObjSliceString*)str;
+        if(!slice->parent) return;
+        str->data = copyData(vm, str);
+        slice->parent = NULL;
+        return;
+    }
+    }
 }
 
 void stacktraceDumpFrame(JStarVM* vm, ObjStackTrace* st, Frame* f) {
@@ -566,17 +878,23 @@ FunctionBase* getFunctionBase(Obj* fn) {
 }
 
 ObjString* jsrBufferToString(JStarBuffer* b) {
-    // Shrink to fit the buffer
-    char* data = gcAlloc(b->vm, b->data, b->capacity, b->size + 1);
-    ObjClass* strClass = b->vm->coreClasses[CORE_CLASS_STR];
-    ObjString* s = (ObjString*)newObj(b->vm, sizeof(*s), strClass, OBJ_STRING);
-    s->interned = false;
-    s->length = b->size;
-    s->data = data;
-    s->hash = 0;
-    s->data[s->length] = '\0';
+    JStarVM* vm = b->vm;
+    size_t length = b->size;
+
+    // Turn the buffer's memory into the String, moving the characters after the header
+    size_t size = sizeof(ObjOwnedString) + length + 1;
+    ObjOwnedString* s = gcAlloc(vm, b->data, b->capacity, size);
+    memmove(s->chars, s, length);
     *b = (JStarBuffer){0};
-    return s;
+
+    initObj(vm, (Obj*)s, vm->coreClasses[CORE_CLASS_STR], OBJ_STRING);
+    s->base.length = length;
+    s->base.hash = 0;
+    s->base.interned = false;
+    s->base.kind = STR_OWNED;
+    s->base.data = s->chars;
+    s->chars[length] = '\0';
+    return (ObjString*)s;
 }
 
 // -----------------------------------------------------------------------------
@@ -699,5 +1017,26 @@ void printObj(Obj* o) {
     case OBJ_USERDATA:
         printf("<userdata %p", (void*)o);
         break;
+    case OBJ_TYPED_ARRAY: {
+        ObjTypedArray* arr = (ObjTypedArray*)o;
+        printf("%s[", o->cls->name->data);
+        for(size_t i = 0; i < arr->count; i++) {
+            printf("%g", typedArrayGet(arr, i));
+            if(i != arr->count - 1) printf(", ");
+        }
+        printf("]");
+        break;
+    }
+    case OBJ_BYTE_ARRAY: {
+        size_t size;
+        const uint8_t* bytes = byteArrayBytes((ObjByteArray*)o, &size);
+        printf("ByteArray[");
+        for(size_t i = 0; i < size; i++) {
+            printf("%d", bytes[i]);
+            if(i != size - 1) printf(", ");
+        }
+        printf("]");
+        break;
+    }
     }
 }
@@ -1,6 +1,7 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -48,6 +49,8 @@ struct Frame;
 #define IS_STACK_TRACE(o)  (IS_OBJ(o) && AS_OBJ(o)->type == OBJ_STACK_TRACE)
 #define IS_TABLE(o)        (IS_OBJ(o) && AS_OBJ(o)->type == OBJ_TABLE)
 #define IS_USERDATA(o)     (IS_OBJ(o) && AS_OBJ(o)->type == OBJ_USERDATA)
+#define IS_TYPED_ARRAY(o)  (IS_OBJ(o) && AS_OBJ(o)->type == OBJ_TYPED_ARRAY)
+#define IS_BYTE_ARRAY(o)   (IS_OBJ(o) && AS_OBJ(o)->type == OBJ_BYTE_ARRAY)
 
 // Object casting macros
 #define AS_BOUND_METHOD(o) ((ObjBoundMethod*)AS_OBJ(o))
@@ -64,6 +67,8 @@ struct Frame;
 #define AS_STACK_TRACE(o)  ((ObjStackTrace*)AS_OBJ(o))
 #define AS_TABLE(o)        ((ObjTable*)AS_OBJ(o))
 #define AS_USERDATA(o)     ((ObjUserdata*)AS_OBJ(o))
+#define AS_TYPED_ARRAY(o)  ((ObjTypedArray*)AS_OBJ(o))
+#define AS_BYTE_ARRAY(o)   ((ObjByteArray*)AS_OBJ(o))
 
 // Object type.
 // These types are used internally by the object system and are never
@@ -85,7 +90,9 @@ struct Frame;
     X(OBJ_UPVALUE)      \
     X(OBJ_TUPLE)        \
     X(OBJ_TABLE)        \
-    X(OBJ_USERDATA)
+    X(OBJ_USERDATA)     \
+    X(OBJ_TYPED_ARRAY)  \
+    X(OBJ_BYTE_ARRAY)
 
 typedef enum ObjType {
 #define ENUM_ELEM(elem) elem,
@@ -114,18 +121,62 @@ typedef struct Obj {
     struct Obj* next;      // Next object in the linked list of all allocated objects
 } Obj;
 
+// How the characters of a String are stored
+typedef enum StringKind {
+    STR_OWNED,     // Allocated by the VM
+    STR_EXTERNAL,  // Provided by the embedder (see `ObjExternalString`)
+    STR_SLICE,     // Borrowed from another String (see `ObjSliceString`)
+    STR_BUFFER,    // Growable buffer backing concatenations (see `ObjBufferString`)
+} StringKind;
+
 // A J* String. In J* Strings are immutable and can contain arbitrary
 // bytes since we explicitly store the string's length instead of relying on
-// NUL termination. Nevertheless, a NUL byte is appended for ease of use in
-// the C api.
+// NUL termination. Nevertheless, a NUL byte is appended to strings allocated
+// by the VM for ease of use in the C api. Strings of other kinds are not NUL
+// terminated, use `stringFlatten` if needed.
 typedef struct ObjString {
     Obj base;
     size_t length;  // Length of the string
-    uint32_t hash;  // The string's hash (gets calculated once at allocation)
+    uint32_t hash;  // The string's hash (computed lazily, 0 if not yet computed)
     bool interned;  // Whether the string is interned or not
-    char* data;     // The actual data of the string (NUL terminated)
+    uint8_t kind;   // How the data of the string is stored (a `StringKind`)
+    char* data;     // The actual data of the string
 } ObjString;
 
+// A String allocated by the VM. The characters are stored inline right after the header, so that
+// the String takes a single allocation and its data shares the cache lines of the header.
+typedef struct ObjOwnedString {
+    ObjString base;
+    char chars[];  // The characters of the string, `data` points here
+} ObjOwnedString;
+
+// A String referencing memory owned by the embedder, that is released through a callback when the
+// String is collected. Once flattened, `data` points to a NUL terminated copy owned by the VM.
+typedef struct ObjExternalString {
+    ObjString base;
+    void (*release)(void* userData);  // Releases the embedder's memory (can be NULL)
+    void* userData;                   // Data passed to `release`
+    bool flattened;                   // Whether `data` has been copied in VM memory
+} ObjExternalString;
+
+// A String referencing a range of the characters of another String, which is kept alive until the
+// slice is flattened. Slices always reference an owned or external String, never another slice.
+typedef struct ObjSliceString {
+    ObjString base;
+    ObjString* parent;  // The String owning the characters, NULL once flattened
+} ObjSliceString;
+
+// The growable storage of the results of String concatenation, which are slices of it. When the
+// left operand of a concatenation ends where the used part of its buffer ends, the right operand
+// is appended in place, making repeated concatenation linear instead of quadratic. A buffer is
+// allocated with no spare capacity, and is replaced by one of twice the size when a full buffer is
+// appended to. Buffers are never exposed to J* code, and `length` is the number of characters used
+// so far.
+typedef struct ObjBufferString {
+    ObjString base;
+    size_t capacity;  // Number of characters that fit in the buffer, excluding the NUL terminator
+} ObjBufferString;
+
 // A J* module. Modules are the runtime representation of a J* file.
 typedef struct ObjModule {
     Obj base;
@@ -209,6 +260,30 @@ typedef struct ObjTable {
     TableEntry* entries;  // The actual array of entries
 } ObjTable;
 
+// A J* typed array. Typed arrays are fixed size sequences of unboxed numbers of the same type,
+// stored contiguously. A view shares a range of the elements of another array, which is kept
+// alive as long as the view is. Since the elements never move, they can be handed out to C code.
+typedef struct ObjTypedArray {
+    Obj base;
+    uint8_t type;                  // The type of the elements (a `JStarArrayType`)
+    size_t count;                  // Number of elements
+    void* data;                    // The elements
+    struct ObjTypedArray* parent;  // The array owning the elements of a view, NULL otherwise
+} ObjTypedArray;
+
+// A J* ByteArray. ByteArrays are mutable, growable sequences of bytes stored contiguously.
+// A view shares a range of the bytes of another ByteArray, which is kept alive as long as the view
+// is. Since the bytes move when an array grows, views store their offset in the array instead of
+// a pointer, and they are clipped to the current size of the array if it shrinks.
+typedef struct ObjByteArray {
+    Obj base;
+    size_t size;                  // Number of bytes (for views, the size at creation)
+    size_t capacity;              // Number of allocated bytes (0 for views)
+    uint8_t* data;                // The bytes (NULL for views)
+    size_t offset;                // Offset of the first byte of a view in `parent`
+    struct ObjByteArray* parent;  // The array owning the bytes of a view, NULL otherwise
+} ObjByteArray;
+
 // A bound method. It contains a method with an associated target.
 typedef struct ObjBoundMethod {
     Obj base;
@@ -323,6 +398,16 @@ ObjList* newList(JStarVM* vm, size_t capacity);
 ObjTuple* newTuple(JStarVM* vm, size_t size);
 ObjStackTrace* newStackTrace(JStarVM* vm);
 ObjTable* newTable(JStarVM* vm);
+// Allocates a typed array of `count` elements initialized to zero.
+ObjTypedArray* newTypedArray(JStarVM* vm, JStarArrayType type, size_t count);
+// Returns a view of `length` elements of `arr` starting at `start`, sharing its elements.
+// `arr` must be reachable.
+ObjTypedArray* newTypedArrayView(JStarVM* vm, ObjTypedArray* arr, size_t start, size_t length);
+// Allocates a ByteArray of `size` bytes initialized to zero.
+ObjByteArray* newByteArray(JStarVM* vm, size_t size);
+// Returns a view of `length` bytes of `arr` starting at `start`, sharing its bytes.
+// `arr` must be reachable.
+ObjByteArray* newByteArrayView(JStarVM* vm, ObjByteArray* arr, size_t start, size_t length);
 // Allocates a string of size `length + 1` and adds a NUL terminator to it.
 // Rest of buffer is left uninitialized.
 ObjString* newString(JStarVM* vm, size_t length);
@@ -330,6 +415,15 @@ ObjString* newString(JStarVM* vm, size_t length);
 ObjString* copyStringInterned(JStarVM* vm, const void* data, size_t length);
 // Copies a c-string into a J* string. The string is automatically interned.
 ObjString* copyCStringInterned(JStarVM* vm, const char* str);
+// Returns the interned version of `str`. If an equal string is not interned yet, an owned `str`
+// is added to the pool as is, while other kinds of strings are copied. `str` must be reachable.
+ObjString* stringIntern(JStarVM* vm, ObjString* str);
+// Creates a string referencing `length` bytes of embedder memory, without copying them.
+ObjString* newExternalString(JStarVM* vm, const char* data, size_t length,
+                             void (*release)(void* userData), void* userData);
+// Returns the substring of `str` of `length` characters starting at `start`. Long substrings are
+// returned as slices referencing the characters of `str`, short ones are copied.
+ObjString* newStringSlice(JStarVM* vm, ObjString* str, size_t start, size_t length);
 
 // Release the object's memory. It uses gcAlloc internally to let the GC know
 void freeObject(JStarVM* vm, Obj* o);
@@ -359,8 +453,99 @@ void listInsert(JStarVM* vm, ObjList* lst, size_t index, Value val);
 void listRemove(ObjList* lst, size_t index);
 
 // ObjString functions
-uint32_t stringGetHash(ObjString* str);
+// Hashes `length` bytes of string data with the seed of the VM. Never returns `0`
+uint32_t stringHash(JStarVM* vm, const char* data, size_t length);
+uint32_t stringGetHash(JStarVM* vm, ObjString* str);
 bool stringEquals(ObjString* s1, ObjString* s2);
+// Concatenates two strings, reusing the spare capacity of the buffer of `s1` if possible. Both
+// strings must be reachable.
+ObjString* stringConcat(JStarVM* vm, ObjString* s1, ObjString* s2);
+// Makes sure the data of the string is stored in VM memory and NUL terminated, copying it if
+// needed. Since it allocates, the string must be reachable.
+void stringFlatten(JStarVM* vm, ObjString* str);
+
+// ObjTypedArray functions
+
+static inline size_t typedArrayElemSize(JStarArrayType type) {
+    switch(type) {
+    case JSR_ARRAY_FLOAT64:
+        return sizeof(double);
+    case JSR_ARRAY_INT32:
+        return sizeof(int32_t);
+    case JSR_ARRAY_UINT8:
+        return sizeof(uint8_t);
+    }
+    JSR_UNREACHABLE();
+}
+
+// Maximum number of elements of a typed array of type `type`, so that its size in bytes fits in a
+// `size_t`
+static inline size_t typedArrayMaxCount(JStarArrayType type) {
+    return SIZE_MAX / typedArrayElemSize(type);
+}
+
+// Converts a Number to an integer element, truncating it and wrapping it modulo 2^32.
+// Non-finite Numbers are converted to 0.
+static inline uint32_t typedArrayToInt(double num) {
+    if(num > INT32_MIN - 1.0 && num < INT32_MAX + 1.0) return (uint32_t)(int32_t)num;
+    if(!isfinite(num)) return 0;
+    num = fmod(trunc(num), 4294967296.0);
+    return (uint32_t)(num < 0 ? num + 4294967296.0 : num);
+}
+
+static inline double typedArrayGet(const ObjTypedArray* arr, size_t i) {
+    switch((JStarArrayType)arr->type) {
+    case JSR_ARRAY_FLOAT64:
+        return ((const double*)arr->data)[i];
+    case JSR_ARRAY_INT32:
+        return ((const int32_t*)arr->data)[i];
+    case JSR_ARRAY_UINT8:
+        return ((const uint8_t*)arr->data)[i];
+    }
+    JSR_UNREACHABLE();
+}
+
+static inline void typedArraySet(ObjTypedArray* arr, size_t i, double num) {
+    switch((JStarArrayType)arr->type) {
+    case JSR_ARRAY_FLOAT64:
+        ((double*)arr->data)[i] = num;
+        return;
+    case JSR_ARRAY_INT32:
+        ((int32_t*)arr->data)[i] = (int32_t)typedArrayToInt(num);
+        return;
+    case JSR_ARRAY_UINT8:
+        ((uint8_t*)arr->data)[i] = (uint8_t)typedArrayToInt(num);
+        return;
+    }
+    JSR_UNREACHABLE();
+}
+
+// ObjByteArray functions
+
+// Returns the bytes of `arr`, storing their number in `size`. The pointer is invalidated when the
+// array owning the bytes grows.
+static inline uint8_t* byteArrayBytes(const ObjByteArray* arr, size_t* size) {
+    if(!arr->parent) {
+        *size = arr->size;
+        return arr->data;
+    }
+
+    const ObjByteArray* root = arr->parent;
+    size_t avail = root->size > arr->offset ? root->size - arr->offset : 0;
+    *size = arr->size < avail ? arr->size : avail;
+    return *size ? root->data + arr->offset : root->data;
+}
+
+// Makes room for at least `capacity` bytes. `arr` must not be a view, and must be reachable.
+void byteArrayReserve(JStarVM* vm, ObjByteArray* arr, size_t capacity);
+
+// Resizes `arr` to `size` bytes, zeroing the new ones. `arr` must not be a view, and must be
+// reachable.
+void byteArrayResize(JStarVM* vm, ObjByteArray* arr, size_t size);
+
+// Appends `length` bytes to the end of `arr`. `data` must not point into the bytes of `arr`, as
+// they can move. `arr` must not be a view, and must be reachable.
+void byteArrayAppend(JStarVM* vm, ObjByteArray* arr, const void* data, size_t length);
 
 // ObjStacktrace functions
 void stacktraceDumpFrame(JStarVM* vm, ObjStackTrace* st, struct Frame* f);
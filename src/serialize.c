@@ -20,6 +20,10 @@
 
 #define MAGIC 0xb5
 
+// Alignment of the bytecode sections relative to the start of the compiled chunk.
+// Lets the VM execute the bytecode in place, for example from a memory mapped file.
+#define BYTECODE_ALIGN 8
+
 typedef enum ConstType {
     CONST_NUM = 1,
     CONST_BOOL,
@@ -53,6 +57,12 @@ static void serializeByte(JStarBuffer* buf, uint8_t byte) {
     write(buf, &byte, sizeof(uint8_t));
 }
 
+static void serializePadding(JStarBuffer* buf, size_t align) {
+    while(buf->size % align != 0) {
+        serializeByte(buf, 0);
+    }
+}
+
 static void serializeDouble(JStarBuffer* buf, double num) {
     serializeUint64(buf, REINTERPRET_CAST(double, uint64_t, num));
 }
@@ -130,6 +140,7 @@ static void serializeCode(JStarBuffer* buf, const Code* c) {
     // TODO: store (compressed) line information? maybe give option in application
 
     serializeUint64(buf, c->bytecode.count);
+    serializePadding(buf, BYTECODE_ALIGN);
     write(buf, c->bytecode.items, c->bytecode.count);
 
     serializeConstants(buf, c->consts);
@@ -137,10 +148,19 @@ static void serializeCode(JStarBuffer* buf, const Code* c) {
 }
 
 static void serializeFunction(JStarBuffer* buf, const ObjFunction* f) {
+    JSR_ASSERT(!f->code.lazyChunk, "Cannot serialize a function whose code is not loaded");
+
     serializeFunctionBase(buf, &f->base);
     serializeByte(buf, f->upvalueCount);
     serializeShort(buf, f->stackUsage);
+
+    // Prefix the code with its size, so that the deserializer can skip over it and load it lazily
+    size_t sizeOffset = buf->size;
+    serializeUint64(buf, 0);
     serializeCode(buf, &f->code);
+
+    uint64_t codeSize = htobe64((uint64_t)(buf->size - sizeOffset - sizeof(uint64_t)));
+    memcpy(buf->data + sizeOffset, &codeSize, sizeof(uint64_t));
 }
 
 JStarBuffer serialize(JStarVM* vm, const ObjFunction* fn) {
@@ -156,6 +176,7 @@ JStarBuffer serialize(JStarVM* vm, const ObjFunction* fn) {
     write(&buf, HEADER, sizeof(HEADER));
     serializeByte(&buf, JSTAR_VERSION_MAJOR);
     serializeByte(&buf, JSTAR_VERSION_MINOR);
+    serializeByte(&buf, JSTAR_BYTECODE_VERSION);
     serializeFunction(&buf, fn);
 
     jsrBufferShrinkToFit(&buf);
@@ -174,6 +195,8 @@ typedef struct Deserializer {
     size_t len;
     ObjModule* mod;
     size_t ptr;
+    bool borrow;
+    Obj* owner;
 } Deserializer;
 
 static bool read(Deserializer* d, void* dest, size_t size) {
@@ -185,6 +208,15 @@ static bool read(Deserializer* d, void* dest, size_t size) {
     return true;
 }
 
+static bool skipPadding(Deserializer* d, size_t align) {
+    size_t padding = (align - d->ptr % align) % align;
+    if(d->ptr + padding > d->len) {
+        return false;
+    }
+    d->ptr += padding;
+    return true;
+}
+
 static bool isExhausted(Deserializer* d) {
     return d->ptr == d->len;
 }
@@ -303,7 +335,7 @@ static bool deserializeFunctionBase(Deserializer* d, FunctionBase* fn) {
     return true;
 }
 
-static bool deserializeFunction(Deserializer* d, ObjFunction** out);
+static bool deserializeFunction(Deserializer* d, bool lazy, ObjFunction** out);
 
 static bool deserializeNative(Deserializer* d, ObjNative** out) {
     JStarVM* vm = d->vm;
@@ -338,8 +370,9 @@ static bool deserializeConstants(Deserializer* d, Values* consts) {
 
         switch((ConstType)constType) {
         case CONST_FUN: {
+            // Nested functions are loaded lazily only if their code outlives them
             ObjFunction* fn;
-            if(!deserializeFunction(d, &fn)) return false;
+            if(!deserializeFunction(d, d->borrow, &fn)) return false;
             consts->items[consts->count++] = OBJ_VAL(fn);
             break;
         }
@@ -377,9 +410,19 @@ static bool deserializeSymbols(Deserializer* d, Symbols* s) {
 static bool deserializeCode(Deserializer* d, Code* c) {
     uint64_t codeSize;
     if(!deserializeUint64(d, &codeSize)) return false;
-
-    arrayReserve(d->vm, &c->bytecode, codeSize);
-    if(!read(d, c->bytecode.items, codeSize)) return false;
+    if(!skipPadding(d, BYTECODE_ALIGN)) return false;
+
+    if(d->borrow) {
+        // Reference the bytecode in place, without copying it
+        if(d->ptr + codeSize > d->len) return false;
+        c->bytecode.items = (uint8_t*)(d->code + d->ptr);
+        c->externalBytecode = true;
+        c->owner = d->owner;
+        d->ptr += codeSize;
+    } else {
+        arrayReserve(d->vm, &c->bytecode, codeSize);
+        if(!read(d, c->bytecode.items, codeSize)) return false;
+    }
     c->bytecode.count = codeSize;
 
     if(!deserializeConstants(d, &c->consts)) return false;
@@ -388,7 +431,7 @@ static bool deserializeCode(Deserializer* d, Code* c) {
     return true;
 }
 
-static bool deserializeFunction(Deserializer* d, ObjFunction** out) {
+static bool deserializeFunction(Deserializer* d, bool lazy, ObjFunction** out) {
     JStarVM* vm = d->vm;
     ObjModule* mod = d->mod;
 
@@ -402,7 +445,23 @@ static bool deserializeFunction(Deserializer* d, ObjFunction** out) {
     if(!deserializeByte(d, &fn->upvalueCount)) goto error;
     if(!deserializeShort(d, &stackUsage)) goto error;
     fn->stackUsage = stackUsage;
-    if(!deserializeCode(d, &fn->code)) goto error;
+
+    uint64_t codeSize;
+    if(!deserializeUint64(d, &codeSize)) goto error;
+    if(codeSize > d->len - d->ptr) goto error;
+    size_t codeEnd = d->ptr + codeSize;
+
+    if(lazy) {
+        // Only record where the code is, it will be deserialized on the first call
+        fn->code.lazyChunk = d->code;
+        fn->code.lazyStart = d->ptr;
+        fn->code.lazyEnd = codeEnd;
+        fn->code.owner = d->owner;
+        d->ptr = codeEnd;
+    } else {
+        if(!deserializeCode(d, &fn->code)) goto error;
+        if(d->ptr != codeEnd) goto error;
+    }
 
     *out = fn;
     pop(vm);
@@ -413,11 +472,11 @@ error:
     return false;
 }
 
-JStarResult deserialize(JStarVM* vm, ObjModule* mod, const void* code, size_t len,
-                        ObjFunction** out) {
+JStarResult deserialize(JStarVM* vm, ObjModule* mod, const void* code, size_t len, bool borrow,
+                        Obj* owner, ObjFunction** out) {
     PROFILE_FUNC();
 
-    Deserializer d = {vm, code, len, mod, 0};
+    Deserializer d = {vm, code, len, mod, 0, borrow, owner};
 
     uint8_t magic[sizeof(HEADER)];
     if(!read(&d, magic, sizeof(magic))) {
@@ -428,16 +487,18 @@ JStarResult deserialize(JStarVM* vm, ObjModule* mod, const void* code, size_t le
         return JSR_DESERIALIZE_ERR;
     }
 
-    uint8_t versionMajor, versionMinor;
-    if(!deserializeByte(&d, &versionMajor) || !deserializeByte(&d, &versionMinor)) {
+    uint8_t versionMajor, versionMinor, bytecodeVersion;
+    if(!deserializeByte(&d, &versionMajor) || !deserializeByte(&d, &versionMinor) ||
+       !deserializeByte(&d, &bytecodeVersion)) {
         return JSR_DESERIALIZE_ERR;
     }
 
-    if(versionMajor != JSTAR_VERSION_MAJOR || versionMinor != JSTAR_VERSION_MINOR) {
+    if(versionMajor != JSTAR_VERSION_MAJOR || versionMinor != JSTAR_VERSION_MINOR ||
+       bytecodeVersion != JSTAR_BYTECODE_VERSION) {
         return JSR_VERSION_ERR;
     }
 
-    if(!deserializeFunction(&d, out)) {
+    if(!deserializeFunction(&d, false, out)) {
         return JSR_DESERIALIZE_ERR;
     }
 
@@ -448,6 +509,38 @@ JStarResult deserialize(JStarVM* vm, ObjModule* mod, const void* code, size_t le
     return JSR_SUCCESS;
 }
 
+bool deserializeLazyCode(JStarVM* vm, ObjFunction* fn) {
+    PROFILE_FUNC();
+
+    Code* c = &fn->code;
+    JSR_ASSERT(c->lazyChunk, "Function code already loaded");
+
+    const uint8_t* chunk = c->lazyChunk;
+    size_t start = c->lazyStart, end = c->lazyEnd;
+    Deserializer d = {vm, chunk, end, fn->base.module, start, true, c->owner};
+
+    // Push as gc root
+    jsrEnsureStack(vm, 1);
+    push(vm, OBJ_VAL(fn));
+
+    c->lazyChunk = NULL;
+    bool res = deserializeCode(&d, c) && isExhausted(&d);
+
+    if(!res) {
+        // Restore the function to its original state, so that it can be safely collected
+        Obj* owner = c->owner;
+        freeCode(vm, c);
+        initCode(c);
+        c->lazyChunk = chunk;
+        c->lazyStart = start;
+        c->lazyEnd = end;
+        c->owner = owner;
+    }
+
+    pop(vm);
+    return res;
+}
+
 bool isCompiledCode(const void* code, size_t len) {
     if(len < sizeof(HEADER)) return false;
     return memcmp(code, HEADER, sizeof(HEADER)) == 0;
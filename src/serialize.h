@@ -8,8 +8,20 @@
 #include "object.h"
 
 JStarBuffer serialize(JStarVM* vm, const ObjFunction* f);
-JStarResult deserialize(JStarVM* vm, ObjModule* mod, const void* code, size_t len,
-                        ObjFunction** out);
+
+// Deserialize a compiled chunk into a function.
+// If `borrow` is true, the functions' bytecode references `code` in place instead of being copied,
+// so `code` must outlive them. In this case `owner`, if not NULL, is an object that keeps `code`
+// alive and that will be reached by the GC as long as the functions are reachable.
+// Borrowed nested functions are also loaded lazily: only their signature is deserialized, while
+// their code is deserialized on the first call (see `deserializeLazyCode`).
+JStarResult deserialize(JStarVM* vm, ObjModule* mod, const void* code, size_t len, bool borrow,
+                        Obj* owner, ObjFunction** out);
+
+// Deserialize the code of a nested function that was lazily loaded by `deserialize`, i.e. whose
+// `code.lazyChunk` field is set. Returns false if the code is malformed, leaving `fn` unchanged.
+bool deserializeLazyCode(JStarVM* vm, ObjFunction* fn);
+
 bool isCompiledCode(const void* code, size_t len);
 
 #endif
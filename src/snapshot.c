@@ -0,0 +1,1315 @@
+#include "snapshot.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "array.h"
+#include "builtins/builtins.h"
+#include "code.h"
+#include "conf.h"
+#include "gc.h"
+#include "int_hashtable.h"
+#include "jstar.h"
+#include "object.h"
+#include "profile.h"
+#include "serialize.h"
+#include "symbol.h"
+#include "value.h"
+#include "value_hashtable.h"
+#include "vm.h"
+
+#define MAGIC         0xb5
+#define SNAPSHOT_PATH "<snapshot>"
+
+static const uint8_t HEADER[] = {MAGIC, 'J', 's', 'r', 'S'};
+
+// Layout of the build, snapshots can only be restored by a build with the same one
+static const uint8_t LAYOUT[] = {
+    sizeof(void*),
+    sizeof(Value),
+    sizeof(int),
+    CORE_CLASS_COUNT,
+    SPECIAL_METHOD_COUNT,
+};
+
+// Snapshot metadata, written right after the header
+typedef struct SnapshotInfo {
+    uint64_t token;        // Token of the process that created the snapshot
+    uint64_t objectCount;  // Number of objects in the allocation table
+    uint64_t tableOffset;  // Offset of the allocation table, stored after the object contents
+    uint64_t hashSeed;     // Seed the string hashes in the snapshot were computed with
+    uint8_t processBound;  // Whether the snapshot contains raw pointers
+} SnapshotInfo;
+
+// Size of an allocation table entry: the object type and its variable size
+#define TABLE_ENTRY_SIZE (sizeof(uint8_t) + sizeof(uint64_t))
+
+typedef enum ValueTag {
+    TAG_NUM,
+    TAG_NULL,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_OBJ,
+    TAG_STDIN,
+    TAG_STDOUT,
+    TAG_STDERR,
+    TAG_HANDLE,
+} ValueTag;
+
+typedef enum NativeKind {
+    NATIVE_NONE,
+    NATIVE_BUILTIN,
+    NATIVE_EXTERNAL,
+} NativeKind;
+
+typedef enum CodeKind {
+    CODE_OWNED,
+    CODE_BUILTIN,
+    CODE_LAZY,
+} CodeKind;
+
+// Identifies the current process, so that snapshots containing raw pointers are only restored by
+// the process that created them
+static uint64_t processToken(void) {
+    static uint64_t token;
+    if(token == 0) {
+        token = ((uint64_t)(uintptr_t)&token ^ (uint64_t)time(NULL) << 32) | 1;
+    }
+    return token;
+}
+
+// -----------------------------------------------------------------------------
+// SNAPSHOT
+// -----------------------------------------------------------------------------
+
+typedef struct ObjIndex {
+    Obj* obj;
+    uint32_t index;
+} ObjIndex;
+
+typedef struct Snapshotter {
+    JStarVM* vm;
+    JStarBuffer buf;
+    bool processBound;
+    const char* error;
+
+    // Objects discovered so far, in snapshot order
+    struct {
+        Obj** items;
+        size_t capacity, count;
+    } objects;
+
+    // Open addressing map from objects to their (1-based) snapshot index
+    ObjIndex* indices;
+    size_t sizeMask;
+} Snapshotter;
+
+static void snapshotError(Snapshotter* s, const char* error) {
+    if(!s->error) s->error = error;
+}
+
+static void dump(Snapshotter* s, const void* data, size_t size) {
+    jsrBufferAppend(&s->buf, data, size);
+}
+
+static void dumpByte(Snapshotter* s, uint8_t byte) {
+    dump(s, &byte, sizeof(byte));
+}
+
+static void dumpShort(Snapshotter* s, uint16_t num) {
+    dump(s, &num, sizeof(num));
+}
+
+static void dumpUint32(Snapshotter* s, uint32_t num) {
+    dump(s, &num, sizeof(num));
+}
+
+static void dumpInt(Snapshotter* s, int num) {
+    int32_t i = num;
+    dump(s, &i, sizeof(i));
+}
+
+static void dumpUint64(Snapshotter* s, uint64_t num) {
+    dump(s, &num, sizeof(num));
+}
+
+static void dumpPadding(Snapshotter* s, size_t align) {
+    while(s->buf.size % align) dumpByte(s, 0);
+}
+
+static size_t hashPointer(const void* ptr) {
+    uint64_t x = (uint64_t)(uintptr_t)ptr;
+    return (size_t)((x >> 3) * UINT64_C(0x9e3779b97f4a7c15) >> 16);
+}
+
+static ObjIndex* findIndex(ObjIndex* indices, size_t sizeMask, const Obj* o) {
+    size_t i = hashPointer(o) & sizeMask;
+    while(indices[i].obj != NULL && indices[i].obj != o) {
+        i = (i + 1) & sizeMask;
+    }
+    return &indices[i];
+}
+
+static void growIndices(Snapshotter* s) {
+    JStarVM* vm = s->vm;
+    size_t oldSize = s->indices ? s->sizeMask + 1 : 0;
+    size_t newSize = oldSize ? oldSize * 2 : 1024;
+
+    ObjIndex* indices = vm->realloc(NULL, 0, sizeof(ObjIndex) * newSize);
+    JSR_ASSERT(indices, "Out of memory");
+    memset(indices, 0, sizeof(ObjIndex) * newSize);
+
+    for(size_t i = 0; i < oldSize; i++) {
+        if(s->indices[i].obj) {
+            *findIndex(indices, newSize - 1, s->indices[i].obj) = s->indices[i];
+        }
+    }
+
+    vm->realloc(s->indices, sizeof(ObjIndex) * oldSize, 0);
+    s->indices = indices;
+    s->sizeMask = newSize - 1;
+}
+
+// Returns the snapshot index of `o` (0 for NULL), adding it to the objects to snapshot if needed
+static uint32_t objectIndex(Snapshotter* s, Obj* o) {
+    if(o == NULL) return 0;
+
+    if(!s->indices || s->objects.count + 1 > MAX_ENTRY_LOAD(s->sizeMask + 1)) {
+        growIndices(s);
+    }
+
+    ObjIndex* e = findIndex(s->indices, s->sizeMask, o);
+    if(e->obj) return e->index;
+
+    switch(o->type) {
+    case OBJ_GENERATOR:
+        snapshotError(s, "Cannot snapshot Generator objects");
+        return 0;
+    case OBJ_USERDATA:
+        snapshotError(s, "Cannot snapshot Userdata objects");
+        return 0;
+    case OBJ_TYPED_ARRAY:
+        snapshotError(s, "Cannot snapshot typed array objects");
+        return 0;
+    case OBJ_BYTE_ARRAY:
+        snapshotError(s, "Cannot snapshot ByteArray objects");
+        return 0;
+    default:
+        break;
+    }
+
+    arrayAppend(s->vm, &s->objects, o);
+    e->obj = o;
+    e->index = s->objects.count;
+    return e->index;
+}
+
+static void dumpRef(Snapshotter* s, void* o) {
+    dumpUint32(s, objectIndex(s, o));
+}
+
+static void dumpRawPointer(Snapshotter* s, const void* ptr, size_t size) {
+    dump(s, ptr, size);
+    s->processBound = true;
+}
+
+static void dumpValue(Snapshotter* s, Value v) {
+    if(IS_NUM(v)) {
+        double num = AS_NUM(v);
+        dumpByte(s, TAG_NUM);
+        dump(s, &num, sizeof(num));
+    } else if(IS_NULL(v)) {
+        dumpByte(s, TAG_NULL);
+    } else if(IS_BOOL(v)) {
+        dumpByte(s, AS_BOOL(v) ? TAG_TRUE : TAG_FALSE);
+    } else if(IS_OBJ(v)) {
+        dumpByte(s, TAG_OBJ);
+        dumpRef(s, AS_OBJ(v));
+    } else {
+        // The standard streams are the only handles that can be referenced by any process
+        void* handle = AS_HANDLE(v);
+        if(handle == stdin) {
+            dumpByte(s, TAG_STDIN);
+        } else if(handle == stdout) {
+            dumpByte(s, TAG_STDOUT);
+        } else if(handle == stderr) {
+            dumpByte(s, TAG_STDERR);
+        } else {
+            dumpByte(s, TAG_HANDLE);
+            dumpRawPointer(s, &handle, sizeof(handle));
+        }
+    }
+}
+
+static void dumpValues(Snapshotter* s, const Value* values, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        dumpValue(s, values[i]);
+    }
+}
+
+static void dumpIntHashTable(Snapshotter* s, const IntHashTable* t) {
+    size_t capacity = t->entries ? t->sizeMask + 1 : 0;
+    dumpUint64(s, capacity);
+    dumpUint64(s, t->count);
+    dumpUint64(s, t->tombstones);
+    for(size_t i = 0; i < capacity; i++) {
+        dumpRef(s, t->entries[i].key);
+        dumpInt(s, t->entries[i].value);
+    }
+}
+
+static void dumpValueHashTable(Snapshotter* s, const ValueHashTable* t) {
+    size_t capacity = t->entries ? t->sizeMask + 1 : 0;
+    dumpUint64(s, capacity);
+    dumpUint64(s, t->count);
+    dumpUint64(s, t->tombstones);
+    for(size_t i = 0; i < capacity; i++) {
+        dumpRef(s, t->entries[i].key);
+        dumpValue(s, t->entries[i].value);
+    }
+}
+
+static void dumpFunctionBase(Snapshotter* s, const FunctionBase* fn) {
+    dumpByte(s, fn->vararg);
+    dumpByte(s, fn->argsCount);
+    dumpValues(s, fn->defaults, fn->defCount);
+    dumpRef(s, fn->module);
+    dumpRef(s, fn->name);
+}
+
+static void dumpNative(Snapshotter* s, const ObjNative* n) {
+    dumpFunctionBase(s, &n->base);
+
+    uint32_t id;
+    if(n->fn == NULL) {
+        dumpByte(s, NATIVE_NONE);
+    } else if(getBuiltInNativeId(n->fn, &id)) {
+        dumpByte(s, NATIVE_BUILTIN);
+        dumpUint32(s, id);
+    } else {
+        dumpByte(s, NATIVE_EXTERNAL);
+        dumpRawPointer(s, &n->fn, sizeof(n->fn));
+    }
+}
+
+static void dumpCode(Snapshotter* s, const Code* c) {
+    // Lazy functions of built-in modules keep referencing the compiled code in static memory
+    if(c->lazyChunk) {
+        dumpByte(s, CODE_LAZY);
+        dumpUint32(s, getBuiltInChunkId(c->lazyChunk));
+        dumpUint64(s, c->lazyStart);
+        dumpUint64(s, c->lazyEnd);
+        return;
+    }
+
+    int chunk = c->externalBytecode ? getBuiltInChunkId(c->bytecode.items) : -1;
+    if(chunk != -1) {
+        size_t len;
+        const uint8_t* chunkStart = getBuiltInChunk(chunk, &len);
+        dumpByte(s, CODE_BUILTIN);
+        dumpUint32(s, chunk);
+        dumpUint64(s, c->bytecode.items - chunkStart);
+        dumpUint64(s, c->bytecode.count);
+    } else {
+        // Copy bytecode that doesn't live in static memory (e.g. memory mapped files)
+        dumpByte(s, CODE_OWNED);
+        dumpUint64(s, c->bytecode.count);
+        dump(s, c->bytecode.items, c->bytecode.count);
+    }
+
+    // Line information is stored in the native layout, so that it can be referenced in place
+    dumpUint64(s, c->lines.count);
+    dumpPadding(s, sizeof(int));
+    if(c->lines.count) dump(s, c->lines.items, sizeof(int) * c->lines.count);
+
+    dumpUint64(s, c->consts.count);
+    dumpValues(s, c->consts.items, c->consts.count);
+
+    dumpUint64(s, c->symbols.count);
+    for(size_t i = 0; i < c->symbols.count; i++) {
+        dumpShort(s, c->symbols.items[i].constant);
+    }
+}
+
+static void dumpFunction(Snapshotter* s, ObjFunction* fn) {
+    // Lazy functions of other modules reference code that may not outlive the VM, load it now
+    Code* c = &fn->code;
+    if(c->lazyChunk && getBuiltInChunkId(c->lazyChunk) == -1 && !deserializeLazyCode(s->vm, fn)) {
+        snapshotError(s, "Cannot load the code of a lazily loaded function");
+        return;
+    }
+
+    dumpFunctionBase(s, &fn->base);
+    dumpByte(s, fn->upvalueCount);
+    dumpInt(s, fn->stackUsage);
+    dumpCode(s, c);
+}
+
+static void dumpTable(Snapshotter* s, const ObjTable* t) {
+    // Entries are copied along with their layout, so their hash must not depend on the process
+    size_t capacity = t->entries ? t->sizeMask + 1 : 0;
+    for(size_t i = 0; i < capacity; i++) {
+        Value key = t->entries[i].key;
+        if(!IS_NULL(key) && !IS_NUM(key) && !IS_BOOL(key) && !IS_STRING(key)) {
+            snapshotError(s, "Cannot snapshot Tables with keys other than Numbers, Booleans or Strings");
+            return;
+        }
+    }
+
+    dumpUint64(s, capacity);
+    dumpUint64(s, t->count);
+    dumpUint64(s, t->tombstones);
+    for(size_t i = 0; i < capacity; i++) {
+        dumpValue(s, t->entries[i].key);
+        dumpValue(s, t->entries[i].val);
+    }
+}
+
+static void dumpObject(Snapshotter* s, Obj* o) {
+    dumpRef(s, o->cls);
+
+    switch(o->type) {
+    case OBJ_STRING: {
+        ObjString* str = (ObjString*)o;
+        dumpUint32(s, str->hash);
+        dumpByte(s, str->interned);
+        dump(s, str->data, str->length);
+        break;
+    }
+    case OBJ_NATIVE:
+        dumpNative(s, (ObjNative*)o);
+        break;
+    case OBJ_FUNCTION:
+        dumpFunction(s, (ObjFunction*)o);
+        break;
+    case OBJ_CLASS: {
+        ObjClass* cls = (ObjClass*)o;
+        dumpRef(s, cls->name);
+        dumpRef(s, cls->superCls);
+        dumpInt(s, cls->fieldCount);
+        dumpIntHashTable(s, &cls->fields);
+        dumpValueHashTable(s, &cls->methods);
+        break;
+    }
+    case OBJ_INST: {
+        ObjInstance* inst = (ObjInstance*)o;
+        dumpValues(s, inst->fields, inst->size);
+        break;
+    }
+    case OBJ_MODULE: {
+        ObjModule* mod = (ObjModule*)o;
+        dumpRef(s, mod->name);
+        dumpRef(s, mod->path);
+        dumpIntHashTable(s, &mod->globalNames);
+        dumpInt(s, mod->globalsCount);
+        dumpValues(s, mod->globals, mod->globalsCapacity);
+        dumpByte(s, mod->registry != NULL);
+        if(mod->registry) dumpRawPointer(s, &mod->registry, sizeof(mod->registry));
+        break;
+    }
+    case OBJ_LIST: {
+        ObjList* lst = (ObjList*)o;
+        dumpUint64(s, lst->count);
+        dumpValues(s, lst->items, lst->count);
+        break;
+    }
+    case OBJ_TUPLE: {
+        ObjTuple* tup = (ObjTuple*)o;
+        dumpValues(s, tup->items, tup->count);
+        break;
+    }
+    case OBJ_TABLE:
+        dumpTable(s, (ObjTable*)o);
+        break;
+    case OBJ_BOUND_METHOD: {
+        ObjBoundMethod* bm = (ObjBoundMethod*)o;
+        dumpValue(s, bm->receiver);
+        dumpRef(s, bm->method);
+        break;
+    }
+    case OBJ_STACK_TRACE: {
+        ObjStackTrace* st = (ObjStackTrace*)o;
+        dumpUint64(s, st->records.count);
+        for(size_t i = 0; i < st->records.count; i++) {
+            FrameRecord* record = &st->records.items[i];
+            dumpInt(s, record->line);
+            dumpRef(s, record->path);
+            dumpRef(s, record->moduleName);
+            dumpRef(s, record->funcName);
+        }
+        break;
+    }
+    case OBJ_CLOSURE: {
+        ObjClosure* closure = (ObjClosure*)o;
+        dumpRef(s, closure->fn);
+        for(uint8_t i = 0; i < closure->upvalueCount; i++) {
+            dumpRef(s, closure->upvalues[i]);
+        }
+        break;
+    }
+    case OBJ_UPVALUE: {
+        ObjUpvalue* upvalue = (ObjUpvalue*)o;
+        if(upvalue->addr != &upvalue->closed) {
+            snapshotError(s, "Cannot snapshot open upvalues");
+            break;
+        }
+        dumpValue(s, upvalue->closed);
+        break;
+    }
+    case OBJ_GENERATOR:
+    case OBJ_USERDATA:
+    case OBJ_TYPED_ARRAY:
+    case OBJ_BYTE_ARRAY:
+        JSR_UNREACHABLE();
+    }
+}
+
+// Returns the variable size of an object, needed to allocate it before restoring its contents
+static uint64_t allocationSize(const Obj* o) {
+    switch(o->type) {
+    case OBJ_STRING:
+        return ((ObjString*)o)->length;
+    case OBJ_NATIVE:
+        return ((ObjNative*)o)->base.defCount;
+    case OBJ_FUNCTION:
+        return ((ObjFunction*)o)->base.defCount;
+    case OBJ_INST:
+        return ((ObjInstance*)o)->size;
+    case OBJ_MODULE:
+        return ((ObjModule*)o)->globalsCapacity;
+    case OBJ_LIST:
+        return ((ObjList*)o)->capacity;
+    case OBJ_TUPLE:
+        return ((ObjTuple*)o)->count;
+    case OBJ_CLOSURE:
+        return ((ObjClosure*)o)->upvalueCount;
+    default:
+        return 0;
+    }
+}
+
+static void dumpRoots(Snapshotter* s) {
+    JStarVM* vm = s->vm;
+
+    for(int i = 0; i < CORE_CLASS_COUNT; i++) {
+        dumpRef(s, vm->coreClasses[i]);
+    }
+
+    dumpRef(s, vm->excClass);
+    dumpRef(s, vm->argv);
+
+    for(int i = 0; i < SPECIAL_METHOD_COUNT; i++) {
+        dumpRef(s, vm->specialMethods[i]);
+    }
+
+    dumpRef(s, vm->emptyTup);
+    dumpRef(s, vm->excErr);
+    dumpRef(s, vm->excTrace);
+    dumpRef(s, vm->excCause);
+    dumpRef(s, vm->core);
+
+    dumpValueHashTable(s, &vm->modules);
+    dumpValueHashTable(s, &vm->stringPool);
+}
+
+bool jsrSnapshotRuntime(JStarVM* vm, JStarBuffer* out) {
+    PROFILE_FUNC();
+
+    JSR_ASSERT(vm->core, "Runtime not initialized, call `jsrInitRuntime`");
+
+    if(vm->frameCount != 0) {
+        vm->errorCallback(vm, JSR_RUNTIME_ERR, SNAPSHOT_PATH, (JStarLoc){0},
+                          "Cannot snapshot the runtime while it's executing code");
+        return false;
+    }
+
+    // Collect garbage first, so that only live objects and interned strings end up in the snapshot
+    garbageCollect(vm);
+
+    Snapshotter s = {.vm = vm};
+    jsrBufferInit(vm, &s.buf);
+
+    dump(&s, HEADER, sizeof(HEADER));
+    dumpByte(&s, JSTAR_VERSION_MAJOR);
+    dumpByte(&s, JSTAR_VERSION_MINOR);
+    dumpByte(&s, JSTAR_BYTECODE_VERSION);
+    dump(&s, LAYOUT, sizeof(LAYOUT));
+
+    size_t infoOffset = s.buf.size;
+    SnapshotInfo info;
+    memset(&info, 0, sizeof(info));
+    dump(&s, &info, sizeof(info));
+
+    // Objects are discovered while writing the roots and the contents of other objects
+    dumpRoots(&s);
+    for(size_t i = 0; i < s.objects.count && !s.error; i++) {
+        dumpObject(&s, s.objects.items[i]);
+    }
+
+    info.tableOffset = s.buf.size;
+    info.objectCount = s.objects.count;
+    info.processBound = s.processBound;
+    info.hashSeed = vm->hashSeed;
+    info.token = s.processBound ? processToken() : 0;
+    memcpy(s.buf.data + infoOffset, &info, sizeof(info));
+
+    for(size_t i = 0; i < s.objects.count; i++) {
+        dumpByte(&s, s.objects.items[i]->type);
+        dumpUint64(&s, allocationSize(s.objects.items[i]));
+    }
+
+    vm->realloc(s.indices, sizeof(ObjIndex) * (s.sizeMask + 1), 0);
+    arrayFree(vm, &s.objects);
+
+    if(s.error) {
+        jsrBufferFree(&s.buf);
+        vm->errorCallback(vm, JSR_RUNTIME_ERR, SNAPSHOT_PATH, (JStarLoc){0}, s.error);
+        return false;
+    }
+
+    jsrBufferShrinkToFit(&s.buf);
+    *out = s.buf;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// RESTORE
+// -----------------------------------------------------------------------------
+
+typedef struct Restorer {
+    JStarVM* vm;
+    const uint8_t* data;
+    size_t len, ptr;
+    Obj** objects;
+    size_t count, capacity;
+} Restorer;
+
+static bool read(Restorer* r, void* dest, size_t size) {
+    if(size > r->len - r->ptr) {
+        return false;
+    }
+    memcpy(dest, r->data + r->ptr, size);
+    r->ptr += size;
+    return true;
+}
+
+static bool readByte(Restorer* r, uint8_t* out) {
+    return read(r, out, sizeof(*out));
+}
+
+static bool readShort(Restorer* r, uint16_t* out) {
+    return read(r, out, sizeof(*out));
+}
+
+static bool readUint32(Restorer* r, uint32_t* out) {
+    return read(r, out, sizeof(*out));
+}
+
+static bool readInt(Restorer* r, int* out) {
+    int32_t i;
+    if(!read(r, &i, sizeof(i))) return false;
+    *out = i;
+    return true;
+}
+
+static bool readUint64(Restorer* r, uint64_t* out) {
+    return read(r, out, sizeof(*out));
+}
+
+// Returns `size` bytes of the snapshot to be referenced in place, skipping the padding written
+// to align them to `align`
+static const void* readInPlace(Restorer* r, size_t size, size_t align) {
+    size_t padding = (align - r->ptr % align) % align;
+    if(padding > r->len - r->ptr || size > r->len - r->ptr - padding) {
+        return NULL;
+    }
+    const void* data = r->data + r->ptr + padding;
+    r->ptr += padding + size;
+    return data;
+}
+
+// Checks that `count` elements, each stored in at least `minSize` bytes, can fit in the snapshot
+static bool canContain(const Restorer* r, uint64_t count, size_t minSize) {
+    return count <= (r->len - r->ptr) / minSize;
+}
+
+// Allocates GC memory. Restoring a snapshot never triggers a collection: objects are linked in
+// the VM only when fully restored
+static void* allocate(JStarVM* vm, size_t size) {
+    if(size == 0) return NULL;
+    vm->allocated += size;
+    void* mem = vm->realloc(NULL, 0, size);
+    JSR_ASSERT(mem, "Out of memory");
+    return mem;
+}
+
+// Allocates memory not managed by the GC, such as code and hash table arrays
+static void* allocateArray(JStarVM* vm, size_t size) {
+    if(size == 0) return NULL;
+    void* mem = vm->realloc(NULL, 0, size);
+    JSR_ASSERT(mem, "Out of memory");
+    return mem;
+}
+
+static bool readRef(Restorer* r, ObjType type, Obj** out) {
+    uint32_t index;
+    if(!readUint32(r, &index)) return false;
+    if(index > r->count) return false;
+
+    Obj* o = index ? r->objects[index - 1] : NULL;
+    if(o && o->type != type) return false;
+
+    *out = o;
+    return true;
+}
+
+// Reads a reference to an object of type `type` into `out`, through an `Obj* ref` temporary
+#define READ_REF(r, type, out) (readRef(r, type, &ref) && ((out) = (void*)ref, true))
+
+static bool readValue(Restorer* r, Value* out) {
+    uint8_t tag;
+    if(!readByte(r, &tag)) return false;
+
+    switch((ValueTag)tag) {
+    case TAG_NUM: {
+        double num;
+        if(!read(r, &num, sizeof(num))) return false;
+        *out = NUM_VAL(num);
+        return true;
+    }
+    case TAG_NULL:
+        *out = NULL_VAL;
+        return true;
+    case TAG_FALSE:
+        *out = FALSE_VAL;
+        return true;
+    case TAG_TRUE:
+        *out = TRUE_VAL;
+        return true;
+    case TAG_OBJ: {
+        uint32_t index;
+        if(!readUint32(r, &index)) return false;
+        if(index == 0 || index > r->count) return false;
+        *out = OBJ_VAL(r->objects[index - 1]);
+        return true;
+    }
+    case TAG_STDIN:
+        *out = HANDLE_VAL(stdin);
+        return true;
+    case TAG_STDOUT:
+        *out = HANDLE_VAL(stdout);
+        return true;
+    case TAG_STDERR:
+        *out = HANDLE_VAL(stderr);
+        return true;
+    case TAG_HANDLE: {
+        void* handle;
+        if(!read(r, &handle, sizeof(handle))) return false;
+        *out = HANDLE_VAL(handle);
+        return true;
+    }
+    }
+
+    return false;
+}
+
+static bool readValues(Restorer* r, Value* values, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        if(!readValue(r, &values[i])) return false;
+    }
+    return true;
+}
+
+static bool readTableLayout(Restorer* r, size_t entrySize, uint64_t* capacity, uint64_t* count,
+                            uint64_t* tombstones) {
+    if(!readUint64(r, capacity) || !readUint64(r, count) || !readUint64(r, tombstones)) {
+        return false;
+    }
+    if(*capacity & (*capacity - 1)) return false;
+    if(*count > *capacity || *tombstones > *capacity - *count) return false;
+    return canContain(r, *capacity, entrySize);
+}
+
+static bool readIntHashTable(Restorer* r, IntHashTable* t) {
+    uint64_t capacity, count, tombstones;
+    if(!readTableLayout(r, sizeof(uint32_t) * 2, &capacity, &count, &tombstones)) return false;
+    if(capacity == 0) return count == 0;
+
+    t->entries = allocateArray(r->vm, sizeof(IntEntry) * capacity);
+    t->sizeMask = capacity - 1;
+    t->count = count;
+    t->tombstones = tombstones;
+
+    // Lookups need at least an empty entry to terminate
+    size_t keys = 0, empty = 0;
+    for(size_t i = 0; i < capacity; i++) {
+        Obj* ref;
+        IntEntry* e = &t->entries[i];
+        if(!READ_REF(r, OBJ_STRING, e->key) || !readInt(r, &e->value)) {
+            return false;
+        }
+        keys += e->key != NULL;
+        empty += e->key == NULL && e->value == -2;  // Never used entry, see int_hashtable.c
+    }
+
+    return keys == count && empty != 0;
+}
+
+static bool readValueHashTable(Restorer* r, ValueHashTable* t) {
+    uint64_t capacity, count, tombstones;
+    if(!readTableLayout(r, sizeof(uint32_t) + 1, &capacity, &count, &tombstones)) return false;
+    if(capacity == 0) return count == 0;
+
+    t->entries = allocateArray(r->vm, sizeof(ValueEntry) * capacity);
+    t->sizeMask = capacity - 1;
+    t->count = count;
+    t->tombstones = tombstones;
+
+    // Lookups need at least an empty entry to terminate
+    size_t keys = 0, empty = 0;
+    for(size_t i = 0; i < capacity; i++) {
+        Obj* ref;
+        ValueEntry* e = &t->entries[i];
+        if(!READ_REF(r, OBJ_STRING, e->key) || !readValue(r, &e->value)) {
+            return false;
+        }
+        keys += e->key != NULL;
+        empty += e->key == NULL && IS_NULL(e->value);
+    }
+
+    return keys == count && empty != 0;
+}
+
+static bool readFunctionBase(Restorer* r, FunctionBase* fn) {
+    Obj* ref;
+    uint8_t vararg;
+    if(!readByte(r, &vararg) || !readByte(r, &fn->argsCount)) return false;
+    fn->vararg = vararg;
+    if(!readValues(r, fn->defaults, fn->defCount)) return false;
+    if(!READ_REF(r, OBJ_MODULE, fn->module)) return false;
+    if(!READ_REF(r, OBJ_STRING, fn->name)) return false;
+    return true;
+}
+
+static bool readNative(Restorer* r, ObjNative* n) {
+    if(!readFunctionBase(r, &n->base)) return false;
+
+    uint8_t kind;
+    if(!readByte(r, &kind)) return false;
+
+    switch((NativeKind)kind) {
+    case NATIVE_NONE:
+        n->fn = NULL;
+        return true;
+    case NATIVE_BUILTIN: {
+        uint32_t id;
+        if(!readUint32(r, &id)) return false;
+        n->fn = getBuiltInNative(id);
+        return n->fn != NULL;
+    }
+    case NATIVE_EXTERNAL:
+        return read(r, &n->fn, sizeof(n->fn));
+    }
+
+    return false;
+}
+
+static bool readCode(Restorer* r, Code* c) {
+    JStarVM* vm = r->vm;
+
+    uint8_t kind;
+    if(!readByte(r, &kind)) return false;
+
+    switch((CodeKind)kind) {
+    case CODE_LAZY: {
+        uint32_t chunk;
+        uint64_t start, end;
+        if(!readUint32(r, &chunk) || !readUint64(r, &start) || !readUint64(r, &end)) {
+            return false;
+        }
+
+        size_t len;
+        const void* chunkStart = getBuiltInChunk(chunk, &len);
+        if(!chunkStart || start > end || end > len) return false;
+
+        c->lazyChunk = chunkStart;
+        c->lazyStart = start;
+        c->lazyEnd = end;
+        return true;
+    }
+    case CODE_BUILTIN: {
+        uint32_t chunk;
+        uint64_t offset, count;
+        if(!readUint32(r, &chunk) || !readUint64(r, &offset) || !readUint64(r, &count)) {
+            return false;
+        }
+
+        size_t len;
+        const uint8_t* chunkStart = getBuiltInChunk(chunk, &len);
+        if(!chunkStart || offset > len || count > len - offset) return false;
+
+        c->bytecode.items = (uint8_t*)(chunkStart + offset);
+        c->bytecode.count = count;
+        c->externalBytecode = true;
+        break;
+    }
+    case CODE_OWNED: {
+        // Bytecode is read-only, share the one in the snapshot among all restored VMs
+        uint64_t count;
+        if(!readUint64(r, &count) || !canContain(r, count, 1)) return false;
+        const uint8_t* bytecode = readInPlace(r, count, 1);
+        if(!bytecode) return false;
+        c->bytecode.items = (uint8_t*)bytecode;
+        c->bytecode.count = count;
+        c->externalBytecode = true;
+        break;
+    }
+    default:
+        return false;
+    }
+
+    uint64_t linesCount;
+    if(!readUint64(r, &linesCount) || !canContain(r, linesCount, sizeof(int))) return false;
+    const int* lines = readInPlace(r, sizeof(int) * linesCount, sizeof(int));
+    if(!lines) return false;
+
+    if(linesCount > 0) {
+        // Line information can be shared as well, unless the snapshot memory is misaligned
+        if((uintptr_t)lines % sizeof(int) == 0) {
+            c->lines.items = (int*)lines;
+            c->externalLines = true;
+        } else {
+            c->lines.items = allocateArray(vm, sizeof(int) * linesCount);
+            c->lines.capacity = linesCount;
+            memcpy(c->lines.items, lines, sizeof(int) * linesCount);
+        }
+        c->lines.count = linesCount;
+    }
+
+    uint64_t constsCount;
+    if(!readUint64(r, &constsCount) || !canContain(r, constsCount, 1)) return false;
+    c->consts.items = allocateArray(vm, sizeof(Value) * constsCount);
+    c->consts.capacity = constsCount;
+    for(; c->consts.count < constsCount; c->consts.count++) {
+        if(!readValue(r, &c->consts.items[c->consts.count])) return false;
+    }
+
+    uint64_t symbolsCount;
+    if(!readUint64(r, &symbolsCount) || !canContain(r, symbolsCount, sizeof(uint16_t))) {
+        return false;
+    }
+    c->symbols.items = allocateArray(vm, sizeof(Symbol) * symbolsCount);
+    c->symbols.capacity = symbolsCount;
+    for(; c->symbols.count < symbolsCount; c->symbols.count++) {
+        uint16_t constant;
+        if(!readShort(r, &constant) || constant >= c->consts.count) return false;
+        c->symbols.items[c->symbols.count] = (Symbol){.constant = constant};
+    }
+
+    return true;
+}
+
+static bool readTable(Restorer* r, ObjTable* t) {
+    uint64_t capacity, count, tombstones;
+    if(!readTableLayout(r, 2, &capacity, &count, &tombstones)) return false;
+    if(capacity == 0) return count == 0;
+
+    t->entries = allocate(r->vm, sizeof(TableEntry) * capacity);
+    t->sizeMask = capacity - 1;
+    t->count = count;
+    t->tombstones = tombstones;
+
+    for(size_t i = 0; i < capacity; i++) {
+        // Null the value first, so that a partially restored table can be safely inspected
+        t->entries[i] = (TableEntry){NULL_VAL, NULL_VAL};
+    }
+
+    for(size_t i = 0; i < capacity; i++) {
+        TableEntry* e = &t->entries[i];
+        if(!readValue(r, &e->key) || !readValue(r, &e->val)) return false;
+    }
+
+    return true;
+}
+
+static bool readObject(Restorer* r, Obj* o) {
+    Obj* ref;
+    if(!READ_REF(r, OBJ_CLASS, o->cls)) return false;
+
+    switch(o->type) {
+    case OBJ_STRING: {
+        ObjString* str = (ObjString*)o;
+        uint8_t interned;
+        if(!readUint32(r, &str->hash) || !readByte(r, &interned)) return false;
+        str->interned = interned;
+        return read(r, str->data, str->length);
+    }
+    case OBJ_NATIVE:
+        return readNative(r, (ObjNative*)o);
+    case OBJ_FUNCTION: {
+        ObjFunction* fn = (ObjFunction*)o;
+        if(!readFunctionBase(r, &fn->base)) return false;
+        if(!readByte(r, &fn->upvalueCount)) return false;
+        if(!readInt(r, &fn->stackUsage)) return false;
+        return readCode(r, &fn->code);
+    }
+    case OBJ_CLASS: {
+        ObjClass* cls = (ObjClass*)o;
+        if(!READ_REF(r, OBJ_STRING, cls->name)) return false;
+        if(!READ_REF(r, OBJ_CLASS, cls->superCls)) return false;
+        if(!readInt(r, &cls->fieldCount)) return false;
+        if(!readIntHashTable(r, &cls->fields)) return false;
+        return readValueHashTable(r, &cls->methods);
+    }
+    case OBJ_INST: {
+        ObjInstance* inst = (ObjInstance*)o;
+        return readValues(r, inst->fields, inst->size);
+    }
+    case OBJ_MODULE: {
+        ObjModule* mod = (ObjModule*)o;
+        if(!READ_REF(r, OBJ_STRING, mod->name)) return false;
+        if(!READ_REF(r, OBJ_STRING, mod->path)) return false;
+        if(!readIntHashTable(r, &mod->globalNames)) return false;
+        if(!readInt(r, &mod->globalsCount)) return false;
+        if(mod->globalsCount < 0 || mod->globalsCount > mod->globalsCapacity) return false;
+        if(!readValues(r, mod->globals, mod->globalsCapacity)) return false;
+
+        uint8_t hasRegistry;
+        if(!readByte(r, &hasRegistry)) return false;
+        return !hasRegistry || read(r, &mod->registry, sizeof(mod->registry));
+    }
+    case OBJ_LIST: {
+        ObjList* lst = (ObjList*)o;
+        uint64_t count;
+        if(!readUint64(r, &count) || count > lst->capacity) return false;
+        lst->count = count;
+        return readValues(r, lst->items, lst->count);
+    }
+    case OBJ_TUPLE: {
+        ObjTuple* tup = (ObjTuple*)o;
+        return readValues(r, tup->items, tup->count);
+    }
+    case OBJ_TABLE:
+        return readTable(r, (ObjTable*)o);
+    case OBJ_BOUND_METHOD: {
+        ObjBoundMethod* bm = (ObjBoundMethod*)o;
+        uint32_t index;
+        if(!readValue(r, &bm->receiver) || !readUint32(r, &index)) return false;
+        if(index == 0 || index > r->count) return false;
+        bm->method = r->objects[index - 1];
+        return bm->method->type == OBJ_CLOSURE || bm->method->type == OBJ_NATIVE;
+    }
+    case OBJ_STACK_TRACE: {
+        ObjStackTrace* st = (ObjStackTrace*)o;
+        uint64_t count;
+        if(!readUint64(r, &count) || !canContain(r, count, sizeof(uint32_t) * 4)) return false;
+
+        st->records.items = allocate(r->vm, sizeof(FrameRecord) * count);
+        st->records.capacity = count;
+
+        for(; st->records.count < count; st->records.count++) {
+            FrameRecord* record = &st->records.items[st->records.count];
+            if(!readInt(r, &record->line)) return false;
+            if(!READ_REF(r, OBJ_STRING, record->path)) return false;
+            if(!READ_REF(r, OBJ_STRING, record->moduleName)) return false;
+            if(!READ_REF(r, OBJ_STRING, record->funcName)) return false;
+        }
+        return true;
+    }
+    case OBJ_CLOSURE: {
+        ObjClosure* closure = (ObjClosure*)o;
+        if(!READ_REF(r, OBJ_FUNCTION, closure->fn) || !closure->fn) return false;
+        for(uint8_t i = 0; i < closure->upvalueCount; i++) {
+            if(!READ_REF(r, OBJ_UPVALUE, closure->upvalues[i])) return false;
+        }
+        return true;
+    }
+    case OBJ_UPVALUE: {
+        ObjUpvalue* upvalue = (ObjUpvalue*)o;
+        return readValue(r, &upvalue->closed);
+    }
+    case OBJ_GENERATOR:
+    case OBJ_USERDATA:
+    case OBJ_TYPED_ARRAY:
+    case OBJ_BYTE_ARRAY:
+        return false;
+    }
+
+    return false;
+}
+
+// Allocates an object of the given type and variable size, leaving it in a state in which it can
+// be safely freed until its contents are restored
+static Obj* allocateObject(Restorer* r, ObjType type, uint64_t size) {
+    JStarVM* vm = r->vm;
+
+    // Every element of an object is stored in at least a byte
+    if(size > r->len) return NULL;
+
+    Obj* o;
+    switch(type) {
+    case OBJ_STRING: {
+        ObjOwnedString* str = allocate(vm, sizeof(*str) + size + 1);
+        str->base.length = size;
+        str->base.hash = 0;
+        str->base.interned = false;
+        str->base.kind = STR_OWNED;
+        str->base.data = str->chars;
+        str->chars[size] = '\0';
+        o = (Obj*)str;
+        break;
+    }
+    case OBJ_NATIVE: {
+        if(size > UINT8_MAX) return NULL;
+        ObjNative* nat = allocate(vm, sizeof(*nat));
+        nat->base = (FunctionBase){.defCount = size};
+        nat->base.defaults = allocate(vm, sizeof(Value) * size);
+        nat->fn = NULL;
+        o = (Obj*)nat;
+        break;
+    }
+    case OBJ_FUNCTION: {
+        if(size > UINT8_MAX) return NULL;
+        ObjFunction* fn = allocate(vm, sizeof(*fn));
+        fn->base = (FunctionBase){.defCount = size};
+        fn->base.defaults = allocate(vm, sizeof(Value) * size);
+        fn->upvalueCount = 0;
+        fn->stackUsage = 0;
+        initCode(&fn->code);
+        o = (Obj*)fn;
+        break;
+    }
+    case OBJ_CLASS: {
+        ObjClass* cls = allocate(vm, sizeof(*cls));
+        cls->name = NULL;
+        cls->superCls = NULL;
+        cls->fieldCount = 0;
+        initIntHashTable(vm, &cls->fields);
+        initValueHashTable(vm, &cls->methods);
+        o = (Obj*)cls;
+        break;
+    }
+    case OBJ_INST: {
+        ObjInstance* inst = allocate(vm, sizeof(*inst));
+        inst->size = size;
+        inst->fields = allocate(vm, sizeof(Value) * size);
+        o = (Obj*)inst;
+        break;
+    }
+    case OBJ_MODULE: {
+        if(size > INT32_MAX) return NULL;
+        ObjModule* mod = allocate(vm, sizeof(*mod));
+        mod->name = NULL;
+        mod->path = NULL;
+        mod->registry = NULL;
+        mod->globalsCount = 0;
+        mod->globalsCapacity = size;
+        mod->globals = allocate(vm, sizeof(Value) * size);
+        initIntHashTable(vm, &mod->globalNames);
+        o = (Obj*)mod;
+        break;
+    }
+    case OBJ_LIST: {
+        ObjList* lst = allocate(vm, sizeof(*lst));
+        lst->capacity = size;
+        lst->count = 0;
+        lst->items = allocate(vm, sizeof(Value) * size);
+        o = (Obj*)lst;
+        break;
+    }
+    case OBJ_TUPLE: {
+        ObjTuple* tup = allocate(vm, sizeof(*tup) + sizeof(Value) * size);
+        tup->count = size;
+        o = (Obj*)tup;
+        break;
+    }
+    case OBJ_TABLE: {
+        ObjTable* t = allocate(vm, sizeof(*t));
+        t->sizeMask = 0;
+        t->count = 0;
+        t->tombstones = 0;
+        t->entries = NULL;
+        o = (Obj*)t;
+        break;
+    }
+    case OBJ_BOUND_METHOD: {
+        ObjBoundMethod* bm = allocate(vm, sizeof(*bm));
+        bm->receiver = NULL_VAL;
+        bm->method = NULL;
+        o = (Obj*)bm;
+        break;
+    }
+    case OBJ_STACK_TRACE: {
+        ObjStackTrace* st = allocate(vm, sizeof(*st));
+        st->records.items = NULL;
+        st->records.capacity = 0;
+        st->records.count = 0;
+        o = (Obj*)st;
+        break;
+    }
+    case OBJ_CLOSURE: {
+        if(size > UINT8_MAX) return NULL;
+        ObjClosure* closure = allocate(vm, sizeof(*closure) + sizeof(ObjUpvalue*) * size);
+        closure->fn = NULL;
+        closure->upvalueCount = size;
+        o = (Obj*)closure;
+        break;
+    }
+    case OBJ_UPVALUE: {
+        ObjUpvalue* upvalue = allocate(vm, sizeof(*upvalue));
+        upvalue->addr = &upvalue->closed;
+        upvalue->closed = NULL_VAL;
+        upvalue->next = NULL;
+        o = (Obj*)upvalue;
+        break;
+    }
+    default:
+        return NULL;
+    }
+
+    o->type = type;
+    o->reached = false;
+    o->cls = NULL;
+    o->next = NULL;
+    return o;
+}
+
+static bool readRoots(Restorer* r) {
+    JStarVM* vm = r->vm;
+    Obj* ref;
+
+    for(int i = 0; i < CORE_CLASS_COUNT; i++) {
+        if(!READ_REF(r, OBJ_CLASS, vm->coreClasses[i]) || !vm->coreClasses[i]) return false;
+    }
+
+    if(!READ_REF(r, OBJ_CLASS, vm->excClass)) return false;
+    if(!READ_REF(r, OBJ_LIST, vm->argv)) return false;
+
+    for(int i = 0; i < SPECIAL_METHOD_COUNT; i++) {
+        if(!READ_REF(r, OBJ_STRING, vm->specialMethods[i]) || !vm->specialMethods[i]) return false;
+    }
+
+    if(!READ_REF(r, OBJ_TUPLE, vm->emptyTup)) return false;
+    if(!READ_REF(r, OBJ_STRING, vm->excErr)) return false;
+    if(!READ_REF(r, OBJ_STRING, vm->excTrace)) return false;
+    if(!READ_REF(r, OBJ_STRING, vm->excCause)) return false;
+    if(!READ_REF(r, OBJ_MODULE, vm->core) || !vm->core) return false;
+
+    if(!readValueHashTable(r, &vm->modules)) return false;
+    if(!readValueHashTable(r, &vm->stringPool)) return false;
+
+    return vm->excClass && vm->argv && vm->emptyTup && vm->excErr && vm->excTrace && vm->excCause;
+}
+
+static JStarResult restore(Restorer* r) {
+    JStarVM* vm = r->vm;
+
+    uint8_t header[sizeof(HEADER)];
+    if(!read(r, header, sizeof(header)) || memcmp(header, HEADER, sizeof(HEADER)) != 0) {
+        return JSR_DESERIALIZE_ERR;
+    }
+
+    uint8_t versionMajor, versionMinor, bytecodeVersion, layout[sizeof(LAYOUT)];
+    if(!readByte(r, &versionMajor) || !readByte(r, &versionMinor) ||
+       !readByte(r, &bytecodeVersion) || !read(r, layout, sizeof(layout))) {
+        return JSR_DESERIALIZE_ERR;
+    }
+
+    if(versionMajor != JSTAR_VERSION_MAJOR || versionMinor != JSTAR_VERSION_MINOR ||
+       bytecodeVersion != JSTAR_BYTECODE_VERSION || memcmp(layout, LAYOUT, sizeof(LAYOUT)) != 0) {
+        return JSR_VERSION_ERR;
+    }
+
+    SnapshotInfo info;
+    if(!read(r, &info, sizeof(info))) return JSR_DESERIALIZE_ERR;
+    if(info.processBound && info.token != processToken()) return JSR_VERSION_ERR;
+
+    if(info.tableOffset < r->ptr || info.tableOffset > r->len) return JSR_DESERIALIZE_ERR;
+    if(info.objectCount != (r->len - info.tableOffset) / TABLE_ENTRY_SIZE ||
+       (r->len - info.tableOffset) % TABLE_ENTRY_SIZE != 0) {
+        return JSR_DESERIALIZE_ERR;
+    }
+
+    // First pass: allocate all objects, so that references can be resolved in the second one
+    size_t contentsOffset = r->ptr;
+    r->ptr = info.tableOffset;
+
+    if(info.objectCount > 0) {
+        r->objects = vm->realloc(NULL, 0, sizeof(Obj*) * info.objectCount);
+        JSR_ASSERT(r->objects, "Out of memory");
+        r->capacity = info.objectCount;
+    }
+
+    for(size_t i = 0; i < info.objectCount; i++) {
+        uint8_t type;
+        uint64_t size;
+        if(!readByte(r, &type) || !readUint64(r, &size)) return JSR_DESERIALIZE_ERR;
+
+        Obj* o = allocateObject(r, (ObjType)type, size);
+        if(!o) return JSR_DESERIALIZE_ERR;
+        r->objects[r->count++] = o;
+    }
+
+    // Second pass: restore roots and object contents, translating indices back to pointers
+    r->ptr = contentsOffset;
+    r->len = info.tableOffset;
+
+    if(!readRoots(r)) return JSR_DESERIALIZE_ERR;
+
+    for(size_t i = 0; i < r->count; i++) {
+        if(!readObject(r, r->objects[i])) return JSR_DESERIALIZE_ERR;
+    }
+
+    if(r->ptr != r->len) return JSR_DESERIALIZE_ERR;
+
+    for(size_t i = 0; i < r->count; i++) {
+        r->objects[i]->next = vm->objects;
+        vm->objects = r->objects[i];
+    }
+
+    // Hashes are restored verbatim, so keep computing them with the seed of the snapshot
+    vm->hashSeed = info.hashSeed;
+
+    return JSR_SUCCESS;
+}
+
+static void discardRestore(Restorer* r) {
+    JStarVM* vm = r->vm;
+
+    // Empty the pool first, so that freeing the interned strings doesn't look into it
+    freeValueHashTable(&vm->modules);
+    freeValueHashTable(&vm->stringPool);
+
+    for(size_t i = 0; i < r->count; i++) {
+        freeObject(vm, r->objects[i]);
+    }
+
+    memset(vm->coreClasses, 0, sizeof(vm->coreClasses));
+    memset(vm->specialMethods, 0, sizeof(vm->specialMethods));
+    vm->excClass = NULL;
+    vm->argv = NULL;
+    vm->emptyTup = NULL;
+    vm->excErr = vm->excTrace = vm->excCause = NULL;
+    vm->core = NULL;
+}
+
+bool restoreSnapshot(JStarVM* vm, const void* snapshot, size_t len) {
+    PROFILE_FUNC();
+
+    JSR_ASSERT(!vm->core && !vm->objects, "Runtime already initialized");
+
+    Restorer r = {vm, snapshot, len, 0, NULL, 0, 0};
+    JStarResult res = restore(&r);
+
+    if(res != JSR_SUCCESS) {
+        discardRestore(&r);
+        const char* error = res == JSR_VERSION_ERR ? "Incompatible runtime snapshot"
+                                                   : "Malformed runtime snapshot";
+        vm->errorCallback(vm, res, SNAPSHOT_PATH, (JStarLoc){0}, error);
+    }
+
+    vm->realloc(r.objects, sizeof(Obj*) * r.capacity, 0);
+    return res == JSR_SUCCESS;
+}
@@ -0,0 +1,34 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "jstar.h"
+
+/**
+ * Runtime heap snapshots.
+ *
+ * A snapshot is a relocatable image of the heap of an initialized runtime: the core classes, the
+ * interned strings and all the loaded modules, along with everything reachable from them.
+ * Objects are stored as an allocation table followed by the object contents, with every pointer
+ * replaced by an object index. Restoring a snapshot allocates all the objects up front and then
+ * fills them in, translating the indices back to pointers; hash tables are copied verbatim, so
+ * no re-hashing or string interning is needed (a restored VM adopts the hash seed of the VM that
+ * took the snapshot). Bytecode and line information are immutable, so they are referenced in
+ * place: all the VMs restored from the same snapshot share a single copy.
+ *
+ * Snapshots are tied to the J* build that created them. Built-in natives and compiled modules
+ * are referenced by identifiers, so snapshots of the standard library can be restored by any
+ * process. Raw native pointers (e.g. functions coming from an embedder's native registry) and
+ * handles other than the standard streams are stored as-is, making the snapshot valid only in
+ * the process that created it.
+ */
+
+// Restore the runtime of a freshly created VM from a snapshot taken with `jsrSnapshotRuntime`.
+// The snapshot memory must outlive the VM.
+// Returns false if the snapshot is malformed or incompatible, reporting the error through the
+// error callback. In that case the VM is left untouched.
+bool restoreSnapshot(JStarVM* vm, const void* snapshot, size_t len);
+
+#endif
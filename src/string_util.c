@@ -0,0 +1,197 @@
+#include "string_util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define USE_SSE2
+    #include <emmintrin.h>
+
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+
+static inline int firstBit(unsigned mask) {
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return i;
+}
+
+static inline int lastBit(unsigned mask) {
+    unsigned long i;
+    _BitScanReverse(&i, mask);
+    return i;
+}
+    #else
+        #define firstBit(mask) __builtin_ctz(mask)
+        #define lastBit(mask)  (31 - __builtin_clz(mask))
+    #endif
+
+    #define LANES 16
+
+static inline __m128i load(const char* p) {
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+// Returns a mask of the bytes of `block` in [low, low + width]: subtract `low` and check that the
+// result, as an unsigned byte, is <= `width`
+static inline __m128i inRange(__m128i block, __m128i low, __m128i width) {
+    __m128i off = _mm_sub_epi8(block, low);
+    return _mm_cmpeq_epi8(_mm_min_epu8(off, width), off);
+}
+
+// Returns a mask with the bits set for the bytes of `block` that are whitespace characters
+static inline unsigned spaceMask(__m128i block) {
+    // '\t'...'\r' are contiguous
+    __m128i isCtrl = inRange(block, _mm_set1_epi8('\t'), _mm_set1_epi8('\r' - '\t'));
+    __m128i isBlank = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(isCtrl, isBlank));
+}
+
+// Returns a mask with the bits set for the positions of `str` where a match of `sub` can start,
+// i.e. where both its first and last bytes match. Based on the "generic SIMD" algorithm from
+// http://0x80.pl/articles/simd-strfind.html
+static inline unsigned candidateMask(const char* str, __m128i first, __m128i last, size_t subLen) {
+    __m128i eqFirst = _mm_cmpeq_epi8(load(str), first);
+    __m128i eqLast = _mm_cmpeq_epi8(load(str + subLen - 1), last);
+    return (unsigned)_mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast));
+}
+#endif
+
+static inline bool isSpace(char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+const char* strFind(const char* str, size_t len, const char* sub, size_t subLen) {
+    if(subLen == 0) return str;
+    if(subLen > len) return NULL;
+    if(subLen == 1) return memchr(str, sub[0], len);
+
+    size_t i = 0, count = len - subLen + 1;
+
+#ifdef USE_SSE2
+    __m128i first = _mm_set1_epi8(sub[0]), last = _mm_set1_epi8(sub[subLen - 1]);
+    for(; i + LANES <= count; i += LANES) {
+        unsigned mask = candidateMask(str + i, first, last, subLen);
+        while(mask) {
+            size_t pos = i + firstBit(mask);
+            if(memcmp(str + pos + 1, sub + 1, subLen - 2) == 0) return str + pos;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    const char* ptr = str + i;
+    const char* lastStart = str + count - 1;
+    while(ptr <= lastStart && (ptr = memchr(ptr, sub[0], lastStart - ptr + 1))) {
+        if(memcmp(ptr, sub, subLen) == 0) return ptr;
+        ptr++;
+    }
+
+    return NULL;
+}
+
+const char* strFindLast(const char* str, size_t len, const char* sub, size_t subLen) {
+    if(subLen == 0) return str + len;
+    if(subLen > len) return NULL;
+
+    size_t count = len - subLen + 1;
+    size_t inner = subLen < 2 ? 0 : subLen - 2;
+
+#ifdef USE_SSE2
+    __m128i first = _mm_set1_epi8(sub[0]), last = _mm_set1_epi8(sub[subLen - 1]);
+    for(; count >= LANES; count -= LANES) {
+        size_t i = count - LANES;
+        unsigned mask = candidateMask(str + i, first, last, subLen);
+        while(mask) {
+            int bit = lastBit(mask);
+            if(memcmp(str + i + bit + 1, sub + 1, inner) == 0) return str + i + bit;
+            mask &= ~(1u << bit);
+        }
+    }
+#endif
+
+    while(count-- > 0) {
+        if(str[count] == sub[0] && memcmp(str + count + 1, sub + 1, subLen - 1) == 0) {
+            return str + count;
+        }
+    }
+
+    return NULL;
+}
+
+size_t strSpanNotIn(const char* str, size_t len, const char* set, size_t setLen) {
+    size_t i = 0;
+
+#ifdef USE_SSE2
+    for(; i + LANES <= len; i += LANES) {
+        __m128i block = load(str + i);
+        __m128i found = _mm_setzero_si128();
+        for(size_t j = 0; j < setLen; j++) {
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(block, _mm_set1_epi8(set[j])));
+        }
+
+        unsigned mask = (unsigned)_mm_movemask_epi8(found);
+        if(mask) return i + firstBit(mask);
+    }
+#endif
+
+    while(i < len && !memchr(set, str[i], setLen)) {
+        i++;
+    }
+
+    return i;
+}
+
+size_t strSpanNotInRange(const char* str, size_t len, unsigned char low, unsigned char high) {
+    size_t i = 0;
+    unsigned char width = high - low;
+
+#ifdef USE_SSE2
+    __m128i lowVec = _mm_set1_epi8(low), widthVec = _mm_set1_epi8(width);
+    for(; i + LANES <= len; i += LANES) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(inRange(load(str + i), lowVec, widthVec));
+        if(mask) return i + firstBit(mask);
+    }
+#endif
+
+    while(i < len && (unsigned char)(str[i] - low) > width) {
+        i++;
+    }
+
+    return i;
+}
+
+size_t strSkipSpace(const char* str, size_t len) {
+    size_t i = 0;
+
+#ifdef USE_SSE2
+    for(; i + LANES <= len; i += LANES) {
+        unsigned mask = ~spaceMask(load(str + i)) & 0xffff;
+        if(mask) return i + firstBit(mask);
+    }
+#endif
+
+    while(i < len && isSpace(str[i])) {
+        i++;
+    }
+
+    return i;
+}
+
+size_t strSkipSpaceBack(const char* str, size_t len) {
+    size_t end = len;
+
+#ifdef USE_SSE2
+    for(; end >= LANES; end -= LANES) {
+        unsigned mask = ~spaceMask(load(str + end - LANES)) & 0xffff;
+        if(mask) return end - LANES + lastBit(mask) + 1;
+    }
+#endif
+
+    while(end > 0 && isSpace(str[end - 1])) {
+        end--;
+    }
+
+    return end;
+}
@@ -0,0 +1,34 @@
+#ifndef STRING_UTIL_H
+#define STRING_UTIL_H
+
+#include <stddef.h>
+
+/**
+ * Scanning kernels for string data.
+ *
+ * All functions work on explicitly sized data, which can contain NUL bytes. When SSE2 is available
+ * they inspect 16 bytes at a time, otherwise they fall back to a scalar implementation.
+ * Whitespace follows the `isspace` definition of the C locale.
+ */
+
+// Returns a pointer to the first occurrence of `sub` in `str`, or NULL if there is none.
+// An empty `sub` matches at the start of `str`
+const char* strFind(const char* str, size_t len, const char* sub, size_t subLen);
+
+// Returns a pointer to the last occurrence of `sub` in `str`, or NULL if there is none.
+// An empty `sub` matches at the end of `str`
+const char* strFindLast(const char* str, size_t len, const char* sub, size_t subLen);
+
+// Returns the length of the longest prefix of `str` not containing any of the bytes in `set`
+size_t strSpanNotIn(const char* str, size_t len, const char* set, size_t setLen);
+
+// Returns the length of the longest prefix of `str` not containing any byte in [low, high]
+size_t strSpanNotInRange(const char* str, size_t len, unsigned char low, unsigned char high);
+
+// Returns the number of leading whitespace characters of `str`
+size_t strSkipSpace(const char* str, size_t len);
+
+// Returns the length of `str` without its trailing whitespace characters
+size_t strSkipSpaceBack(const char* str, size_t len);
+
+#endif
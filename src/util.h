@@ -4,6 +4,7 @@
 #include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Reinterprets the bits of the value `v` from type F to type T
 #define REINTERPRET_CAST(F, T, v) \
@@ -25,15 +26,92 @@
 // Returns the number of elements in a statically allocated array
 #define ARRAY_COUNT(a) (sizeof(a) / sizeof((a)[0]))
 
-// Utility function to hash arbitrary data
-static inline uint32_t hashBytes(const void* data, size_t length) {
-    const char* str = data;
-    uint32_t hash = 2166136261u;
-    for(size_t i = 0; i < length; i++) {
-        hash ^= str[i];
-        hash *= 16777619;
+// Multiplies `a` and `b`, returning the low and high halves of the 128-bit result
+static inline void hashMum(uint64_t* a, uint64_t* b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hashMix(uint64_t a, uint64_t b) {
+    hashMum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t hashRead64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hashRead32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Utility function to hash arbitrary data.
+// Reads the input a word at a time, mixing it with 64x64->128 bit multiplications. Based on
+// wyhash (public domain): https://github.com/wangyi-fudan/wyhash
+static inline uint32_t hashBytes(const void* data, size_t length, uint64_t seed) {
+    static const uint64_t secret[] = {
+        0xa0761d6478bd642full,
+        0xe7037ed1a0b428dbull,
+        0x8ebc6af09c88c6e3ull,
+        0x589965cc75374cc3ull,
+    };
+
+    const uint8_t* p = data;
+    uint64_t a, b;
+    seed ^= hashMix(seed ^ secret[0], secret[1]);
+
+    if(length <= 16) {
+        if(length >= 4) {
+            size_t mid = (length >> 3) << 2;
+            a = (hashRead32(p) << 32) | hashRead32(p + mid);
+            b = (hashRead32(p + length - 4) << 32) | hashRead32(p + length - 4 - mid);
+        } else if(length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = length;
+        if(i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = hashMix(hashRead64(p) ^ secret[1], hashRead64(p + 8) ^ seed);
+                seed1 = hashMix(hashRead64(p + 16) ^ secret[2], hashRead64(p + 24) ^ seed1);
+                seed2 = hashMix(hashRead64(p + 32) ^ secret[3], hashRead64(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while(i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while(i > 16) {
+            seed = hashMix(hashRead64(p) ^ secret[1], hashRead64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hashRead64(p + i - 16);
+        b = hashRead64(p + i - 8);
     }
-    return hash;
+
+    a ^= secret[1];
+    b ^= seed;
+    hashMum(&a, &b);
+    return (uint32_t)hashMix(a ^ secret[0] ^ length, b ^ secret[1]);
 }
 
 #endif
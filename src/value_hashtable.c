@@ -9,7 +9,7 @@
 #include "value.h"
 #include "vm.h"  // IWYU pragma: keep
 
-#define TOMB_MARKER    NULL_VAL
+#define TOMB_MARKER    TRUE_VAL
 #define INVALID_VAL    NULL_VAL
 #define IS_INVALID_VAL IS_NULL
 
@@ -23,13 +23,3 @@ void reachValueHashTable(JStarVM* vm, const ValueHashTable* t) {
         reachValue(vm, e->value);
     }
 }
-
-void sweepStrings(ValueHashTable* t) {
-    if(t->entries == NULL) return;
-    for(size_t i = 0; i <= t->sizeMask; i++) {
-        ValueEntry* e = &t->entries[i];
-        if(e->key && !e->key->base.reached) {
-            *e = (ValueEntry){NULL, TOMB_MARKER};
-        }
-    }
-}
@@ -8,6 +8,5 @@
 DECLARE_HASH_TABLE(Value, Value)
 
 void reachValueHashTable(JStarVM* vm, const ValueHashTable* t);
-void sweepStrings(ValueHashTable* t);
 
 #endif
@@ -1,8 +1,17 @@
 #include "vm.h"
 
 #include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(JSTAR_LINUX) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 25)
+    #define USE_GETRANDOM
+    #include <sys/random.h>
+#endif
 
 #include "array.h"
 #include "builtins/builtins.h"
@@ -16,6 +25,8 @@
 #include "opcode.h"
 #include "parse/ast.h"
 #include "profile.h"
+#include "serialize.h"
+#include "snapshot.h"
 #include "symbol.h"
 #include "util.h"
 #include "value.h"
@@ -27,12 +38,13 @@
 
 static const CoreClass nonInstantiableClasses[] = {
     CORE_CLASS_NULL,  CORE_CLASS_FUNCTION, CORE_CLASS_MODULE,    CORE_CLASS_STACKTRACE,
-    CORE_CLASS_CLASS, CORE_CLASS_USERDATA, CORE_CLASS_GENERATOR,
+    CORE_CLASS_CLASS, CORE_CLASS_USERDATA, CORE_CLASS_GENERATOR, CORE_CLASS_TYPED_ARRAY,
 };
 
 static const CoreClass instantiableClasses[] = {
-    CORE_CLASS_OBJECT, CORE_CLASS_LIST, CORE_CLASS_TUPLE, CORE_CLASS_NUMBER,
-    CORE_CLASS_BOOL,   CORE_CLASS_STR,  CORE_CLASS_TABLE,
+    CORE_CLASS_OBJECT, CORE_CLASS_LIST, CORE_CLASS_TUPLE, CORE_CLASS_NUMBER, CORE_CLASS_BOOL,
+    CORE_CLASS_STR, CORE_CLASS_TABLE, CORE_CLASS_FLOAT64_ARRAY, CORE_CLASS_INT32_ARRAY,
+    CORE_CLASS_UINT8_ARRAY, CORE_CLASS_BYTE_ARRAY,
 };
 
 // clang-format off
@@ -79,6 +91,33 @@ static size_t roundUp(size_t num, size_t multiple) {
     return ((num + multiple - 1) / multiple) * multiple;
 }
 
+// Fills `buf` with `size` random bytes from the system. Returns false if none are available
+static bool systemRandom(void* buf, size_t size) {
+#ifdef USE_GETRANDOM
+    if(getrandom(buf, size, GRND_NONBLOCK) == (ssize_t)size) return true;
+#endif
+#ifdef JSTAR_POSIX
+    FILE* urandom = fopen("/dev/urandom", "rb");
+    if(urandom) {
+        bool ok = fread(buf, 1, size, urandom) == size;
+        fclose(urandom);
+        if(ok) return true;
+    }
+#endif
+    return false;
+}
+
+// Picks a different seed from the system's randomness for every VM, so that string hash collisions
+// cannot be precomputed. When no randomness is available the seed is derived from the address of
+// the VM and the current time, which are easy to guess and only make collisions less likely
+static uint64_t randomSeed(JStarVM* vm) {
+    uint64_t seed;
+    if(!systemRandom(&seed, sizeof(seed))) {
+        seed = (uint64_t)(uintptr_t)vm ^ (uint64_t)time(NULL) << 32 ^ (uint64_t)clock();
+    }
+    return hashMix(seed, 0x9e3779b97f4a7c15ull) | 1;
+}
+
 JStarVM* jsrNewVM(const JStarConf* conf) {
     PROFILE_FUNC();
 
@@ -94,6 +133,9 @@ JStarVM* jsrNewVM(const JStarConf* conf) {
     vm->errorCallback = conf->errorCallback;
     vm->importCallback = conf->importCallback;
     vm->userData = conf->userData;
+    vm->snapshot = conf->snapshot;
+    vm->snapshotLength = conf->snapshotLength;
+    vm->hashSeed = conf->hashSeed ? conf->hashSeed : randomSeed(vm);
 
     // VM program stack
     vm->stackSz = roundUp(conf->startingStackSize, MAX_LOCALS + 1);
@@ -122,6 +164,12 @@ void jsrInitRuntime(JStarVM* vm) {
 
     JSR_ASSERT(!vm->core, "Runtime already initialized");
 
+    // Restore the initialized heap from the snapshot, falling back to a regular initialization if
+    // it cannot be used
+    if(vm->snapshot && restoreSnapshot(vm, vm->snapshot, vm->snapshotLength)) {
+        return;
+    }
+
     initCoreModule(vm);
 
     // Empty `__main__` module
@@ -160,6 +208,13 @@ void jsrFreeVM(JStarVM* vm) {
             sym = next;
         }
 
+        JStarCallHandle* h = vm->callHandles;
+        while(h) {
+            JStarCallHandle* next = h->next;
+            GC_FREE(vm, JStarCallHandle, h);
+            h = next;
+        }
+
         arrayFree(vm, &vm->reachedStack);
     }
 
@@ -324,7 +379,7 @@ static void argumentError(JStarVM* vm, FunctionBase* fn, int expected, int suppl
              fn->module->name->data, fn->name->data, quantity, expected, supplied);
 }
 
-static bool adjustArguments(JStarVM* vm, FunctionBase* p, uint8_t argc) {
+static bool checkArguments(JStarVM* vm, FunctionBase* p, uint8_t argc) {
     uint8_t most = p->argsCount, least = most - p->defCount;
 
     if(!p->vararg && argc > most) {
@@ -335,6 +390,16 @@ static bool adjustArguments(JStarVM* vm, FunctionBase* p, uint8_t argc) {
         return false;
     }
 
+    return true;
+}
+
+static bool adjustArguments(JStarVM* vm, FunctionBase* p, uint8_t argc) {
+    if(!checkArguments(vm, p, argc)) {
+        return false;
+    }
+
+    uint8_t most = p->argsCount, least = most - p->defCount;
+
     // Push remaining args taking the default value
     for(uint8_t i = argc - least; i < p->defCount; i++) {
         push(vm, p->defaults[i]);
@@ -355,11 +420,24 @@ static bool checkStackOverflow(JStarVM* vm) {
     return true;
 }
 
+static bool loadLazyCode(JStarVM* vm, ObjFunction* fn) {
+    if(!deserializeLazyCode(vm, fn)) {
+        jsrRaise(vm, "ImportException", "Malformed binary file %s", fn->base.module->path->data);
+        return false;
+    }
+    return true;
+}
+
 static bool callFunction(JStarVM* vm, ObjClosure* closure, uint8_t argc) {
     if(!checkStackOverflow(vm)) {
         return false;
     }
 
+    // The function comes from a compiled module and has never been called, deserialize its code
+    if(closure->fn->code.lazyChunk && !loadLazyCode(vm, closure->fn)) {
+        return false;
+    }
+
     if(!adjustArguments(vm, &closure->fn->base, argc)) {
         return false;
     }
@@ -687,7 +765,7 @@ static bool getStringSubscript(JStarVM* vm) {
     if(IS_TUPLE(arg)) {
         size_t low = 0, high = 0;
         if(!checkSliceIndex(vm, AS_TUPLE(arg), str->length, &low, &high)) return false;
-        ObjString* ret = copyStringInterned(vm, str->data + low, high - low);
+        ObjString* ret = newStringSlice(vm, str, low, high - low);
 
         pop(vm), pop(vm);
         push(vm, OBJ_VAL(ret));
@@ -698,12 +776,65 @@ static bool getStringSubscript(JStarVM* vm) {
     return false;
 }
 
+static bool getTypedArraySubscript(JStarVM* vm) {
+    ObjTypedArray* arr = AS_TYPED_ARRAY(peek2(vm));
+    Value arg = peek(vm);
+
+    if(IS_INT(arg)) {
+        size_t idx = jsrCheckIndexNum(vm, AS_NUM(arg), arr->count);
+        if(idx == SIZE_MAX) return false;
+
+        pop(vm), pop(vm);
+        push(vm, NUM_VAL(typedArrayGet(arr, idx)));
+        return true;
+    }
+    if(IS_TUPLE(arg)) {
+        size_t low = 0, high = 0;
+        if(!checkSliceIndex(vm, AS_TUPLE(arg), arr->count, &low, &high)) return false;
+        ObjTypedArray* ret = newTypedArrayView(vm, arr, low, high - low);
+
+        pop(vm), pop(vm);
+        push(vm, OBJ_VAL(ret));
+        return true;
+    }
+
+    jsrRaise(vm, "TypeException", "Index of %s subscript must be an integer or a Tuple",
+             arr->base.cls->name->data);
+    return false;
+}
+
+static bool getByteArraySubscript(JStarVM* vm) {
+    ObjByteArray* arr = AS_BYTE_ARRAY(peek2(vm));
+    Value arg = peek(vm);
+
+    size_t size;
+    const uint8_t* bytes = byteArrayBytes(arr, &size);
+
+    if(IS_INT(arg)) {
+        size_t idx = jsrCheckIndexNum(vm, AS_NUM(arg), size);
+        if(idx == SIZE_MAX) return false;
+
+        pop(vm), pop(vm);
+        push(vm, NUM_VAL(bytes[idx]));
+        return true;
+    }
+    if(IS_TUPLE(arg)) {
+        size_t low = 0, high = 0;
+        if(!checkSliceIndex(vm, AS_TUPLE(arg), size, &low, &high)) return false;
+        ObjByteArray* ret = newByteArrayView(vm, arr, low, high - low);
+
+        pop(vm), pop(vm);
+        push(vm, OBJ_VAL(ret));
+        return true;
+    }
+
+    jsrRaise(vm, "TypeException", "Index of ByteArray subscript must be an integer or a Tuple");
+    return false;
+}
+
 static void concatStrings(JStarVM* vm) {
     ObjString *s1 = AS_STRING(peek2(vm)), *s2 = AS_STRING(peek(vm));
-    size_t length = s1->length + s2->length;
-    ObjString* result = newString(vm, length);
-    memcpy(result->data, s1->data, s1->length);
-    memcpy(result->data + s1->length, s2->data, s2->length);
+    ObjString* result = stringConcat(vm, s1, s2);
     pop(vm), pop(vm);
     push(vm, OBJ_VAL(result));
 }
@@ -1028,6 +1159,10 @@ inline bool getValueSubscript(JStarVM* vm) {
             return getTupleSubscript(vm);
         case OBJ_STRING:
             return getStringSubscript(vm);
+        case OBJ_TYPED_ARRAY:
+            return getTypedArraySubscript(vm);
+        case OBJ_BYTE_ARRAY:
+            return getByteArraySubscript(vm);
         default:
             break;
         }
@@ -1056,6 +1191,50 @@ inline bool setValueSubscript(JStarVM* vm) {
         return true;
     }
 
+    if(IS_TYPED_ARRAY(peek(vm))) {
+        Value operand = pop(vm), arg = pop(vm), val = peek(vm);
+        ObjTypedArray* arr = AS_TYPED_ARRAY(operand);
+
+        if(!IS_NUM(arg) || !isInt(AS_NUM(arg))) {
+            jsrRaise(vm, "TypeException", "Index of %s subscript access must be an integer.",
+                     arr->base.cls->name->data);
+            return false;
+        }
+        if(!IS_NUM(val)) {
+            jsrRaise(vm, "TypeException", "Elements of %s must be Numbers.",
+                     arr->base.cls->name->data);
+            return false;
+        }
+
+        size_t index = jsrCheckIndexNum(vm, AS_NUM(arg), arr->count);
+        if(index == SIZE_MAX) return false;
+
+        typedArraySet(arr, index, AS_NUM(val));
+        return true;
+    }
+
+    if(IS_BYTE_ARRAY(peek(vm))) {
+        Value operand = pop(vm), arg = pop(vm), val = peek(vm);
+
+        if(!IS_NUM(arg) || !isInt(AS_NUM(arg))) {
+            jsrRaise(vm, "TypeException", "Index of ByteArray subscript access must be an integer.");
+            return false;
+        }
+        if(!IS_NUM(val)) {
+            jsrRaise(vm, "TypeException", "Elements of ByteArray must be Numbers.");
+            return false;
+        }
+
+        size_t size;
+        uint8_t* bytes = byteArrayBytes(AS_BYTE_ARRAY(operand), &size);
+
+        size_t index = jsrCheckIndexNum(vm, AS_NUM(arg), size);
+        if(index == SIZE_MAX) return false;
+
+        bytes[index] = (uint8_t)typedArrayToInt(AS_NUM(val));
+        return true;
+    }
+
     // Swap operand and value to prepare function call
     swapStackSlots(vm, -1, -3);
     if(!invokeMethod(vm, getClass(vm, peekn(vm, 2)), vm->specialMethods[SPECIAL_METHOD_SET], 2)) {
@@ -1130,6 +1309,81 @@ inline bool callValue(JStarVM* vm, Value callee, uint8_t argc) {
     return false;
 }
 
+bool prepareCallHandle(JStarVM* vm, JStarCallHandle* h) {
+    Value callee = h->callee;
+    h->receiver = callee;
+    h->closure = NULL;
+
+    Obj* fn;
+    if(IS_CLOSURE(callee) || IS_NATIVE(callee)) {
+        fn = AS_OBJ(callee);
+    } else if(IS_BOUND_METHOD(callee)) {
+        ObjBoundMethod* m = AS_BOUND_METHOD(callee);
+        h->receiver = m->receiver;
+        fn = m->method;
+    } else if(IS_CLASS(callee) || IS_GENERATOR(callee)) {
+        // Constructors and generators are checked on each call
+        return true;
+    } else {
+        ObjClass* cls = getClass(vm, callee);
+        jsrRaise(vm, "TypeException", "Object %s is not a callable.", cls->name->data);
+        return false;
+    }
+
+    FunctionBase* base = getFunctionBase(fn);
+    if(!checkArguments(vm, base, h->argc)) {
+        return false;
+    }
+
+    // Natives and vararg functions go through the generic path, as they need additional setup
+    if(fn->type != OBJ_CLOSURE || base->vararg) {
+        return true;
+    }
+
+    ObjClosure* closure = (ObjClosure*)fn;
+    if(closure->fn->code.lazyChunk && !loadLazyCode(vm, closure->fn)) {
+        return false;
+    }
+
+    h->closure = closure;
+    h->firstDefault = h->argc - (base->argsCount - base->defCount);
+    return true;
+}
+
+bool callHandle(JStarVM* vm, const JStarCallHandle* h) {
+    ObjClosure* closure = h->closure;
+    uint8_t argc = h->argc;
+
+    size_t needed = 1;
+    if(closure) {
+        needed += closure->fn->base.defCount - h->firstDefault + closure->fn->stackUsage;
+    }
+    reserveStack(vm, needed);
+
+    // Shift the arguments to make room for the callee
+    Value* args = vm->sp - argc;
+    memmove(args + 1, args, sizeof(Value) * argc);
+    args[0] = h->receiver;
+    vm->sp++;
+
+    if(!closure) {
+        return callValue(vm, h->callee, argc);
+    }
+
+    if(!checkStackOverflow(vm)) {
+        return false;
+    }
+
+    // Arity has already been checked, so we only need to push the missing defaults
+    FunctionBase* base = &closure->fn->base;
+    for(uint8_t i = h->firstDefault; i < base->defCount; i++) {
+        *vm->sp++ = base->defaults[i];
+    }
+
+    appendCallFrame(vm, closure);
+    return true;
+}
+
 inline bool invokeValue(JStarVM* vm, ObjString* name, uint8_t argc, SymbolCache* sym) {
     Value val = peekn(vm, argc);
     if(IS_OBJ(val)) {
@@ -1269,6 +1523,13 @@ ObjModule* getCurrentModule(JStarVM* vm) {
     return getFunctionBase(vm->frames[vm->frameCount - 1].fn)->module;
 }
 
+JStarSymbol* getBuiltInSymbol(JStarVM* vm, BuiltInSymbol id, const char* name) {
+    if(!vm->builtInSymbols[id]) {
+        vm->builtInSymbols[id] = jsrNewSymbolNamed(vm, name);
+    }
+    return vm->builtInSymbols[id];
+}
+
 bool runEval(JStarVM* vm, int evalDepth) {
     PROFILE_FUNC();
 
@@ -6,6 +6,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "builtins/builtins.h"
 #include "compiler.h"
 #include "jstar.h"
 #include "jstar_limits.h"
@@ -39,6 +40,11 @@ typedef enum {
     CORE_CLASS_TUPLE,
     CORE_CLASS_TABLE,
     CORE_CLASS_USERDATA,
+    CORE_CLASS_TYPED_ARRAY,
+    CORE_CLASS_FLOAT64_ARRAY,
+    CORE_CLASS_INT32_ARRAY,
+    CORE_CLASS_UINT8_ARRAY,
+    CORE_CLASS_BYTE_ARRAY,
     CORE_CLASS_COUNT,
 } CoreClass;
 
@@ -112,6 +118,9 @@ struct JStarVM {
     // Constant string pool, for interned strings
     ValueHashTable stringPool;
 
+    // Seed of the string hash function
+    uint64_t hashSeed;
+
     // Linked list of all open upvalues
     ObjUpvalue* upvalues;
 
@@ -131,9 +140,19 @@ struct JStarVM {
     // Custom data associated with the VM
     void* userData;
 
+    // Snapshot to restore the runtime from (if any)
+    const void* snapshot;
+    size_t snapshotLength;
+
     // Linked list of all created symbols
     JStarSymbol* symbols;
 
+    // Symbols used by built-in natives (see `getBuiltInSymbol`)
+    JStarSymbol* builtInSymbols[BUILTIN_SYMBOL_COUNT];
+
+    // Linked list of all created call handles
+    JStarCallHandle* callHandles;
+
 #ifdef JSTAR_DBG_CACHE_STATS
     size_t cacheHits, cacheMisses;
 #endif
@@ -159,13 +178,27 @@ struct JStarVM {
 };
 
 // Represents a handle to a resolved method, field or global variable.
-// Internally it stores a cache of the symbol lookup.
+// Internally it stores a cache of the symbol lookup, and optionally the interned name it looks up.
 struct JStarSymbol {
     SymbolCache sym;
+    ObjString* name;
     JStarSymbol* next;
     JStarSymbol* prev;
 };
 
+// Represents a callable prepared for repeated calls with a fixed number of arguments.
+// The arity checks and the resolution of the called function are performed once, when the handle
+// is created. If `closure` is set, calls bypass the generic `callValue` path altogether.
+struct JStarCallHandle {
+    Value callee;          // The pinned callable
+    Value receiver;        // The value placed below the arguments (the receiver for methods)
+    ObjClosure* closure;   // The function to call directly, or NULL if using `callValue`
+    uint8_t argc;          // The number of arguments passed in each call
+    uint8_t firstDefault;  // Index of the first default argument to push, if calling `closure`
+    JStarCallHandle* next;
+    JStarCallHandle* prev;
+};
+
 void* defaultRealloc(void* ptr, size_t oldSz, size_t newSz);
 
 bool getValueField(JStarVM* vm, ObjString* name, SymbolCache* sym);
@@ -176,11 +209,22 @@ bool getValueSubscript(JStarVM* vm);
 bool setValueSubscript(JStarVM* vm);
 
 bool callValue(JStarVM* vm, Value callee, uint8_t argc);
+
+// Resolves the callee of a call handle and checks its arity. Returns false and raises an
+// exception if the callee cannot be called with the handle's number of arguments
+bool prepareCallHandle(JStarVM* vm, JStarCallHandle* h);
+
+// Calls the callee of a handle with the arguments on top of the stack, inserting the callee slot
+// below them. Same as `callValue` otherwise
+bool callHandle(JStarVM* vm, const JStarCallHandle* h);
 bool invokeValue(JStarVM* vm, ObjString* name, uint8_t argc, SymbolCache* sym);
 
 void reserveStack(JStarVM* vm, size_t needed);
 ObjModule* getCurrentModule(JStarVM* vm);
 
+// Returns the built-in symbol `id`, named `name`, creating it on first use
+JStarSymbol* getBuiltInSymbol(JStarVM* vm, BuiltInSymbol id, const char* name);
+
 bool runEval(JStarVM* vm, int evalDepth);
 bool unwindStack(JStarVM* vm, int toDepth);
 